@@ -0,0 +1,140 @@
+#include "include/analysis.hpp"
+#include "include/clusters.hpp"
+#include "include/parallel.hpp"
+#include "include/vtk.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace {
+// frames analyzed together, enough to keep every thread busy while the
+// results printed so far leave the memory
+constexpr std::uint64_t chunk{1024};
+
+void print(std::vector<view::frame_analysis> const &analyses, bool json,
+           view::analysis_options const &options) {
+  for (auto const &analysis : analyses) {
+    std::cout << (json ? view::print_analysis_to_json(analysis, options)
+                       : view::print_analysis_to_csv(analysis, options));
+  }
+}
+
+// the neighbors and clusters of the frames are found in parallel, the files
+// are written in order
+void export_frames(std::vector<io::decoded_frame> const &frames,
+                   dynamics::running_parameters const &parameters,
+                   io::vtu_series &series) {
+  std::vector<io::vtu_scalars> scalars(frames.size());
+  parallel::parallel_for(frames.size(), [&](std::size_t index) {
+    scalars[index].neighbors =
+        view::count_neighbors(frames[index].flock, parameters);
+    scalars[index].clusters =
+        view::find_clusters(frames[index].flock, parameters).labels;
+  });
+  for (std::size_t index{}; index != frames.size(); ++index) {
+    series.add(frames[index].time, frames[index].flock, scalars[index]);
+  }
+}
+
+// the number of threads given on the command line, 0 if it is not a
+// positive integer
+unsigned parse_threads(char const *text) {
+  unsigned count{};
+  char const *const end = text + std::strlen(text);
+  auto const [last, error] = std::from_chars(text, end, count);
+  return error == std::errc{} && last == end ? count : 0;
+}
+} // namespace
+
+// usage: boids.analysis <trajectory> [csv|jsonl|vtu] [threads]
+// the analyses of every frame of a trajectory recorded with --record or
+// --record-compressed are printed on the standard output, with vtu the
+// frames are written for ParaView next to the trajectory, indexed by a .pvd
+// file with its name
+int main(int argc, char *argv[]) {
+  std::string const format = argc > 2 ? argv[2] : "csv";
+  unsigned const threads =
+      argc > 3 ? parse_threads(argv[3]) : parallel::thread_count();
+  if (argc < 2 || (format != "csv" && format != "jsonl" && format != "vtu") ||
+      threads == 0) {
+    std::cerr << "usage: " << argv[0]
+              << " <trajectory> [csv|jsonl|vtu] [threads]\n";
+    return 1;
+  }
+  bool const json = format == "jsonl";
+  parallel::thread_count(threads);
+  view::analysis_options const options{};
+  // the error covers missing, truncated or corrupted trajectories
+  try {
+    std::ifstream file{argv[1], std::ios::binary};
+    if (!file) {
+      throw std::runtime_error("ERROR: Failed to open " +
+                               std::string{argv[1]});
+    }
+    std::unique_ptr<io::vtu_series> series;
+    if (format == "vtu") {
+      std::string const path{argv[1]};
+      std::size_t const dot = path.find_last_of('.');
+      std::size_t const slash = path.find_last_of('/');
+      bool const extension =
+          dot != std::string::npos && (slash == std::string::npos || dot > slash);
+      series = std::make_unique<io::vtu_series>(
+          (extension ? path.substr(0, dot) : path) + ".pvd");
+    } else if (!json) {
+      std::cout << view::print_analysis_header_to_csv(options);
+    }
+    // the magic of a compressed trajectory tells the two formats apart
+    std::string magic(8, '\0');
+    file.read(&magic[0], 8);
+    file.seekg(0);
+    if (magic == "BOIDCODE") {
+      io::trajectory_decoder decoder{file};
+      std::vector<io::decoded_frame> frames(chunk);
+      std::size_t decoded{chunk};
+      while (decoded == chunk) {
+        decoded = 0;
+        while (decoded != chunk && decoder.next(frames[decoded])) {
+          ++decoded;
+        }
+        frames.resize(decoded);
+        if (series) {
+          export_frames(frames, decoder.parameters(), *series);
+        } else {
+          print(view::analyze_frames(frames, decoder.parameters(), options),
+                json, options);
+        }
+      }
+    } else {
+      file.close();
+      io::trajectory_reader const reader{argv[1]};
+      for (std::uint64_t first{}; first < reader.frames(); first += chunk) {
+        std::uint64_t const last = std::min(first + chunk, reader.frames());
+        if (series) {
+          std::vector<io::decoded_frame> frames;
+          for (std::uint64_t index{first}; index != last; ++index) {
+            io::frame_view const frame = reader.frame(index);
+            frames.push_back({frame.step(), frame.time(), frame.flock()});
+          }
+          export_frames(frames, reader.parameters(), *series);
+        } else {
+          print(view::analyze_trajectory(reader, first, last, options), json,
+                options);
+        }
+      }
+    }
+    if (series) {
+      series->close();
+    }
+  } catch (const std::exception &error) {
+    std::cerr << error.what() << '\n';
+    std::cerr << "Analysis Aborted"
+              << "\n";
+    return 1;
+  }
+}
@@ -0,0 +1,51 @@
+#include "include/ensemble.hpp"
+#include "include/parallel.hpp"
+
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+// the number of threads given on the command line, 0 if it is not a
+// positive integer
+unsigned parse_threads(char const *text) {
+  unsigned count{};
+  char const *const end = text + std::strlen(text);
+  auto const [last, error] = std::from_chars(text, end, count);
+  return error == std::errc{} && last == end ? count : 0;
+}
+} // namespace
+
+// usage: boids.ensemble <sweep file> [threads]
+// the statistics of every run are printed on the standard output as csv
+int main(int argc, char *argv[]) {
+  unsigned const threads =
+      argc > 2 ? parse_threads(argv[2]) : parallel::thread_count();
+  if (argc < 2 || threads == 0) {
+    std::cerr << "usage: " << argv[0] << " <sweep file> [threads]\n";
+    return 1;
+  }
+  parallel::thread_count(threads);
+  // the error covers malformed or missing sweep files
+  try {
+    std::ifstream sweep_file{argv[1]};
+    if (!sweep_file) {
+      throw std::runtime_error("ERROR: Failed to open " +
+                               std::string{argv[1]});
+    }
+    dynamics::sweep_specification const sweep =
+        dynamics::parse_sweep(sweep_file);
+    std::cout << dynamics::print_result_header_to_csv();
+    for (auto const &result : dynamics::run_ensemble(sweep)) {
+      std::cout << dynamics::print_result_to_csv(result);
+    }
+  } catch (const std::exception &error) {
+    std::cerr << error.what() << '\n';
+    std::cerr << "Ensemble Aborted"
+              << "\n";
+    return 1;
+  }
+}
@@ -0,0 +1,64 @@
+#ifndef ANALYSIS_HPP
+#define ANALYSIS_HPP
+
+#include "codec.hpp"
+#include "statistics.hpp"
+#include "trajectory.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace view {
+// Analyses computed on every frame of a recorded trajectory, build_data is
+// always computed, the clusters and the correlation length can be left out
+struct analysis_options {
+  statistics_options statistics{};
+  bool clusters{true};
+  bool correlation{true};
+  std::size_t correlation_bins{32};       // Bins and grid resolution of
+  std::size_t correlation_resolution{64}; // calculate_velocity_correlation_fft
+};
+
+// The analyses of a single frame, the fields that were not asked for are 0
+struct frame_analysis {
+  std::uint64_t step;
+  double time;
+  data statistics;
+  std::size_t clusters;
+  std::size_t largest_cluster;
+  double correlation_length;
+};
+
+// Analyzes a flock recorded at the given step and time
+frame_analysis analyze_frame(std::uint64_t step, double time,
+                             std::vector<dynamics::Boid> const &flock,
+                             dynamics::running_parameters const &parameters,
+                             analysis_options const &options = {});
+
+// Analyzes the frames in [first, last) of a mapped trajectory, one frame per
+// task of a parallel::parallel_for, so the analyses nested in analyze_frame
+// run serially and the frames are spread across the threads instead. The
+// results are in the order of the frames and don't depend on the number of
+// threads. Throws std::out_of_range if the range is past the last frame
+std::vector<frame_analysis>
+analyze_trajectory(io::trajectory_reader const &reader, std::uint64_t first,
+                   std::uint64_t last, analysis_options const &options = {});
+
+// Same for frames already decoded from a compressed trajectory
+std::vector<frame_analysis>
+analyze_frames(std::vector<io::decoded_frame> const &frames,
+               dynamics::running_parameters const &parameters,
+               analysis_options const &options = {});
+
+// Functions to print the analyses as comma separated values or as one json
+// object per line, with only the fields asked for in options
+std::string print_analysis_header_to_csv(analysis_options const &options);
+std::string print_analysis_to_csv(frame_analysis const &analysis,
+                                  analysis_options const &options);
+std::string print_analysis_to_json(frame_analysis const &analysis,
+                                   analysis_options const &options);
+} // namespace view
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef ASYNC_WRITER_HPP
+#define ASYNC_WRITER_HPP
+
+#include "spsc_queue.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace io {
+// How an async_file_writer reaches the disk
+enum class io_backend {
+  automatic, // io_uring when the kernel allows it, threaded otherwise
+  io_uring,  // writes submitted to an io_uring from registered buffers
+  threaded   // writes done with pwrite by a thread of the writer
+};
+
+// async_file_writer writes a file sequentially without waiting for the disk.
+// The bytes are copied into a pool of buffers allocated once, a full buffer is
+// handed over to be written at its offset in the file and the next one is
+// filled meanwhile, so write only waits when every buffer is still being
+// written. With io_uring the buffers are registered with the kernel and the
+// writes are submitted in batches with a single system call, on machines
+// without io_uring a thread drains the buffers, which it receives and gives
+// back through lock-free queues. Errors throw std::runtime_error, the ones of
+// the writes in flight at the next call
+class async_file_writer {
+private:
+  struct ring; // io_uring state, defined in the source file
+
+  struct buffer {
+    char *data;
+    std::size_t size;
+    std::uint64_t offset; // in the file
+  };
+
+  // lets the writer be the destination of an std::ostream
+  class stream_buffer : public std::streambuf {
+  private:
+    async_file_writer &writer_;
+
+  protected:
+    int_type overflow(int_type character) override;
+    std::streamsize xsputn(char const *data, std::streamsize size) override;
+
+  public:
+    explicit stream_buffer(async_file_writer &writer);
+  };
+
+  std::string path_;
+  int fd_;
+  io_backend backend_; // the one in use, never automatic
+  std::size_t buffer_bytes_;
+  std::vector<char> storage_;
+  std::vector<buffer> buffers_;
+  std::size_t current_; // buffer being filled, buffers_.size() if none
+  std::uint64_t offset_; // in the file of the next byte written
+  std::atomic<int> error_; // errno of the first failed write
+  std::vector<std::size_t> idle_; // buffers not being written
+  // io_uring backend
+  std::unique_ptr<ring> ring_;
+  std::size_t batch_; // writes submitted at once
+  // threaded backend
+  parallel::spsc_queue<std::size_t> full_;
+  parallel::spsc_queue<std::size_t> free_;
+  std::atomic<bool> stopping_;
+  std::thread thread_;
+
+  stream_buffer stream_buffer_;
+  std::ostream stream_;
+
+  bool start_ring();
+  void work();
+  void check();
+  // moves the buffers already written to idle_, if wait at least one
+  void collect(bool wait);
+  std::size_t acquire();
+  void hand_over(std::size_t index);
+  void drain();
+
+public:
+  // creates (or truncates) the file, buffers of buffer_bytes bytes, throws if
+  // the file can't be created, there are not 1 to 1024 buffers of 1 byte to
+  // 1 GiB, or the io_uring backend is asked for and can't be used
+  explicit async_file_writer(std::string const &path,
+                             io_backend backend = io_backend::automatic,
+                             std::size_t buffers = 8,
+                             std::size_t buffer_bytes = std::size_t{1} << 20);
+  async_file_writer(async_file_writer const &) = delete;
+  async_file_writer &operator=(async_file_writer const &) = delete;
+  // closes the file if close was not called, errors are lost
+  ~async_file_writer();
+
+  void write(char const *data, std::size_t size);
+  // stream writing through write, for write_snapshot and trajectory_encoder
+  std::ostream &stream();
+  // hands the buffer being filled over to be written, without waiting
+  void submit();
+  // waits until every byte written so far is in the file
+  void flush();
+  // Closes the current file and creates (or truncates) path, which is then
+  // written from its beginning with the same buffers, ring and thread. The
+  // errors of the current file are lost, flush first to see them. Throws if
+  // close was called or path can't be created, in which case the writer can
+  // be reopened on another path
+  void reopen(std::string const &path);
+  void close();
+
+  io_backend backend() const;
+  std::uint64_t bytes() const;
+};
+} // namespace io
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include "flock.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace dynamics {
+// Lanes processed together by the innermost loop of flock_batch::evolve
+constexpr std::size_t batch_width{8};
+
+// flock_batch evolves many independent flocks with the same number of boids
+// at once, boid i of the flock in lane l is stored at index i * stride + l, so
+// the innermost loops run over the lanes and every SIMD lane advances a
+// different flock through the rules of evolve_boid. The stride is the number
+// of lanes rounded up to a multiple of batch_width, the padding lanes have no
+// neighbors
+class flock_batch {
+private:
+  std::size_t lanes_;
+  std::size_t stride_;
+  std::size_t boids_;
+  std::vector<running_parameters> parameters_;
+  // state of the boids, one array for every coordinate
+  std::vector<double> r_x_;
+  std::vector<double> r_y_;
+  std::vector<double> v_x_;
+  std::vector<double> v_y_;
+  // squared distances of neighborhood and separation of every lane
+  std::vector<double> d_squared_;
+  std::vector<double> d_s_squared_;
+
+public:
+  // every flock must have the same size and its own parameters, throws
+  // std::runtime_error otherwise
+  flock_batch(std::vector<std::vector<Boid>> const &flocks,
+              std::vector<running_parameters> const &parameters);
+
+  std::size_t lanes() const;
+  std::size_t boids() const;
+  // the flock in the given lane, in its original order
+  std::vector<Boid> flock(std::size_t lane) const;
+
+  // Equivalent to evolve_flock on every flock of the batch
+  void evolve(double const delta_t);
+};
+} // namespace dynamics
+
+#endif
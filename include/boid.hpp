@@ -2,6 +2,7 @@
 #define BOID_HPP
 
 #include "r2.hpp"
+#include "welford.hpp"
 
 #include <vector>
 namespace dynamics {
@@ -34,11 +35,28 @@ std::vector<Boid> get_neighborhood(std::vector<Boid> const &flock,
 } // namespace dynamics
 
 namespace view {
+// Sums over all the couples of boids of a flock of their distances and of
+// their squared distances
+struct distance_sums {
+  double sum;
+  double sum_squares;
+};
+
+// Mean and variance of the distances of all the couples of boids in a single
+// sweep, the couples are visited in square tiles of the upper triangle
+// distributed across threads and the partial results are merged in a fixed
+// order, so the result does not depend on the number of threads
+math::welford
+calculate_distance_statistics(std::vector<dynamics::Boid> const &flock);
+
+// Both sums, derived from calculate_distance_statistics
+distance_sums calculate_distance_sums(std::vector<dynamics::Boid> const &flock);
+
 // Mean distance of a flock of boids
 double calculate_mean_distance(std::vector<dynamics::Boid> const &flock);
 
-// Standard deviation of distances of a flock of boids,the mean distance is
-// passed to simplify the functuion
+// Sample standard deviation of distances of a flock of boids, the mean
+// distance is not used, it is kept for the callers that pass it
 double
 calculate_standard_deviation_distance(std::vector<dynamics::Boid> const &flock,
                                       double mean_distance);
@@ -46,8 +64,8 @@ calculate_standard_deviation_distance(std::vector<dynamics::Boid> const &flock,
 // Mean of magnitudes of velocity vectors of a flock of boids
 double calculate_mean_velocity(std::vector<dynamics::Boid> const &flock);
 
-//  Standard deviation of distances of a flock of boids, the mean velocity is
-//  passed to simplify the functuion
+// Sample standard deviation of the speeds of a flock of boids, the mean
+// velocity is not used, it is kept for the callers that pass it
 double
 calculate_standard_deviation_velocity(std::vector<dynamics::Boid> const &flock,
                                       double mean_velocity);
@@ -0,0 +1,33 @@
+#ifndef CLUSTERS_HPP
+#define CLUSTERS_HPP
+
+#include "flock.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace view {
+// Connected components of the neighbor graph of a flock, two boids are
+// connected when they are neighbors (closer than d, as in get_neighborhood).
+// The clusters are numbered in the order of their first boid in the flock
+struct cluster_data {
+  std::size_t count;               // Number of clusters
+  std::size_t largest;             // Boids in the largest cluster
+  std::vector<std::size_t> labels; // Cluster of every boid of the flock
+  std::vector<std::size_t> sizes;  // Boids in every cluster
+};
+
+// Finds the clusters of a flock, the couples of neighbors are found with a
+// cell list and merged concurrently in a lock free union-find, the result
+// does not depend on the number of threads
+cluster_data find_clusters(std::vector<dynamics::Boid> const &flock,
+                           dynamics::running_parameters const &parameters);
+
+// Number of neighbors of every boid in the same graph, the boids of
+// get_neighborhood other than the boid itself, found with a cell list
+std::vector<std::size_t>
+count_neighbors(std::vector<dynamics::Boid> const &flock,
+                dynamics::running_parameters const &parameters);
+} // namespace view
+
+#endif
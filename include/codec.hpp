@@ -0,0 +1,117 @@
+#ifndef CODEC_HPP
+#define CODEC_HPP
+
+#include "flock.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+namespace io {
+// Version written by trajectory_encoder
+constexpr std::uint32_t codec_version{1};
+
+// Precision of a compressed trajectory, positions are rounded to multiples of
+// position_step from the bottom left corner of the space and velocities to
+// multiples of velocity_step, so no value moves by more than half its step
+struct codec_settings {
+  double position_step{1e-3};
+  double velocity_step{1e-3};
+  std::uint32_t keyframe_interval{60}; // A frame in keyframe_interval is
+                                       // encoded on its own
+};
+
+// Frame returned by trajectory_decoder
+struct decoded_frame {
+  std::uint64_t step{};
+  double time{};
+  std::vector<dynamics::Boid> flock{};
+};
+
+// A compressed trajectory is a stream of frames of quantized values. Every
+// value is predicted from the same value in the previous frames, by linear
+// extrapolation of the last two (the last one right after a keyframe, nothing
+// in a keyframe), and only the difference from the prediction is stored. The
+// predictions use the quantized values, so the errors never accumulate. The
+// differences of each component (r_x, r_y, v_x, v_y) are zigzag encoded and
+// packed in blocks of 128 boids, with the bits of the largest difference of
+// the block, so a smoothly moving flock takes a few bits per value. The
+// blocks are encoded and decoded in parallel with parallel::parallel_for and
+// the result doesn't depend on the number of threads. The format, with every
+// number little endian:
+//   "BOIDCODE", version (u32), reserved (u32), boids (u64), position_step,
+//   velocity_step (f64), keyframe_interval (u64), boids_number (i64) and the
+//   eleven doubles of running_parameters in their order of declaration,
+//   then for every frame: size of the rest of the frame (u64), step (u64),
+//   time (f64), keyframe (u8), and for every component and block: bits (u8)
+//   and the packed differences
+// Errors throw std::runtime_error
+class trajectory_encoder {
+private:
+  std::ostream &output_;
+  std::size_t boids_;
+  codec_settings settings_;
+  double left_;
+  double bottom_;
+  std::uint64_t frames_;
+  std::uint64_t bytes_;
+  // quantized components of the current and of the last two frames
+  std::vector<std::int64_t> current_;
+  std::vector<std::int64_t> previous_;
+  std::vector<std::int64_t> before_previous_;
+  std::vector<std::uint64_t> residuals_;
+  std::vector<std::uint8_t> widths_;  // bits of every block
+  std::vector<std::size_t> offsets_;  // of every block in the frame
+  std::vector<char> frame_;
+
+public:
+  // writes the header, throws if a step is not positive or the keyframe
+  // interval is 0
+  trajectory_encoder(std::ostream &output, std::size_t boids,
+                     dynamics::running_parameters const &parameters,
+                     codec_settings const &settings = {});
+  trajectory_encoder(trajectory_encoder const &) = delete;
+  trajectory_encoder &operator=(trajectory_encoder const &) = delete;
+
+  // throws if the flock doesn't have the size of the trajectory or a value
+  // is too far from the space to be quantized
+  void append(std::uint64_t step, double time,
+              std::vector<dynamics::Boid> const &flock);
+  std::uint64_t frames() const;
+  // bytes written so far, header included
+  std::uint64_t bytes() const;
+};
+
+// Reads the frames of a compressed trajectory in order
+class trajectory_decoder {
+private:
+  std::istream &input_;
+  std::size_t boids_;
+  codec_settings settings_;
+  dynamics::running_parameters parameters_;
+  std::uint64_t frames_;
+  std::uint64_t since_keyframe_; // frames decoded since the last keyframe
+  std::vector<std::int64_t> current_;
+  std::vector<std::int64_t> previous_;
+  std::vector<std::int64_t> before_previous_;
+  std::vector<std::size_t> offsets_;
+  std::vector<char> frame_;
+
+public:
+  // reads the header, throws if the stream is not a compressed trajectory
+  explicit trajectory_decoder(std::istream &input);
+  trajectory_decoder(trajectory_decoder const &) = delete;
+  trajectory_decoder &operator=(trajectory_decoder const &) = delete;
+
+  // decodes the next frame, false at the end of the stream. Throws if the
+  // stream is truncated or corrupted
+  bool next(decoded_frame &frame);
+  std::uint64_t frames() const;
+  std::size_t boids() const;
+  codec_settings const &settings() const;
+  dynamics::running_parameters const &parameters() const;
+};
+} // namespace io
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef DENSITY_FIELD_HPP
+#define DENSITY_FIELD_HPP
+
+#include "flock.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace view {
+// density_field is a coarse histogram of the flock over the simulation space,
+// columns x rows cells over [left_bound, right_bound] x [bottom_bound,
+// upper_bound] holding the number of boids and the sum of their velocities.
+// It is much cheaper than the analysis of every boid and its cost does not
+// grow with the size of the flock beyond the scatter
+class density_field {
+private:
+  std::size_t columns_;
+  std::size_t rows_;
+  double left_;
+  double bottom_;
+  double cell_width_;
+  double cell_height_;
+  // row major grids
+  std::vector<double> counts_;
+  std::vector<double> momentum_x_;
+  std::vector<double> momentum_y_;
+
+public:
+  // throws std::runtime_error if a side has no cells or the bounds are empty
+  density_field(std::size_t columns, std::size_t rows,
+                dynamics::running_parameters const &parameters);
+
+  // Scatters the flock on the grid, the boids are split in fixed chunks
+  // scattered in parallel on private grids which are then added in order, so
+  // the result does not depend on the number of threads. The new histogram
+  // replaces the old one, or with a persistence p in (0, 1) it is blended
+  // with it as p * old + (1 - p) * new, an exponential moving average over
+  // the steps. Throws std::runtime_error if persistence is not in [0, 1)
+  void update(std::vector<dynamics::Boid> const &flock,
+              double persistence = 0.);
+
+  // Copy of the field convolved with a Gaussian of standard deviation sigma
+  // (in units of the simulation space). The kernel is separable, so rows and
+  // columns are smoothed one after the other, and it wraps around the borders
+  // like teleport_toroidally, so the number of boids is preserved
+  density_field smoothed(double sigma) const;
+
+  std::size_t columns() const;
+  std::size_t rows() const;
+  double cell_width() const;
+  double cell_height() const;
+  // boids in a cell
+  double count(std::size_t column, std::size_t row) const;
+  // boids per unit area in a cell
+  double density(std::size_t column, std::size_t row) const;
+  // mean velocity of the boids in a cell, 0 if it is empty
+  math::R2 mean_velocity(std::size_t column, std::size_t row) const;
+  double total() const;
+  double maximum_count() const;
+};
+} // namespace view
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef ENSEMBLE_HPP
+#define ENSEMBLE_HPP
+
+#include "flock.hpp"
+#include "statistics.hpp"
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace dynamics {
+// Evenly spaced values of a swept parameter, from first to last included
+struct sweep_range {
+  double first{};
+  double last{};
+  int points{1};
+};
+
+// Values taken by a sweep_range, a single point gives first
+std::vector<double> sweep_values(sweep_range const &range);
+
+// A parameter sweep: every combination of the values of s, a and c is run
+// repetitions times, every run starting from its own seeded random flock
+struct sweep_specification {
+  running_parameters base{};   // Parameters shared by every run
+  sweep_range s{0.5, 0.5, 1};  // Separation parameters of the sweep
+  sweep_range a{0.6, 0.6, 1};  // Alignment parameters of the sweep
+  sweep_range c{0.02, 0.02, 1}; // Cohesion parameters of the sweep
+  int repetitions{1};          // Runs for every combination
+  int steps{600};              // Evolution steps of every run
+  double delta_t{1. / 60.};    // Time step of every evolution
+  std::uint64_t seed{1};       // Seed from which the run seeds are derived
+  int lanes{8};                // Most runs evolved together by a batch
+};
+
+// Reads a sweep specification made of lines "key = value", the swept
+// parameters s, a and c accept "first last points", every field of
+// running_parameters can be set by name and '#' starts a comment. Throws
+// std::runtime_error on malformed lines
+sweep_specification parse_sweep(std::istream &input);
+
+// The outcome of a single run of the ensemble
+struct run_result {
+  int index;
+  std::uint64_t seed;
+  running_parameters parameters;
+  view::data statistics;
+};
+
+// Seed of the run with the given index, it depends only on the seed of the
+// sweep and the index, so results do not depend on the scheduling
+std::uint64_t run_seed(std::uint64_t sweep_seed, int index);
+
+// Runs every flock of the sweep concurrently on parallel::thread_count()
+// threads, consecutive runs are grouped in batches of up to sweep.lanes
+// flocks evolved together by a flock_batch, fewer if needed to have a batch
+// for every thread, the results are in the order of the run indices
+std::vector<run_result> run_ensemble(sweep_specification const &sweep);
+
+// Functions to print the results as comma separated values
+std::string print_result_header_to_csv();
+std::string print_result_to_csv(run_result const &result);
+} // namespace dynamics
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef FFT_HPP
+#define FFT_HPP
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+namespace math {
+// smallest power of two not less than value
+std::size_t next_power_of_two(std::size_t value);
+
+// In place radix 2 fast Fourier transform, the size must be a power of two
+// (std::runtime_error is thrown otherwise). The forward transform is not
+// normalized, the inverse one divides by the size, so inverting gives back the
+// original values
+void fft(std::vector<std::complex<double>> &values, bool inverse = false);
+
+// Two dimensional transform of a row major grid, both sides must be powers of
+// two, the rows and then the columns are transformed in parallel
+void fft_2d(std::vector<std::complex<double>> &values, std::size_t columns,
+            std::size_t rows, bool inverse = false);
+} // namespace math
+
+#endif
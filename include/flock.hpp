@@ -2,6 +2,8 @@
 #define FLOCK_HPP
 #include "boid.hpp"
 
+#include <random>
+
 namespace dynamics {
 // A struct containing parameters necessary for the dynamics of the simulation
 // It specifies the behavior of the boids in the flock
@@ -20,6 +22,15 @@ struct running_parameters {
   double minimum_velocity{20.}; // Minimum velocity of the boids
 };
 
+// Order parameters of the flock, both are 0 for a disordered flock and 1 for a
+// perfectly ordered one
+struct order_parameters {
+  double polarization; // Norm of the mean heading (unit velocity) of the boids
+  double milling; // Norm of the mean angular momentum of the headings around
+                  // the center of mass, normalized by the root mean square
+                  // distance from it
+};
+
 // Functions that calculate the components of the boid acceleration
 // Calculate separation component of the boid acceleration
 math::R2 calculate_separation(Boid const &fixed_boid,
@@ -45,6 +56,15 @@ math::R2 limit_speed(math::R2 &to_be_checked,
 void evolve_flock(std::vector<Boid> &flock, double const delta_t,
                   running_parameters const &parameters);
 
+// same as above, the order parameters of the evolved flock are accumulated as
+// every boid is evolved, so they come without another sweep over the flock
+void evolve_flock(std::vector<Boid> &flock, double const delta_t,
+                  running_parameters const &parameters,
+                  order_parameters &order);
+
+// Order parameters of a flock, in a sweep of their own
+order_parameters calculate_order_parameters(std::vector<Boid> const &flock);
+
 // Evolve a single boid based on its neighbors and parameters
 Boid evolve_boid(std::vector<Boid> const &flock, Boid &fixed_boid,
                  double const delta_t, running_parameters const &parameters);
@@ -52,6 +72,12 @@ Boid evolve_boid(std::vector<Boid> const &flock, Boid &fixed_boid,
 // function to generate a random vector of boids following the given parameters
 std::vector<dynamics::Boid>
 create_flock(dynamics::running_parameters const &parameters);
+
+// same as above but drawing from the given engine, so that a seeded engine
+// always generates the same flock
+std::vector<dynamics::Boid>
+create_flock(dynamics::running_parameters const &parameters,
+             std::mt19937_64 &engine);
 } // namespace dynamics
 
 #endif // namespace dynamics
\ No newline at end of file
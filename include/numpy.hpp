@@ -0,0 +1,74 @@
+#ifndef NUMPY_HPP
+#define NUMPY_HPP
+
+#include "flock.hpp"
+#include "trajectory.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace io {
+// A flock is exported as a .npy array of float64 of shape (boids, 4), every
+// row r_x r_y v_x v_y, C order and in the byte order of the machine. That is
+// the layout of the boids in a std::vector<dynamics::Boid> and of the frames
+// of a trajectory, so an export is the header followed by a single write of
+// the memory of the flock, and numpy.load(path, mmap_mode='r') maps the data
+// without parsing it. Errors throw std::runtime_error
+
+// CRC-32 of zip files, size bytes added to the checksum crc of the previous
+// ones
+std::uint32_t crc32(char const *bytes, std::size_t size,
+                    std::uint32_t crc = 0);
+
+// Header of the array of a flock of the given number of boids, padded so that
+// the data start on a multiple of 64 bytes
+std::string npy_header(std::size_t boids);
+
+void write_npy(std::ostream &output, std::vector<dynamics::Boid> const &flock);
+void write_npy(std::ostream &output, frame_view const &frame);
+void save_npy(std::string const &path,
+              std::vector<dynamics::Boid> const &flock);
+void save_npy(std::string const &path, frame_view const &frame);
+
+// Writes a .npz archive, a zip file of arrays stored without compression,
+// numpy.load(path)[name] gives the array added with that name. The archive
+// is complete only after close, it has no zip64 records so it is limited to
+// 65535 arrays and 4 GiB
+class npz_writer {
+private:
+  struct entry {
+    std::string name; // in the archive, with the .npy extension
+    std::uint32_t crc;
+    std::uint32_t size;
+    std::uint32_t offset; // of the local header
+  };
+
+  std::string path_;
+  std::ofstream file_;
+  std::uint64_t offset_; // bytes written so far
+  std::vector<entry> entries_;
+
+  void add(std::string const &name, char const *data, std::size_t boids);
+
+public:
+  // creates (or truncates) the file, throws if it can't be created
+  explicit npz_writer(std::string const &path);
+  npz_writer(npz_writer const &) = delete;
+  npz_writer &operator=(npz_writer const &) = delete;
+  // closes the archive if close was not called, errors are lost
+  ~npz_writer();
+
+  // throws if the name is already in the archive or the archive would be
+  // larger than 4 GiB
+  void add(std::string const &name, std::vector<dynamics::Boid> const &flock);
+  void add(std::string const &name, frame_view const &frame);
+  // writes the central directory of the zip file and closes it
+  void close();
+};
+} // namespace io
+
+#endif
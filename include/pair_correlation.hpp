@@ -0,0 +1,50 @@
+#ifndef PAIR_CORRELATION_HPP
+#define PAIR_CORRELATION_HPP
+
+#include "flock.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace view {
+// pair_correlation accumulates the radial distribution function g(r) of the
+// flock over many frames. The simulation space is the periodic domain of
+// teleport_toroidally, so distances follow the minimum image convention and
+// g(r) is normalized by the ideal gas of the same density, g(r) = 1 for
+// uncorrelated boids. The couples closer than r_max are found with a cell
+// list and counted in a histogram of atomic counters, so frames can be added
+// concurrently from different threads without locks
+class pair_correlation {
+private:
+  double r_max_;
+  double bin_width_;
+  double area_;
+  dynamics::running_parameters parameters_;
+  std::vector<std::atomic<std::uint64_t>> counts_; // couples in every bin
+  std::atomic<std::uint64_t> frames_;
+  std::atomic<std::uint64_t> couples_; // sum of n (n - 1) / 2 over the frames
+
+public:
+  // r_max can be at most half the shortest side of the space, otherwise the
+  // minimum image would miss couples, throws std::runtime_error if it isn't
+  pair_correlation(double r_max, std::size_t bins,
+                   dynamics::running_parameters const &parameters);
+
+  // counts the couples of a frame, it can be called concurrently
+  void add_frame(std::vector<dynamics::Boid> const &flock);
+  void reset();
+
+  std::size_t bins() const;
+  double bin_width() const;
+  std::uint64_t frames() const;
+  // centers of the bins
+  std::vector<double> radii() const;
+  // g(r) at the centers of the bins, 0 before the first frame. While frames
+  // are being added the counters may be read halfway through a frame
+  std::vector<double> values() const;
+};
+} // namespace view
+
+#endif
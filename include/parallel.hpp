@@ -0,0 +1,127 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+// Number of threads used by the parallel algorithms, by default it is the
+// hardware concurrency of the machine
+unsigned thread_count();
+void thread_count(unsigned new_count);
+
+// Size of the blocks in which the deterministic reductions split their range,
+// it is fixed so that the shape of the summation tree depends only on the
+// number of terms and never on the number of threads
+constexpr std::size_t reduction_block_size{256};
+
+// Waits a little longer at every call with the same idle counter (0 at the
+// first one), first yielding and then sleeping, so a short wait for another
+// thread costs no latency and a long one no processor time
+void back_off(unsigned &idle);
+
+namespace detail {
+// true on the threads that are already running the body of a parallel_for,
+// nested parallel algorithms run serially there
+bool &inside_parallel_region();
+} // namespace detail
+
+// Calls body(i) for every i in [0, count), the indices are handed out
+// dynamically to at most thread_count() threads, the first exception thrown by
+// the body is rethrown on the calling thread
+template <typename Body>
+void parallel_for(std::size_t count, Body const &body) {
+  std::size_t const workers =
+      detail::inside_parallel_region()
+          ? 1
+          : std::min<std::size_t>(count, thread_count());
+  if (workers < 2) {
+    for (std::size_t i{}; i != count; ++i) {
+      body(i);
+    }
+    return;
+  }
+
+  std::atomic<std::size_t> next_index{0};
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  auto work = [&]() {
+    bool &inside = detail::inside_parallel_region();
+    bool const was_inside = inside;
+    inside = true;
+    try {
+      for (std::size_t i = next_index++; i < count; i = next_index++) {
+        body(i);
+      }
+    } catch (...) {
+      std::lock_guard<std::mutex> lock{error_mutex};
+      if (!error) {
+        error = std::current_exception();
+      }
+      // the remaining indices are skipped
+      next_index = count;
+    }
+    inside = was_inside;
+  };
+
+  // the calling thread works too, so only workers - 1 threads are spawned
+  std::vector<std::thread> pool;
+  pool.reserve(workers - 1);
+  for (std::size_t w{1}; w != workers; ++w) {
+    pool.emplace_back(work);
+  }
+  work();
+  for (auto &thread : pool) {
+    thread.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+// Sums term(i) for i in [first, last) splitting the range in halves until the
+// pieces are short enough to be summed in order, T must be value initialized
+// to zero and provide operator+ (e.g. double and math::R2)
+template <typename T, typename Term>
+T pairwise_sum(std::size_t first, std::size_t last, Term const &term) {
+  if (last - first <= 8) {
+    T sum{};
+    for (std::size_t i{first}; i != last; ++i) {
+      sum = sum + term(i);
+    }
+    return sum;
+  }
+  std::size_t const middle = first + (last - first) / 2;
+  return pairwise_sum<T>(first, middle, term) +
+         pairwise_sum<T>(middle, last, term);
+}
+
+// Sums term(i) for i in [0, count) in parallel, the range is cut in blocks of
+// reduction_block_size terms summed pairwise and the partial sums of the
+// blocks are again summed pairwise, so the result is bitwise identical for
+// any number of threads
+template <typename T, typename Term>
+T deterministic_sum(std::size_t count, Term const &term) {
+  std::size_t const blocks =
+      (count + reduction_block_size - 1) / reduction_block_size;
+  if (blocks < 2) {
+    return pairwise_sum<T>(0, count, term);
+  }
+  std::vector<T> partial_sums(blocks);
+  parallel_for(blocks, [&](std::size_t block) {
+    std::size_t const first = block * reduction_block_size;
+    std::size_t const last = std::min(count, first + reduction_block_size);
+    partial_sums[block] = pairwise_sum<T>(first, last, term);
+  });
+  return pairwise_sum<T>(0, blocks, [&](std::size_t block) {
+    return partial_sums[block];
+  });
+}
+} // namespace parallel
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef RECORDER_HPP
+#define RECORDER_HPP
+
+#include "flock.hpp"
+#include "spsc_queue.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace io {
+// Destination of the recorded frames, for example the append of a
+// trajectory_writer or of a trajectory_encoder
+using frame_sink = std::function<void(
+    std::uint64_t step, double time, std::vector<dynamics::Boid> const &flock)>;
+
+// What record does when every buffer is waiting to be written
+enum class backpressure {
+  block,   // waits for the writer, no frame is lost
+  drop,    // the frame is dropped
+  decimate // the frame is dropped and from then on only one frame in 2, 4,
+           // ... is recorded, the rate recovers as the writer catches up
+};
+
+struct recorder_statistics {
+  std::uint64_t offered; // Frames passed to record
+  std::uint64_t queued;  // Frames handed to the writer thread
+  std::uint64_t written; // Frames passed to the sink
+  std::uint64_t dropped; // Frames dropped by the backpressure policy
+  std::uint64_t decimation; // One frame in decimation is being recorded
+};
+
+// recorder moves the writes of a recording off the simulation thread. The
+// frames are copied into buffers of a pool allocated once, whose indices go
+// to a writer thread through a lock-free single producer single consumer
+// queue and come back through another one once the sink has written them, so
+// the simulation never takes a lock nor allocates. An idle writer thread, or a
+// blocked record, backs off by yielding and then sleeping briefly. If the
+// sink throws, the writer keeps recycling the buffers without writing and the
+// exception is rethrown by the next record or by close
+class recorder {
+private:
+  struct frame_buffer {
+    std::uint64_t step;
+    double time;
+    std::vector<dynamics::Boid> flock;
+  };
+
+  frame_sink sink_;
+  backpressure policy_;
+  std::vector<frame_buffer> buffers_;
+  parallel::spsc_queue<std::size_t> full_; // written by record
+  parallel::spsc_queue<std::size_t> free_; // written by the writer thread
+  std::atomic<bool> stopping_;
+  std::atomic<bool> failed_;
+  std::exception_ptr error_; // published by failed_
+  std::atomic<std::uint64_t> offered_;
+  std::atomic<std::uint64_t> queued_;
+  std::atomic<std::uint64_t> written_;
+  std::atomic<std::uint64_t> dropped_;
+  std::atomic<std::uint64_t> decimation_;
+  std::thread thread_;
+
+  void work();
+
+public:
+  // buffers is the number of frames that can wait to be written, throws
+  // std::runtime_error if it is 0
+  recorder(frame_sink sink, std::size_t boids, std::size_t buffers = 8,
+           backpressure policy = backpressure::block);
+  recorder(recorder const &) = delete;
+  recorder &operator=(recorder const &) = delete;
+  // writes the queued frames and stops the thread if close was not called
+  ~recorder();
+
+  // copies the frame for the writer thread, from a single thread. Returns
+  // false if the frame was dropped
+  bool record(std::uint64_t step, double time,
+              std::vector<dynamics::Boid> const &flock);
+  // waits for the queued frames to be written and stops the thread, rethrows
+  // the exception of the sink if any
+  void close();
+  recorder_statistics statistics() const;
+};
+} // namespace io
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef REGION_HPP
+#define REGION_HPP
+
+#include "flock.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace io {
+// Version written by region_writer
+constexpr std::uint32_t region_version{1};
+
+// A region of interest of the simulation space, a rectangle or a polygon
+class region {
+private:
+  std::vector<math::R2> vertices_;
+  math::R2 lower_; // bounding box
+  math::R2 upper_;
+  bool rectangle_;
+
+public:
+  // the rectangle [left, right] x [bottom, top], throws std::runtime_error
+  // if it is empty
+  region(double left, double bottom, double right, double top);
+  // a polygon with its vertices in order, its inside follows the even-odd
+  // rule. Throws std::runtime_error with less than three vertices
+  explicit region(std::vector<math::R2> const &vertices);
+
+  bool contains(math::R2 const &point) const;
+  bool rectangle() const;
+  // the corners of a rectangle counterclockwise from lower
+  std::vector<math::R2> const &vertices() const;
+  math::R2 lower() const;
+  math::R2 upper() const;
+};
+
+// Region of "left,bottom,right,top" or of the coordinates of the vertices of
+// a polygon "x1,y1,x2,y2,x3,y3,...", throws std::runtime_error otherwise
+region parse_region(std::string const &text);
+
+// Indices (in increasing order) and copies of the boids of flock inside the
+// region. The boids near it are found by a query of a cell list over the
+// space of parameters, only they are tested. The vectors are reused
+void select_region(region const &selection,
+                   std::vector<dynamics::Boid> const &flock,
+                   dynamics::running_parameters const &parameters,
+                   std::vector<std::uint32_t> &ids,
+                   std::vector<dynamics::Boid> &selected);
+
+// A region trajectory records only the boids inside a region, with the index
+// of every boid in the flock, so its frames have different sizes. The boids
+// are written as they are in memory, so a frame is three writes, and only
+// little endian machines are supported. The format:
+//   "BOIDREGN", version (u32), rectangle (u32), boids of the flock (u64),
+//   vertices (u64), boids_number (i64) and the eleven doubles of
+//   running_parameters in their order of declaration, x y (f64) of every
+//   vertex, then for every frame: step (u64), time (f64), selected boids
+//   (u64), their ids (u32) padded with zeros to a multiple of 8 bytes and
+//   r_x r_y v_x v_y (f64) of every selected boid
+// Errors throw std::runtime_error
+class region_writer {
+private:
+  std::ostream &output_;
+  region region_;
+  dynamics::running_parameters parameters_;
+  std::size_t boids_;
+  std::uint64_t frames_;
+  std::uint64_t bytes_;
+  std::vector<std::uint32_t> ids_;
+  std::vector<dynamics::Boid> selected_;
+
+public:
+  // writes the header
+  region_writer(std::ostream &output, region const &selection,
+                std::size_t boids,
+                dynamics::running_parameters const &parameters);
+  region_writer(region_writer const &) = delete;
+  region_writer &operator=(region_writer const &) = delete;
+
+  // records the boids of flock inside the region, throws if the flock
+  // doesn't have the size of the trajectory
+  void append(std::uint64_t step, double time,
+              std::vector<dynamics::Boid> const &flock);
+  std::uint64_t frames() const;
+  // bytes written so far, header included
+  std::uint64_t bytes() const;
+};
+
+// Frame returned by region_reader
+struct region_frame {
+  std::uint64_t step{};
+  double time{};
+  std::vector<std::uint32_t> ids{};         // index of every boid in the flock
+  std::vector<dynamics::Boid> flock{};      // the boids inside the region
+};
+
+// Reads the frames of a region trajectory in order
+class region_reader {
+private:
+  std::istream &input_;
+  std::size_t boids_;
+  dynamics::running_parameters parameters_;
+  std::vector<math::R2> vertices_;
+  bool rectangle_;
+
+public:
+  // reads the header, throws if the stream is not a region trajectory
+  explicit region_reader(std::istream &input);
+  region_reader(region_reader const &) = delete;
+  region_reader &operator=(region_reader const &) = delete;
+
+  // reads the next frame, false at the end of the stream. Throws if the
+  // stream is truncated or corrupted
+  bool next(region_frame &frame);
+  std::size_t boids() const;
+  dynamics::running_parameters const &parameters() const;
+  region selection() const;
+};
+} // namespace io
+
+#endif
@@ -1,37 +1,58 @@
 #ifndef RENDER_HPP
 #define RENDER_HPP
 
-#include "flock.hpp" 
+#include "density_field.hpp"
+#include "flock.hpp"
+#include "recorder.hpp"
+#include "region.hpp"
+#include "snapshot.hpp"
+#include "statistics.hpp"
 #include <SFML/Graphics.hpp>
 #include <SFML/Window.hpp>
 #include <iostream>
+#include <optional>
 
 namespace view {
 
-// Data structure to hold statistical information about the flock
-struct data {
-  double mean_distance;
-  double sigma_mean_distance;
-  double mean_velocity;
-  double sigma_mean_velocity;
-};
-
-// Function to build statistical data from the flock
-data build_data(std::vector<dynamics::Boid> const &flock);
-
-// Function to convert statistical data to a string for printing
-std::string
-print_data_to_string(data const &to_be_printed,
-                     dynamics::running_parameters const &parameters);
-
 // Function to render the boids in the simulation window
 void render_boids(std::vector<dynamics::Boid> const &flock,
                   dynamics::running_parameters const &parameters,
                   sf::RenderWindow &simulation_window);
+// same as above, over a heatmap of the density of the flock
+void render_boids(std::vector<dynamics::Boid> const &flock,
+                  dynamics::running_parameters const &parameters,
+                  sf::RenderWindow &simulation_window,
+                  density_field const &heatmap);
+
+// Options of a run of the simulation, the step and time it starts from (not 0
+// when it is resumed from a snapshot) and where to checkpoint it
+struct simulation_options {
+  std::uint64_t first_step{};
+  double start_time{};
+  std::mt19937_64 engine{}; // Saved in the checkpoints
+  std::string checkpoint{}; // Snapshot file written during the run and when
+                            // the windows are closed, none if empty
+  double checkpoint_interval{60.}; // Wall clock seconds between checkpoints
+  std::string trajectory{}; // File recording every step, none if empty
+  std::string compressed_trajectory{}; // Same, with the quantized codec
+  std::string region_trajectory{}; // Same, only the boids inside region
+  std::optional<io::region> region{};
+  // what the recordings do when the disk can't keep up
+  io::backpressure record_policy{io::backpressure::block};
+  // how the checkpoints, the compressed and the region trajectory reach the
+  // disk
+  io::io_backend io_backend{io::io_backend::automatic};
+};
 
 // Function to run the simulation with the given flock and parameters
 void run_simulation(std::vector<dynamics::Boid> &flock,
                     dynamics::running_parameters const &parameters);
+void run_simulation(std::vector<dynamics::Boid> &flock,
+                    dynamics::running_parameters const &parameters,
+                    simulation_options const &options);
+
+// Function to play a recorded trajectory without simulating it
+void run_replay(std::string const &path);
 
 // Function to create default running parameters for the simulation
 dynamics::running_parameters create_parameters();
@@ -0,0 +1,71 @@
+#ifndef REPLAY_HPP
+#define REPLAY_HPP
+
+#include "trajectory.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace view {
+// Playhead of a replay, it moves through the recorded time at speed times
+// the wall clock time, backwards if the speed is negative, and pauses when it
+// reaches either end of the recording
+class playback {
+private:
+  double first_;
+  double last_;
+  double time_;
+  double speed_;
+  bool paused_;
+
+public:
+  // starts paused at first_time, throws std::runtime_error if last_time is
+  // before first_time
+  playback(double first_time, double last_time);
+
+  void advance(double wall_seconds);
+  // moves the playhead, clamped to the recording
+  void seek(double time);
+  double time() const;
+  double speed() const;
+  void speed(double new_speed);
+  bool paused() const;
+  void paused(bool new_paused);
+};
+
+// replay_prefetcher reads ahead of the playhead of a mapped trajectory on a
+// background thread, so that the frames are in memory before they are shown.
+// follow never waits: it only records where the playhead is and the direction
+// of the playback, and the thread prefetches the next frames in that
+// direction that it did not prefetch already
+class replay_prefetcher {
+private:
+  io::trajectory_reader const &reader_;
+  std::uint64_t ahead_;
+  std::mutex mutex_;
+  std::condition_variable wake_up_;
+  std::uint64_t playhead_;
+  bool forward_;
+  bool moved_;
+  bool stopping_;
+  std::uint64_t prefetched_; // frames prefetched so far
+  std::thread thread_;
+
+  void work();
+
+public:
+  // ahead frames are kept ready in the direction of the playback
+  replay_prefetcher(io::trajectory_reader const &reader,
+                    std::uint64_t ahead = 120);
+  replay_prefetcher(replay_prefetcher const &) = delete;
+  replay_prefetcher &operator=(replay_prefetcher const &) = delete;
+  ~replay_prefetcher();
+
+  void follow(std::uint64_t frame, bool forward);
+  std::uint64_t prefetched();
+};
+} // namespace view
+
+#endif
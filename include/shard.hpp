@@ -0,0 +1,36 @@
+#ifndef SHARD_HPP
+#define SHARD_HPP
+
+#include "flock.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace dynamics {
+// Options of a simulation sharded across several processes, the simulation
+// space is cut in vertical strips of equal width and every strip is evolved
+// by its own process
+struct shard_options {
+  int shards{2};              // Number of processes, one for every strip
+  int steps{1};               // Number of evolution steps
+  double delta_t{1. / 60.};   // Time step of every evolution
+  std::size_t ring_capacity{}; // Boids held by a ring buffer, 0 means enough
+                               // for the whole flock
+};
+
+// Index of the strip containing the point r
+int find_shard(math::R2 const &r, running_parameters const &parameters,
+               int shards);
+
+// Evolves the flock for options.steps steps forking options.shards processes
+// that exchange the boids near the borders of their strips (and the ones
+// leaving them) through ring buffers in POSIX shared memory, the processes
+// move in lockstep and the evolved flock is gathered at the end (its order is
+// not preserved). If a process fails the others are stopped and
+// std::runtime_error is thrown
+std::vector<Boid> run_sharded(std::vector<Boid> const &flock,
+                              running_parameters const &parameters,
+                              shard_options const &options);
+} // namespace dynamics
+
+#endif
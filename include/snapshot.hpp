@@ -0,0 +1,70 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include "async_writer.hpp"
+#include "flock.hpp"
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace io {
+// Version written by write_snapshot, older versions can still be read
+constexpr std::uint32_t snapshot_version{1};
+
+// The whole state of a simulation, enough to continue it exactly
+struct snapshot {
+  std::uint64_t step{};
+  double time{}; // Simulated time
+  dynamics::running_parameters parameters{};
+  std::mt19937_64 engine{}; // Random engine after the creation of the flock
+  std::vector<dynamics::Boid> flock{};
+};
+
+// Binary format of a snapshot, every number is little endian and every double
+// an IEEE 754 binary64, whatever the machine:
+//   "BOIDSNAP", version (u32), reserved (u32), step (u64), time (f64),
+//   boids_number (i64) and the eleven doubles of running_parameters in their
+//   order of declaration, length (u64) and text of the state of the engine,
+//   number of boids (u64), r_x r_y v_x v_y (f64) of every boid,
+//   FNV-1a 64 hash (u64) of all the previous bytes
+// The boids are written and read in bulk. Errors throw std::runtime_error
+void write_snapshot(std::ostream &output, snapshot const &to_be_written);
+snapshot read_snapshot(std::istream &input);
+
+// Same as above for files, the snapshot is written to a temporary file synced
+// to the disk and renamed over path, so a crash while checkpointing never
+// leaves a broken file
+void save_snapshot(std::string const &path, snapshot const &to_be_saved);
+snapshot load_snapshot(std::string const &path);
+
+// Saves checkpoints without waiting for the disk. save serializes the
+// snapshot into the buffers of an async_file_writer writing the temporary
+// file and returns, the temporary file is synced and renamed over path once
+// its writes are complete, by the next save or by finish, until then the
+// previous checkpoint stays in place. The writer, with its buffers and ring,
+// is created by the first save and reopened by the next ones
+class snapshot_saver {
+private:
+  io_backend backend_;
+  std::unique_ptr<async_file_writer> writer_;
+  std::string path_;
+  bool pending_;
+
+public:
+  explicit snapshot_saver(io_backend backend = io_backend::automatic);
+  snapshot_saver(snapshot_saver const &) = delete;
+  snapshot_saver &operator=(snapshot_saver const &) = delete;
+  // finishes the pending save, its errors are lost
+  ~snapshot_saver();
+
+  void save(std::string const &path, snapshot const &to_be_saved);
+  // waits for the pending save and renames its file, if any
+  void finish();
+};
+} // namespace io
+
+#endif
@@ -0,0 +1,171 @@
+#ifndef SPATIAL_HPP
+#define SPATIAL_HPP
+
+#include "flock.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace dynamics {
+// cell_list is a uniform grid over the simulation space used to find the boids
+// closer than a radius without looking at the whole flock. The boids are
+// sorted by cell in a compressed layout, the boids of cell c are the ones in
+// [cell_start(c), cell_start(c + 1)) and their positions are stored in the
+// same order, so a cell is read from contiguous memory. In a periodic list the
+// opposite borders of the space are neighbors and the displacements follow
+// the minimum image convention, otherwise (like get_neighborhood) distances do
+// not wrap around the borders
+class cell_list {
+private:
+  double left_;
+  double bottom_;
+  double width_;
+  double height_;
+  double cell_width_;
+  double cell_height_;
+  int columns_;
+  int rows_;
+  bool periodic_;
+  std::vector<std::size_t> cell_start_; // columns_ * rows_ + 1 offsets
+  std::vector<std::size_t> indices_;    // index in the flock of every boid
+  std::vector<double> x_;               // positions, in cell order
+  std::vector<double> y_;
+
+  int column(double x) const;
+  int row(double y) const;
+
+  // calls visit(i) once for every index of the cells closer than reach cells
+  // to center along an axis of count cells
+  template <typename Visit>
+  void for_each_index(int center, int reach, int count,
+                      Visit const &visit) const {
+    if (periodic_ && 2 * reach + 1 >= count) {
+      for (int i{}; i != count; ++i) {
+        visit(i);
+      }
+    } else if (periodic_) {
+      for (int offset{-reach}; offset <= reach; ++offset) {
+        visit(((center + offset) % count + count) % count);
+      }
+    } else {
+      int const last = std::min(count - 1, center + reach);
+      for (int i{std::max(0, center - reach)}; i <= last; ++i) {
+        visit(i);
+      }
+    }
+  }
+
+  // calls visit(first, last) for the ranges of the cells that may contain
+  // boids closer than radius to a point in the cell (column, row)
+  template <typename Visit>
+  void for_each_cell_near(int column, int row, double radius,
+                          Visit const &visit) const {
+    int const reach_x = static_cast<int>(std::ceil(radius / cell_width_));
+    int const reach_y = static_cast<int>(std::ceil(radius / cell_height_));
+    for_each_index(row, reach_y, rows_, [&](int near_row) {
+      for_each_index(column, reach_x, columns_, [&](int near_column) {
+        std::size_t const cell =
+            static_cast<std::size_t>(near_row) * columns_ + near_column;
+        visit(cell_start_[cell], cell_start_[cell + 1]);
+      });
+    });
+  }
+
+  // minimum image of a displacement along an axis of the given extent
+  double wrap(double delta, double extent) const {
+    return periodic_ ? delta - extent * std::round(delta / extent) : delta;
+  }
+
+public:
+  // the cells are at least cell_size wide, the space is the one of the bounds
+  // of parameters. Throws std::runtime_error if cell_size is not positive
+  cell_list(std::vector<Boid> const &flock, double cell_size,
+            running_parameters const &parameters, bool periodic = false);
+
+  std::size_t size() const;
+  int columns() const;
+  int rows() const;
+  bool periodic() const;
+  std::size_t cell_start(std::size_t cell) const;
+  // index in the flock of the boid in position k of the cell order
+  std::size_t index(std::size_t k) const;
+  math::R2 position(std::size_t k) const;
+  // displacement from a point to another, minimum image if periodic
+  math::R2 displacement(math::R2 const &from, math::R2 const &to) const;
+
+  // Calls visit(i, displacement) for every boid i of the flock closer than
+  // radius to point, displacement goes from point to the boid
+  template <typename Visit>
+  void for_each_neighbor(math::R2 const &point, double radius,
+                         Visit const &visit) const {
+    double const radius_squared = radius * radius;
+    for_each_cell_near(column(point.x), row(point.y), radius,
+                       [&](std::size_t first, std::size_t last) {
+                         for (std::size_t k{first}; k != last; ++k) {
+                           double const dx = wrap(x_[k] - point.x, width_);
+                           double const dy = wrap(y_[k] - point.y, height_);
+                           if (dx * dx + dy * dy < radius_squared) {
+                             visit(indices_[k], math::R2{dx, dy});
+                           }
+                         }
+                       });
+  }
+
+  // Calls visit(i, position) for every boid of the flock in the cells that
+  // overlap the box from lower to upper, a superset of the boids inside it
+  // that the caller tests. The cells of a row are contiguous, so every row
+  // is a single range of memory. The box never wraps around the borders
+  template <typename Visit>
+  void for_each_in_box(math::R2 const &lower, math::R2 const &upper,
+                       Visit const &visit) const {
+    if (!(lower.x <= upper.x) || !(lower.y <= upper.y)) {
+      return;
+    }
+    int const first_column = column(lower.x);
+    int const last_column = column(upper.x);
+    for (int near_row{row(lower.y)}; near_row <= row(upper.y); ++near_row) {
+      std::size_t const first =
+          static_cast<std::size_t>(near_row) * columns_ + first_column;
+      std::size_t const last =
+          static_cast<std::size_t>(near_row) * columns_ + last_column + 1;
+      for (std::size_t k{cell_start_[first]}; k != cell_start_[last]; ++k) {
+        visit(indices_[k], math::R2{x_[k], y_[k]});
+      }
+    }
+  }
+
+  // Calls visit(i, j, displacement) once for every couple of distinct boids
+  // closer than radius, displacement goes from boid i to boid j. The cells
+  // are distributed across threads with parallel::parallel_for, so visit is
+  // called concurrently and in no particular order
+  template <typename Visit>
+  void for_each_pair(double radius, Visit const &visit) const {
+    double const radius_squared = radius * radius;
+    std::size_t const cells = static_cast<std::size_t>(columns_) * rows_;
+    parallel::parallel_for(cells, [&](std::size_t cell) {
+      int const cell_column = static_cast<int>(cell % columns_);
+      int const cell_row = static_cast<int>(cell / columns_);
+      for (std::size_t k{cell_start_[cell]}; k != cell_start_[cell + 1]; ++k) {
+        // every near cell is visited once, so taking only the boids after k
+        // in the cell order finds every couple once
+        for_each_cell_near(
+            cell_column, cell_row, radius,
+            [&](std::size_t first, std::size_t last) {
+              for (std::size_t m{std::max(first, k + 1)}; m < last; ++m) {
+                double const dx = wrap(x_[m] - x_[k], width_);
+                double const dy = wrap(y_[m] - y_[k], height_);
+                if (dx * dx + dy * dy < radius_squared) {
+                  visit(indices_[k], indices_[m], math::R2{dx, dy});
+                }
+              }
+            });
+      }
+    });
+  }
+};
+} // namespace dynamics
+
+#endif
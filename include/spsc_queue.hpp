@@ -0,0 +1,70 @@
+#ifndef SPSC_QUEUE_HPP
+#define SPSC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace parallel {
+// Bounded lock-free queue between exactly one producer thread and one
+// consumer thread. The slots are a ring whose size is a power of two, the
+// producer only writes the tail and the consumer only writes the head, so
+// neither ever waits for the other: a full queue refuses the push and an
+// empty one the pop. The two indices live on different cache lines, so the
+// threads don't invalidate each other's line at every operation
+template <typename T> class spsc_queue {
+private:
+  std::vector<T> slots_;
+  std::size_t mask_;
+  alignas(64) std::atomic<std::size_t> head_; // next slot to pop
+  alignas(64) std::atomic<std::size_t> tail_; // next slot to push
+
+  static std::size_t round_up(std::size_t capacity) {
+    std::size_t size{1};
+    while (size < capacity) {
+      size *= 2;
+    }
+    return size;
+  }
+
+public:
+  // the capacity is rounded up to a power of two
+  explicit spsc_queue(std::size_t capacity)
+      : slots_(round_up(capacity)), mask_{slots_.size() - 1}, head_{0},
+        tail_{0} {}
+  spsc_queue(spsc_queue const &) = delete;
+  spsc_queue &operator=(spsc_queue const &) = delete;
+
+  // producer only, false if the queue is full
+  bool try_push(T value) {
+    std::size_t const tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == slots_.size()) {
+      return false;
+    }
+    slots_[tail & mask_] = std::move(value);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // consumer only, false if the queue is empty
+  bool try_pop(T &value) {
+    std::size_t const head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    value = std::move(slots_[head & mask_]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // exact only when neither thread is working on the queue
+  std::size_t size() const {
+    return tail_.load(std::memory_order_acquire) -
+           head_.load(std::memory_order_acquire);
+  }
+  std::size_t capacity() const { return slots_.size(); }
+};
+} // namespace parallel
+
+#endif
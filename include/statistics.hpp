@@ -0,0 +1,103 @@
+#ifndef STATISTICS_HPP
+#define STATISTICS_HPP
+
+#include "flock.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace view {
+// Bins of the nearest neighbor histogram of data
+constexpr std::size_t nearest_bins{8};
+
+// Data structure to hold statistical information about the flock, it is made
+// of doubles only, so that time_series can follow every field
+struct data {
+  double mean_distance;
+  double sigma_mean_distance;
+  double mean_velocity;
+  double sigma_mean_velocity;
+  double confidence_mean_distance{}; // Half width of the 95% confidence
+                                     // interval of mean_distance, 0 if exact
+  double polarization{};             // Order parameters of the flock
+  double milling{};
+  double mean_nearest_distance{}; // Distance of every boid from the closest
+  double sigma_nearest_distance{}; // other one, a measure of local packing
+  double nearest_bin_width{}; // Width of the bins of nearest_histogram, which
+  std::array<double, nearest_bins> nearest_histogram{}; // holds the fraction
+                                                        // of boids in each
+};
+
+// Options of build_data, above exact_limit boids the distances between
+// couples of boids are estimated from random samples instead of enumerating
+// all of them
+struct statistics_options {
+  std::size_t exact_limit{2000};
+  std::size_t samples{20000};
+  std::uint64_t seed{1}; // the same flock always gives the same estimate
+  double nearest_bin_width{9. / nearest_bins}; // nearest_bins bins cover the
+                                               // default neighborhood
+};
+
+// Options whose nearest neighbor histogram covers the neighborhood of the
+// parameters, the distances in [0, d), so that the bins past d_s show how
+// close the boids get beyond the separation distance
+statistics_options
+statistics_options_for(dynamics::running_parameters const &parameters);
+
+// Estimate of the mean and standard deviation of the distances between
+// couples of boids
+struct distance_estimate {
+  double mean;
+  double sigma;
+  double confidence; // Half width of the 95% confidence interval of mean
+  std::size_t samples;
+};
+
+// Estimates the distances drawing samples random couples of distinct boids
+distance_estimate estimate_distances(std::vector<dynamics::Boid> const &flock,
+                                     std::size_t samples,
+                                     std::mt19937_64 &engine);
+
+// Distribution of the distances of the boids from their nearest neighbor,
+// histogram[k] counts the distances in [k * bin_width, (k + 1) * bin_width)
+// and overflow the ones beyond the last bin
+struct nearest_neighbor_data {
+  double mean;
+  double sigma;
+  double bin_width;
+  std::vector<std::size_t> histogram;
+  std::size_t overflow;
+};
+
+// Finds the nearest neighbor of every boid with a cell list in O(n) expected
+// time, all zero with less than two boids. Throws std::runtime_error if
+// bin_width is not positive
+nearest_neighbor_data
+calculate_nearest_neighbors(std::vector<dynamics::Boid> const &flock,
+                            std::size_t bins = 0, double bin_width = 1.);
+
+// Function to build statistical data from the flock, the order parameters
+// are those of a flock just evolved by evolve_flock, which come with the
+// evolution, so the flock is not swept again for them
+data build_data(std::vector<dynamics::Boid> const &flock,
+                dynamics::order_parameters const &order,
+                statistics_options const &options = {});
+// same for a flock read or evolved without them, they take a sweep of their
+// own
+data build_data(std::vector<dynamics::Boid> const &flock);
+data build_data(std::vector<dynamics::Boid> const &flock,
+                statistics_options const &options);
+
+// Function to convert statistical data to a string for printing
+std::string
+print_data_to_string(data const &to_be_printed,
+                     dynamics::running_parameters const &parameters);
+
+} // namespace view
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef STATISTICS_WORKER_HPP
+#define STATISTICS_WORKER_HPP
+
+#include "statistics.hpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace view {
+// statistics_worker computes build_data on a background thread, so that the
+// frame loop never waits for the O(n^2) statistics. Snapshots of the flock are
+// submitted without blocking, a snapshot submitted while the worker is busy
+// replaces the pending one, and the most recent completed result can be read
+// at any time
+class statistics_worker {
+private:
+  statistics_options options_;
+  std::mutex mutex_;
+  std::condition_variable wake_up_;
+  std::vector<dynamics::Boid> pending_;
+  dynamics::order_parameters pending_order_;
+  bool has_pending_;
+  bool stopping_;
+  std::optional<data> latest_;
+  unsigned long completed_;
+  std::thread thread_;
+
+  void work();
+
+public:
+  explicit statistics_worker(statistics_options const &options = {});
+  statistics_worker(statistics_worker const &) = delete;
+  statistics_worker &operator=(statistics_worker const &) = delete;
+  // waits for the statistics being computed and stops the thread
+  ~statistics_worker();
+
+  // hands a copy of the flock to the worker with the order parameters given
+  // by its evolution, it never waits for a computation
+  void submit(std::vector<dynamics::Boid> const &flock,
+              dynamics::order_parameters const &order);
+  // result of the most recent completed computation, if any
+  std::optional<data> latest();
+  // number of completed computations
+  unsigned long completed();
+};
+} // namespace view
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef TIME_SERIES_HPP
+#define TIME_SERIES_HPP
+
+#include "statistics.hpp"
+#include "welford.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace view {
+// Statistics of a step of the simulation and its timing. The order
+// parameters come with the evolution of every step, the other fields of
+// statistics are the latest result of the statistics worker, computed on an
+// earlier flock, and they are 0 until its first result
+struct sample {
+  std::uint64_t step;
+  double time;         // Simulated time at the end of the step
+  double step_seconds; // Wall clock time taken by the evolution of the step
+  std::uint64_t statistics_step; // Step at which the worker fields were
+                                 // last updated
+  data statistics;
+};
+
+// Mean and standard deviation of the last samples of a time series
+struct window_summary {
+  std::uint64_t samples; // Samples in the window, fewer than its size at the
+                         // beginning of the series
+  double mean_step_seconds;
+  double sigma_step_seconds;
+  std::uint64_t statistics_step; // Of the last sample
+  data mean;
+  data sigma;
+};
+
+// time_series keeps the last capacity samples appended by a single writer in
+// a ring buffer that any number of readers can copy at any time. Nobody ever
+// waits: every slot is a sequence lock, the writer marks the slot as being
+// written, stores the sample and marks it as complete, and a reader discards
+// a slot whose mark changed while it was copying it (it was overwritten). The
+// samples are stored in atomic words, so there are no data races even when a
+// copy is discarded. The writer also keeps the mean and standard deviation of
+// the last window samples, updated at every push by adding the new sample and
+// removing the one leaving the window, and publishes them the same way
+class time_series {
+private:
+  static constexpr std::size_t sample_words{sizeof(sample) /
+                                            sizeof(std::uint64_t)};
+  static constexpr std::size_t summary_words{sizeof(window_summary) /
+                                             sizeof(std::uint64_t)};
+
+  // odd sequences are written, the sequence of the k-th sample (from 0) is
+  // 2 k + 2 once it is complete
+  template <std::size_t Words> struct slot {
+    std::atomic<std::uint64_t> sequence{0};
+    std::array<std::atomic<std::uint64_t>, Words> words;
+  };
+
+  std::size_t capacity_;
+  std::size_t window_;
+  std::vector<slot<sample_words>> slots_;
+  slot<summary_words> summary_;
+  std::atomic<std::uint64_t> pushed_;
+  // used by the writer only, one accumulator for step_seconds and one for
+  // every field of data
+  std::vector<math::welford> accumulators_;
+
+public:
+  // throws std::runtime_error if capacity is 0 or window is not in
+  // [1, capacity]
+  time_series(std::size_t capacity, std::size_t window);
+  time_series(time_series const &) = delete;
+  time_series &operator=(time_series const &) = delete;
+
+  // appends a sample, only one thread may push
+  void push(sample const &to_be_pushed);
+
+  // the samples still in the buffer, oldest first. The ones overwritten while
+  // they were being copied are left out, so the steps may start later than
+  // pushed() - capacity()
+  std::vector<sample> snapshot() const;
+  // mean and standard deviation over the window, 0 samples before the first
+  // push
+  window_summary window() const;
+
+  std::uint64_t pushed() const;
+  std::size_t capacity() const;
+  std::size_t window_size() const;
+};
+
+// Function to convert a window summary to a string for printing
+std::string print_window_to_string(window_summary const &to_be_printed);
+} // namespace view
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef TRAJECTORY_HPP
+#define TRAJECTORY_HPP
+
+#include "flock.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace io {
+// Version written by trajectory_writer
+constexpr std::uint32_t trajectory_version{1};
+
+// A trajectory file is a header followed by frames of the same size, so frame
+// k is found at a fixed offset without any index. The header holds the
+// parameters of the run, the number of boids and of complete frames, every
+// frame its step and time followed by r_x r_y v_x v_y of every boid. Numbers
+// are stored little endian in the layout of the machine, so that a mapped
+// file can be used as it is, only little endian machines are supported
+
+// Frame of a mapped trajectory, it points into the mapping and is valid as
+// long as the reader that returned it
+class frame_view {
+private:
+  std::uint64_t step_;
+  double time_;
+  std::size_t boids_;
+  double const *values_; // four doubles for every boid
+
+public:
+  frame_view(std::uint64_t step, double time, std::size_t boids,
+             double const *values);
+
+  std::uint64_t step() const;
+  double time() const;
+  std::size_t boids() const;
+  math::R2 r(std::size_t boid) const;
+  math::R2 v(std::size_t boid) const;
+  // the raw values, r_x r_y v_x v_y of boid i start at 4 * i
+  double const *values() const;
+  // copy of the frame as a flock
+  std::vector<dynamics::Boid> flock() const;
+};
+
+// Appends frames to a new trajectory file through a shared mapping, the file
+// grows by doubling so the mapping is replaced only a logarithmic number of
+// times. The header counts a frame only once it is completely written, so a
+// run killed while recording leaves a readable file
+class trajectory_writer {
+private:
+  int fd_;
+  std::size_t boids_;
+  std::size_t frame_bytes_;
+  std::uint64_t frames_;
+  std::uint64_t capacity_; // frames the mapping can hold
+  void *address_;
+  std::size_t mapped_bytes_;
+
+  void map(std::uint64_t capacity);
+
+public:
+  // creates (or truncates) the file, throws std::runtime_error on failure
+  trajectory_writer(std::string const &path, std::size_t boids,
+                    dynamics::running_parameters const &parameters);
+  trajectory_writer(trajectory_writer const &) = delete;
+  trajectory_writer &operator=(trajectory_writer const &) = delete;
+  // closes the file if close was not called
+  ~trajectory_writer();
+
+  // throws std::runtime_error if the flock doesn't have the size of the
+  // trajectory
+  void append(std::uint64_t step, double time,
+              std::vector<dynamics::Boid> const &flock);
+  std::uint64_t frames() const;
+  // trims the file to the written frames and closes it
+  void close();
+};
+
+// Maps a whole trajectory file read only, the frames are read in place
+class trajectory_reader {
+private:
+  void const *address_;
+  std::size_t mapped_bytes_;
+  std::size_t boids_;
+  std::size_t frame_bytes_;
+  std::uint64_t frames_;
+  dynamics::running_parameters parameters_;
+
+public:
+  // throws std::runtime_error if the file can't be mapped or isn't a
+  // trajectory
+  explicit trajectory_reader(std::string const &path);
+  trajectory_reader(trajectory_reader const &) = delete;
+  trajectory_reader &operator=(trajectory_reader const &) = delete;
+  ~trajectory_reader();
+
+  std::uint64_t frames() const;
+  std::size_t boids() const;
+  dynamics::running_parameters const &parameters() const;
+  // throws std::out_of_range if there is no such frame
+  frame_view frame(std::uint64_t index) const;
+  // index of the first frame whose step is not less than step (frames() if
+  // there is none), the steps of a trajectory grow so it is a binary search
+  std::uint64_t find_step(std::uint64_t step) const;
+  // same for the time, which grows with the steps
+  std::uint64_t find_time(double time) const;
+  // asks the kernel to read the frames in [first, last) from the disk and
+  // waits until they are in memory, so that reading them later never
+  // stalls. The range is clamped to the frames of the trajectory
+  void prefetch(std::uint64_t first, std::uint64_t last) const;
+};
+} // namespace io
+
+#endif
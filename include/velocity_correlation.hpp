@@ -0,0 +1,44 @@
+#ifndef VELOCITY_CORRELATION_HPP
+#define VELOCITY_CORRELATION_HPP
+
+#include "flock.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace view {
+// Connected velocity correlation function C(r) of a frame, the average of
+// du_i * du_j over the couples of boids at distance r, where du is the
+// fluctuation of the velocity around the mean velocity of the flock. It is
+// normalized by the mean of du_i * du_i, so C(0) = 1. Distances follow the
+// minimum image convention of the periodic domain of teleport_toroidally
+struct velocity_correlation {
+  double bin_width;
+  std::vector<double> values;         // C at the centers of the bins
+  std::vector<std::uint64_t> couples; // couples of boids in every bin
+  double correlation_length; // first zero of C, the end of the range if C
+                             // does not cross zero in it
+};
+
+// C(r) up to r_max with the couples found by a cell list, O(n k) for k
+// neighbors within r_max. r_max can be at most half the shortest side of the
+// space, throws std::runtime_error otherwise. The result does not depend on
+// the number of threads
+velocity_correlation
+calculate_velocity_correlation(std::vector<dynamics::Boid> const &flock,
+                               double r_max, std::size_t bins,
+                               dynamics::running_parameters const &parameters);
+
+// C(r) over the whole domain, up to half its diagonal. The fluctuations and
+// the boids are gathered on a grid of resolution x resolution cells (rounded
+// up to a power of two) whose autocorrelations are computed with FFTs, so the
+// cost is O(n + resolution^2 log resolution) whatever the number of couples.
+// Distances are those between the centers of the cells, so C is exact only
+// on scales larger than a cell
+velocity_correlation calculate_velocity_correlation_fft(
+    std::vector<dynamics::Boid> const &flock, std::size_t bins,
+    std::size_t resolution, dynamics::running_parameters const &parameters);
+} // namespace view
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef VTK_HPP
+#define VTK_HPP
+
+#include "flock.hpp"
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace io {
+// Values of every boid written along its position and velocity, the empty
+// ones are left out
+struct vtu_scalars {
+  std::vector<std::size_t> neighbors{}; // from view::count_neighbors
+  std::vector<std::size_t> clusters{};  // labels of view::find_clusters
+};
+
+// Writes a flock as a VTK unstructured grid (.vtu) of one vertex per boid,
+// with the velocities as point vectors and the scalars as point data. The
+// XML only describes the arrays, their values follow it in a single block of
+// raw appended data, each preceded by its size in bytes (u64) and in the byte
+// order of the machine, so ParaView reads them without parsing text. The
+// arrays are converted through a fixed buffer written whenever it is full,
+// so the memory used doesn't grow with the flock. Throws std::runtime_error
+// if the scalars don't have the size of the flock or the stream fails
+void write_vtu(std::ostream &output, std::vector<dynamics::Boid> const &flock,
+               vtu_scalars const &scalars = {});
+
+// A time series for ParaView: every frame is written to its own .vtu file
+// next to the .pvd index, named after it with the number of the frame, and
+// the index lists them with their times. The index is written by close
+class vtu_series {
+private:
+  std::string path_;
+  std::string stem_; // path of the index without its extension
+  std::vector<std::pair<double, std::string>> frames_; // times and files
+  bool closed_;
+
+public:
+  explicit vtu_series(std::string const &pvd_path);
+  vtu_series(vtu_series const &) = delete;
+  vtu_series &operator=(vtu_series const &) = delete;
+  // writes the index if close was not called, errors are lost
+  ~vtu_series();
+
+  // writes the file of the next frame, throws std::runtime_error on failure
+  void add(double time, std::vector<dynamics::Boid> const &flock,
+           vtu_scalars const &scalars = {});
+  std::size_t frames() const;
+  // writes the index, throws std::runtime_error on failure
+  void close();
+};
+} // namespace io
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef WELFORD_HPP
+#define WELFORD_HPP
+
+namespace math {
+// The class welford accumulates the mean and the variance of a sequence of
+// values in a single pass with Welford's algorithm, which never subtracts
+// large nearly equal sums. Two accumulators can be merged with Chan's formula,
+// so the partial results of different threads can be combined
+class welford {
+private:
+  double count_; // Number of values
+  double mean_;  // Mean of the values
+  double m2_;    // Sum of the squared deviations from the mean
+
+public:
+  // constructors, the empty accumulator, a single value and the raw state
+  welford();
+  explicit welford(double value);
+  welford(double count, double mean, double m2);
+
+  void add(double value);
+  // removal of a value added before, the inverse of add, it lets an
+  // accumulator follow a sliding window
+  void remove(double value);
+  // merge of the values of another accumulator
+  welford &operator+=(welford const &rhs);
+
+  double count() const;
+  double mean() const;
+  double m2() const;
+  // sample variance and standard deviation, 0 with less than two values
+  double variance() const;
+  double sigma() const;
+};
+
+// merge of two accumulators, it lets welford be summed like double and R2
+welford operator+(welford const &lhs, welford const &rhs);
+} // namespace math
+
+#endif
@@ -1,23 +1,142 @@
 #include "include/render.hpp"
+#include "include/snapshot.hpp"
 
+#include <cstdlib>
 #include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
 
-int main() {
-  // the users is asked to insert the parameters which are used to create the
-  // flock
-  dynamics::running_parameters parameters = view::create_parameters();
-  std::vector<dynamics::Boid> flock = dynamics::create_flock(parameters);
+// usage: boids [--resume snapshot] [--checkpoint snapshot [seconds]]
+//              [--record trajectory] [--record-compressed trajectory]
+//              [--record-region trajectory left,bottom,right,top|x1,y1,...]
+//              [--record-policy block|drop|decimate]
+//              [--io-backend automatic|io_uring|threaded]
+//        boids --replay trajectory
+int main(int argc, char *argv[]) {
+  // a recorded run is played without simulating it
+  if (argc == 3 && std::string{argv[1]} == "--replay") {
+    try {
+      view::run_replay(argv[2]);
+    } catch (const std::exception &error) {
+      std::cerr << error.what() << '\n';
+      return 1;
+    }
+    return 0;
+  }
+  std::string resume;
+  view::simulation_options options{};
+  bool valid{true};
+  for (int i{1}; i < argc && valid; ++i) {
+    std::string const argument{argv[i]};
+    if (argument == "--resume" && i + 1 < argc) {
+      resume = argv[++i];
+    } else if (argument == "--checkpoint" && i + 1 < argc) {
+      options.checkpoint = argv[++i];
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        options.checkpoint_interval = std::atof(argv[++i]);
+        valid = options.checkpoint_interval > 0.;
+      }
+    } else if (argument == "--record" && i + 1 < argc) {
+      options.trajectory = argv[++i];
+    } else if (argument == "--record-compressed" && i + 1 < argc) {
+      options.compressed_trajectory = argv[++i];
+    } else if (argument == "--record-region" && i + 2 < argc) {
+      options.region_trajectory = argv[++i];
+      try {
+        options.region = io::parse_region(argv[++i]);
+      } catch (const std::exception &error) {
+        std::cerr << error.what() << '\n';
+        valid = false;
+      }
+    } else if (argument == "--record-policy" && i + 1 < argc) {
+      std::string const policy{argv[++i]};
+      if (policy == "block") {
+        options.record_policy = io::backpressure::block;
+      } else if (policy == "drop") {
+        options.record_policy = io::backpressure::drop;
+      } else if (policy == "decimate") {
+        options.record_policy = io::backpressure::decimate;
+      } else {
+        valid = false;
+      }
+    } else if (argument == "--io-backend" && i + 1 < argc) {
+      std::string const backend{argv[++i]};
+      if (backend == "automatic") {
+        options.io_backend = io::io_backend::automatic;
+      } else if (backend == "io_uring") {
+        options.io_backend = io::io_backend::io_uring;
+      } else if (backend == "threaded") {
+        options.io_backend = io::io_backend::threaded;
+      } else {
+        valid = false;
+      }
+    } else {
+      valid = false;
+    }
+  }
+  if (!valid) {
+    std::cerr << "usage: " << argv[0]
+              << " [--resume snapshot] [--checkpoint snapshot [seconds]]"
+                 " [--record trajectory] [--record-compressed trajectory]"
+                 " [--record-region trajectory"
+                 " left,bottom,right,top|x1,y1,x2,y2,x3,y3,...]"
+                 " [--record-policy block|drop|decimate]"
+                 " [--io-backend automatic|io_uring|threaded]\n"
+              << "       " << argv[0] << " --replay trajectory\n";
+    return 1;
+  }
+
+  dynamics::running_parameters parameters{};
+  std::vector<dynamics::Boid> flock;
+  if (resume.empty()) {
+    // the users is asked to insert the parameters which are used to create
+    // the flock
+    parameters = view::create_parameters();
+    std::random_device rd;
+    options.engine.seed(rd());
+    flock = dynamics::create_flock(parameters, options.engine);
+  } else {
+    // a resumed run continues from the saved state, parameters included
+    try {
+      io::snapshot saved = io::load_snapshot(resume);
+      // the recorders and the statistics rely on the flock having the size
+      // of the parameters, and the statistics need at least three boids
+      if (saved.parameters.boids_number < 3) {
+        throw std::runtime_error("ERROR: " + resume +
+                                 " holds fewer than three boids");
+      }
+      if (saved.flock.size() !=
+          static_cast<std::size_t>(saved.parameters.boids_number)) {
+        throw std::runtime_error(
+            "ERROR: " + resume + " holds " +
+            std::to_string(saved.flock.size()) + " boids for a flock of " +
+            std::to_string(saved.parameters.boids_number));
+      }
+      parameters = saved.parameters;
+      flock = std::move(saved.flock);
+      options.engine = saved.engine;
+      options.first_step = saved.step;
+      options.start_time = saved.time;
+    } catch (const std::exception &error) {
+      std::cerr << error.what() << '\n';
+      return 1;
+    }
+    std::cout << "\nResuming " << resume << " at step " << options.first_step
+              << '\n';
+  }
   std::cout << "\nThe simulation will start now\n";
   std::cout << "\nBoids Number:" << parameters.boids_number
             << " s:" << parameters.c << " a:" << parameters.a
             << " c:" << parameters.c << " \n";
   // the simulation starts here the error is to cover the failure of the font
-  // loading
+  // loading and of the checkpoints
   try {
-    view::run_simulation(flock, parameters);
+    view::run_simulation(flock, parameters, options);
   } catch (const std::exception &error) {
     std::cerr << error.what() << '\n';
     std::cout << "Simulation Aborted"
               << "\n";
   }
-}
\ No newline at end of file
+}
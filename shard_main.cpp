@@ -0,0 +1,42 @@
+#include "include/shard.hpp"
+
+#include <cstdlib>
+#include <iostream>
+
+// usage: boids.shard [shards] [steps] [boids number]
+int main(int argc, char *argv[]) {
+  dynamics::running_parameters parameters{};
+  dynamics::shard_options options{};
+  options.steps = 600;
+  if (argc > 1) {
+    options.shards = std::atoi(argv[1]);
+  }
+  if (argc > 2) {
+    options.steps = std::atoi(argv[2]);
+  }
+  if (argc > 3) {
+    parameters.boids_number = std::atoi(argv[3]);
+  }
+  if (options.shards < 1 || options.steps < 0 || parameters.boids_number < 3) {
+    std::cerr << "usage: " << argv[0] << " [shards] [steps] [boids number]\n";
+    return 1;
+  }
+
+  std::vector<dynamics::Boid> flock = dynamics::create_flock(parameters);
+  std::cout << "\nBoids Number:" << parameters.boids_number
+            << " shards:" << options.shards << " steps:" << options.steps
+            << " \n";
+  std::cout << "Mean Velocity before: " << view::calculate_mean_velocity(flock)
+            << '\n';
+  // the error covers the failure of a shard process
+  try {
+    flock = dynamics::run_sharded(flock, parameters, options);
+  } catch (const std::exception &error) {
+    std::cerr << error.what() << '\n';
+    std::cout << "Simulation Aborted"
+              << "\n";
+    return 1;
+  }
+  std::cout << "Mean Velocity after:  " << view::calculate_mean_velocity(flock)
+            << '\n';
+}
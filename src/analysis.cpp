@@ -0,0 +1,129 @@
+#include "../include/analysis.hpp"
+#include "../include/clusters.hpp"
+#include "../include/parallel.hpp"
+#include "../include/velocity_correlation.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+#include <utility>
+
+namespace view {
+namespace {
+// names and printed values of the fields of an analysis, in the order of the
+// columns, integers are printed as they are and doubles like std::to_string
+std::vector<std::pair<std::string, std::string>>
+fields(frame_analysis const &analysis, analysis_options const &options) {
+  data const &statistics = analysis.statistics;
+  std::vector<std::pair<std::string, std::string>> printed{
+      {"step", std::to_string(analysis.step)},
+      {"time", std::to_string(analysis.time)},
+      {"mean_distance", std::to_string(statistics.mean_distance)},
+      {"sigma_mean_distance", std::to_string(statistics.sigma_mean_distance)},
+      {"confidence_mean_distance",
+       std::to_string(statistics.confidence_mean_distance)},
+      {"mean_velocity", std::to_string(statistics.mean_velocity)},
+      {"sigma_mean_velocity", std::to_string(statistics.sigma_mean_velocity)},
+      {"polarization", std::to_string(statistics.polarization)},
+      {"milling", std::to_string(statistics.milling)},
+      {"mean_nearest_distance",
+       std::to_string(statistics.mean_nearest_distance)},
+      {"sigma_nearest_distance",
+       std::to_string(statistics.sigma_nearest_distance)}};
+  if (options.clusters) {
+    printed.emplace_back("clusters", std::to_string(analysis.clusters));
+    printed.emplace_back("largest_cluster",
+                         std::to_string(analysis.largest_cluster));
+  }
+  if (options.correlation) {
+    printed.emplace_back("correlation_length",
+                         std::to_string(analysis.correlation_length));
+  }
+  return printed;
+}
+} // namespace
+
+frame_analysis analyze_frame(std::uint64_t step, double time,
+                             std::vector<dynamics::Boid> const &flock,
+                             dynamics::running_parameters const &parameters,
+                             analysis_options const &options) {
+  frame_analysis analysis{step, time, build_data(flock, options.statistics),
+                          0, 0, 0.};
+  if (options.clusters) {
+    cluster_data const clusters = find_clusters(flock, parameters);
+    analysis.clusters = clusters.count;
+    analysis.largest_cluster = clusters.largest;
+  }
+  if (options.correlation && !flock.empty()) {
+    analysis.correlation_length =
+        calculate_velocity_correlation_fft(flock, options.correlation_bins,
+                                           options.correlation_resolution,
+                                           parameters)
+            .correlation_length;
+  }
+  return analysis;
+}
+
+std::vector<frame_analysis>
+analyze_trajectory(io::trajectory_reader const &reader, std::uint64_t first,
+                   std::uint64_t last, analysis_options const &options) {
+  if (first > last || last > reader.frames()) {
+    throw std::out_of_range("ERROR: No such frames in the trajectory");
+  }
+  std::vector<frame_analysis> analyses(last - first);
+  parallel::parallel_for(analyses.size(), [&](std::size_t index) {
+    io::frame_view const frame = reader.frame(first + index);
+    analyses[index] = analyze_frame(frame.step(), frame.time(), frame.flock(),
+                                    reader.parameters(), options);
+  });
+  return analyses;
+}
+
+std::vector<frame_analysis>
+analyze_frames(std::vector<io::decoded_frame> const &frames,
+               dynamics::running_parameters const &parameters,
+               analysis_options const &options) {
+  std::vector<frame_analysis> analyses(frames.size());
+  parallel::parallel_for(frames.size(), [&](std::size_t index) {
+    analyses[index] = analyze_frame(frames[index].step, frames[index].time,
+                                    frames[index].flock, parameters, options);
+  });
+  return analyses;
+}
+
+std::string print_analysis_header_to_csv(analysis_options const &options) {
+  std::string to_be_returned{""};
+  for (auto const &field : fields(frame_analysis{}, options)) {
+    to_be_returned += to_be_returned.empty() ? "" : ",";
+    to_be_returned += field.first;
+  }
+  to_be_returned += '\n';
+  return to_be_returned;
+}
+
+std::string print_analysis_to_csv(frame_analysis const &analysis,
+                                  analysis_options const &options) {
+  std::string to_be_returned{""};
+  for (auto const &field : fields(analysis, options)) {
+    to_be_returned += to_be_returned.empty() ? "" : ",";
+    to_be_returned += field.second;
+  }
+  to_be_returned += '\n';
+  return to_be_returned;
+}
+
+std::string print_analysis_to_json(frame_analysis const &analysis,
+                                   analysis_options const &options) {
+  std::string to_be_returned{"{"};
+  for (auto const &field : fields(analysis, options)) {
+    to_be_returned += to_be_returned.size() == 1 ? "\"" : ",\"";
+    to_be_returned += field.first + "\":";
+    // json has no nan or infinity, std::to_string prints them as letters
+    bool const finite = std::isfinite(std::strtod(field.second.c_str(),
+                                                  nullptr));
+    to_be_returned += finite ? field.second : "null";
+  }
+  to_be_returned += "}\n";
+  return to_be_returned;
+}
+} // namespace view
@@ -0,0 +1,472 @@
+#include "../include/async_writer.hpp"
+#include "../include/parallel.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#if defined(__NR_io_uring_setup)
+#define BOIDS_IO_URING
+#endif
+#endif
+
+namespace io {
+namespace {
+constexpr std::size_t max_buffers{1024};
+constexpr std::size_t max_buffer_bytes{std::size_t{1} << 30};
+
+// writes the whole range with pwrite, returns 0 or the errno of the failure
+int write_all(int fd, char const *data, std::size_t size,
+              std::uint64_t offset) {
+  while (size != 0) {
+    ssize_t const written =
+        ::pwrite(fd, data, size, static_cast<off_t>(offset));
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return errno;
+    }
+    if (written == 0) {
+      return EIO;
+    }
+    data += written;
+    size -= static_cast<std::size_t>(written);
+    offset += static_cast<std::uint64_t>(written);
+  }
+  return 0;
+}
+
+// keeps the first error
+void record_error(std::atomic<int> &error, int value) {
+  int expected{0};
+  error.compare_exchange_strong(expected, value);
+}
+} // namespace
+
+#ifdef BOIDS_IO_URING
+// The three shared memory areas of an io_uring and the pointers to their
+// fields. The submission ring is only written by this writer and the
+// completion ring only read, the kernel is the other side of both
+struct async_file_writer::ring {
+  int fd{-1};
+  void *rings{MAP_FAILED};
+  std::size_t rings_bytes{};
+  void *completions{MAP_FAILED}; // same as rings if the kernel maps them once
+  std::size_t completions_bytes{};
+  io_uring_sqe *entries{static_cast<io_uring_sqe *>(MAP_FAILED)};
+  std::size_t entries_bytes{};
+  unsigned *submission_tail{};
+  unsigned submission_mask{};
+  unsigned *submission_array{};
+  unsigned *completion_head{};
+  unsigned *completion_tail{};
+  unsigned completion_mask{};
+  io_uring_cqe *completion_entries{};
+  unsigned to_submit{}; // entries not yet passed to the kernel
+  std::size_t in_flight{};
+
+  ~ring() {
+    if (entries != MAP_FAILED) {
+      ::munmap(entries, entries_bytes);
+    }
+    if (completions != MAP_FAILED && completions != rings) {
+      ::munmap(completions, completions_bytes);
+    }
+    if (rings != MAP_FAILED) {
+      ::munmap(rings, rings_bytes);
+    }
+    if (fd != -1) {
+      ::close(fd);
+    }
+  }
+
+  // submits the pending entries and waits for wait completions, throws if
+  // the kernel refuses
+  void enter(unsigned wait) {
+    while (true) {
+      long const submitted =
+          ::syscall(__NR_io_uring_enter, fd, to_submit, wait,
+                    wait != 0 ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0);
+      if (submitted >= 0) {
+        to_submit -= static_cast<unsigned>(submitted);
+        return;
+      }
+      if (errno != EINTR) {
+        throw std::runtime_error(std::string{"ERROR: io_uring_enter failed: "} +
+                                 std::strerror(errno));
+      }
+    }
+  }
+};
+
+bool async_file_writer::start_ring() {
+  auto started = std::make_unique<ring>();
+  io_uring_params parameters{};
+  started->fd = static_cast<int>(::syscall(
+      __NR_io_uring_setup, static_cast<unsigned>(buffers_.size()),
+      &parameters));
+  if (started->fd < 0) {
+    started->fd = -1;
+    return false;
+  }
+  started->rings_bytes = parameters.sq_off.array +
+                         parameters.sq_entries * sizeof(unsigned);
+  started->completions_bytes = parameters.cq_off.cqes +
+                               parameters.cq_entries * sizeof(io_uring_cqe);
+  bool const single = (parameters.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single) {
+    started->rings_bytes =
+        std::max(started->rings_bytes, started->completions_bytes);
+  }
+  started->rings = ::mmap(nullptr, started->rings_bytes,
+                          PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          started->fd, IORING_OFF_SQ_RING);
+  if (started->rings == MAP_FAILED) {
+    return false;
+  }
+  started->completions =
+      single ? started->rings
+             : ::mmap(nullptr, started->completions_bytes,
+                      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      started->fd, IORING_OFF_CQ_RING);
+  if (started->completions == MAP_FAILED) {
+    return false;
+  }
+  started->entries_bytes = parameters.sq_entries * sizeof(io_uring_sqe);
+  started->entries = static_cast<io_uring_sqe *>(
+      ::mmap(nullptr, started->entries_bytes, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, started->fd, IORING_OFF_SQES));
+  if (started->entries == MAP_FAILED) {
+    return false;
+  }
+  char *const rings = static_cast<char *>(started->rings);
+  char *const completions = static_cast<char *>(started->completions);
+  started->submission_tail =
+      reinterpret_cast<unsigned *>(rings + parameters.sq_off.tail);
+  started->submission_mask =
+      *reinterpret_cast<unsigned *>(rings + parameters.sq_off.ring_mask);
+  started->submission_array =
+      reinterpret_cast<unsigned *>(rings + parameters.sq_off.array);
+  started->completion_head =
+      reinterpret_cast<unsigned *>(completions + parameters.cq_off.head);
+  started->completion_tail =
+      reinterpret_cast<unsigned *>(completions + parameters.cq_off.tail);
+  started->completion_mask =
+      *reinterpret_cast<unsigned *>(completions + parameters.cq_off.ring_mask);
+  started->completion_entries =
+      reinterpret_cast<io_uring_cqe *>(completions + parameters.cq_off.cqes);
+
+  // the kernel pins the registered buffers once, instead of at every write
+  std::vector<iovec> vectors(buffers_.size());
+  for (std::size_t index{}; index != buffers_.size(); ++index) {
+    vectors[index].iov_base = buffers_[index].data;
+    vectors[index].iov_len = buffer_bytes_;
+  }
+  if (::syscall(__NR_io_uring_register, started->fd, IORING_REGISTER_BUFFERS,
+                vectors.data(), static_cast<unsigned>(vectors.size())) != 0) {
+    return false;
+  }
+  ring_ = std::move(started);
+  return true;
+}
+#else
+struct async_file_writer::ring {};
+
+bool async_file_writer::start_ring() { return false; }
+#endif
+
+async_file_writer::stream_buffer::stream_buffer(async_file_writer &writer)
+    : writer_{writer} {}
+
+async_file_writer::stream_buffer::int_type
+async_file_writer::stream_buffer::overflow(int_type character) {
+  if (!traits_type::eq_int_type(character, traits_type::eof())) {
+    char const value = traits_type::to_char_type(character);
+    writer_.write(&value, 1);
+  }
+  return traits_type::not_eof(character);
+}
+
+std::streamsize async_file_writer::stream_buffer::xsputn(char const *data,
+                                                        std::streamsize size) {
+  writer_.write(data, static_cast<std::size_t>(size));
+  return size;
+}
+
+async_file_writer::async_file_writer(std::string const &path,
+                                     io_backend backend, std::size_t buffers,
+                                     std::size_t buffer_bytes)
+    : path_{path}, fd_{-1}, backend_{backend}, buffer_bytes_{buffer_bytes},
+      storage_(buffers * buffer_bytes), buffers_(buffers), current_{buffers},
+      offset_{0}, error_{0}, batch_{std::max<std::size_t>(1, buffers / 4)},
+      full_{buffers}, free_{buffers}, stopping_{false}, stream_buffer_{*this},
+      stream_{&stream_buffer_} {
+  // io_uring indexes the registered buffers with 16 bits and their lengths
+  // with 32
+  if (buffers == 0 || buffers > max_buffers || buffer_bytes == 0 ||
+      buffer_bytes > max_buffer_bytes) {
+    throw std::runtime_error("ERROR: Invalid buffers of an async writer");
+  }
+  for (std::size_t index{}; index != buffers; ++index) {
+    buffers_[index] = {storage_.data() + index * buffer_bytes, 0, 0};
+    idle_.push_back(index);
+  }
+  fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd_ == -1) {
+    throw std::runtime_error("ERROR: Failed to create " + path);
+  }
+  if (backend != io_backend::threaded && start_ring()) {
+    backend_ = io_backend::io_uring;
+  } else if (backend == io_backend::io_uring) {
+    ::close(fd_);
+    throw std::runtime_error("ERROR: io_uring is not available");
+  } else {
+    backend_ = io_backend::threaded;
+    thread_ = std::thread{&async_file_writer::work, this};
+  }
+  // write throws, the stream reports its exceptions instead of a bad state
+  stream_.exceptions(std::ios::badbit);
+}
+
+async_file_writer::~async_file_writer() {
+  try {
+    close();
+  } catch (...) {
+    // a destructor can't report the failure
+  }
+}
+
+void async_file_writer::check() {
+  int const error = error_.load(std::memory_order_acquire);
+  if (error != 0) {
+    throw std::runtime_error("ERROR: Failed to write " + path_ + ": " +
+                             std::strerror(error));
+  }
+}
+
+void async_file_writer::write(char const *data, std::size_t size) {
+  if (fd_ == -1) {
+    throw std::runtime_error("ERROR: " + path_ + " is closed");
+  }
+  check();
+  while (size != 0) {
+    if (current_ == buffers_.size()) {
+      current_ = acquire();
+      buffers_[current_].size = 0;
+      buffers_[current_].offset = offset_;
+    }
+    buffer &filled = buffers_[current_];
+    std::size_t const copied = std::min(size, buffer_bytes_ - filled.size);
+    std::memcpy(filled.data + filled.size, data, copied);
+    filled.size += copied;
+    data += copied;
+    size -= copied;
+    offset_ += copied;
+    if (filled.size == buffer_bytes_) {
+      hand_over(current_);
+      current_ = buffers_.size();
+    }
+  }
+}
+
+std::ostream &async_file_writer::stream() { return stream_; }
+
+std::size_t async_file_writer::acquire() {
+  while (idle_.empty()) {
+    collect(true);
+  }
+  check();
+  std::size_t const index = idle_.back();
+  idle_.pop_back();
+  return index;
+}
+
+void async_file_writer::hand_over(std::size_t index) {
+#ifdef BOIDS_IO_URING
+  if (ring_) {
+    buffer const &written = buffers_[index];
+    unsigned const tail = *ring_->submission_tail;
+    unsigned const slot = tail & ring_->submission_mask;
+    io_uring_sqe &entry = ring_->entries[slot];
+    std::memset(&entry, 0, sizeof(entry));
+    entry.opcode = IORING_OP_WRITE_FIXED;
+    entry.fd = fd_;
+    entry.off = written.offset;
+    entry.addr = reinterpret_cast<std::uint64_t>(written.data);
+    entry.len = static_cast<std::uint32_t>(written.size);
+    entry.buf_index = static_cast<std::uint16_t>(index);
+    entry.user_data = index;
+    ring_->submission_array[slot] = slot;
+    // the kernel reads the entry once it sees the new tail
+    __atomic_store_n(ring_->submission_tail, tail + 1, __ATOMIC_RELEASE);
+    ++ring_->to_submit;
+    ++ring_->in_flight;
+    if (ring_->to_submit >= batch_) {
+      ring_->enter(0);
+    }
+    return;
+  }
+#endif
+  full_.try_push(index);
+}
+
+void async_file_writer::collect(bool wait) {
+#ifdef BOIDS_IO_URING
+  if (ring_) {
+    if (wait || ring_->to_submit != 0) {
+      ring_->enter(wait && ring_->in_flight != 0 ? 1 : 0);
+    }
+    unsigned head = *ring_->completion_head;
+    unsigned const tail =
+        __atomic_load_n(ring_->completion_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+      io_uring_cqe const &completion =
+          ring_->completion_entries[head & ring_->completion_mask];
+      std::size_t const index = static_cast<std::size_t>(completion.user_data);
+      buffer const &written = buffers_[index];
+      if (completion.res < 0) {
+        record_error(error_, -completion.res);
+      } else if (static_cast<std::size_t>(completion.res) < written.size) {
+        // a short write is finished synchronously, it is rare on files
+        std::size_t const done = static_cast<std::size_t>(completion.res);
+        int const error = write_all(fd_, written.data + done,
+                                    written.size - done, written.offset + done);
+        if (error != 0) {
+          record_error(error_, error);
+        }
+      }
+      idle_.push_back(index);
+      --ring_->in_flight;
+    }
+    __atomic_store_n(ring_->completion_head, head, __ATOMIC_RELEASE);
+    return;
+  }
+#endif
+  unsigned idle{};
+  std::size_t index;
+  while (true) {
+    bool collected{false};
+    while (free_.try_pop(index)) {
+      idle_.push_back(index);
+      collected = true;
+    }
+    if (collected || !wait) {
+      return;
+    }
+    parallel::back_off(idle);
+  }
+}
+
+void async_file_writer::submit() {
+  if (current_ != buffers_.size()) {
+    if (buffers_[current_].size != 0) {
+      hand_over(current_);
+    } else {
+      idle_.push_back(current_);
+    }
+    current_ = buffers_.size();
+  }
+  collect(false);
+}
+
+void async_file_writer::drain() {
+  while (idle_.size() != buffers_.size()) {
+    collect(true);
+  }
+}
+
+void async_file_writer::flush() {
+  if (fd_ == -1) {
+    throw std::runtime_error("ERROR: " + path_ + " is closed");
+  }
+  submit();
+  drain();
+  check();
+}
+
+void async_file_writer::reopen(std::string const &path) {
+  if (!ring_ && !thread_.joinable()) {
+    throw std::runtime_error("ERROR: " + path_ + " is closed");
+  }
+  if (fd_ != -1) {
+    // the buffers must be written before their file is closed, then the
+    // thread reads the new descriptor only with the next buffer it receives
+    submit();
+    drain();
+    ::close(fd_);
+    fd_ = -1;
+  }
+  path_ = path;
+  offset_ = 0;
+  error_.store(0, std::memory_order_release);
+  fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd_ == -1) {
+    throw std::runtime_error("ERROR: Failed to create " + path);
+  }
+}
+
+void async_file_writer::close() {
+  if (fd_ == -1) {
+    return;
+  }
+  try {
+    submit();
+    drain();
+  } catch (...) {
+    // the kernel refused the ring, the pages of the buffers stay pinned for
+    // the writes still in flight
+    record_error(error_, EIO);
+  }
+  if (thread_.joinable()) {
+    stopping_.store(true, std::memory_order_release);
+    thread_.join();
+  }
+  ring_.reset();
+  if (::close(fd_) != 0) {
+    record_error(error_, errno);
+  }
+  fd_ = -1;
+  check();
+}
+
+io_backend async_file_writer::backend() const { return backend_; }
+std::uint64_t async_file_writer::bytes() const { return offset_; }
+
+void async_file_writer::work() {
+  auto const write = [this](std::size_t index) {
+    buffer const &written = buffers_[index];
+    int const error =
+        write_all(fd_, written.data, written.size, written.offset);
+    if (error != 0) {
+      record_error(error_, error);
+    }
+    free_.try_push(index);
+  };
+
+  unsigned idle{};
+  std::size_t index;
+  while (true) {
+    if (full_.try_pop(index)) {
+      write(index);
+      idle = 0;
+    } else if (stopping_.load(std::memory_order_acquire)) {
+      if (!full_.try_pop(index)) {
+        return;
+      }
+      write(index);
+    } else {
+      parallel::back_off(idle);
+    }
+  }
+}
+} // namespace io
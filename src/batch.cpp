@@ -0,0 +1,149 @@
+#include "../include/batch.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace dynamics {
+flock_batch::flock_batch(std::vector<std::vector<Boid>> const &flocks,
+                         std::vector<running_parameters> const &parameters)
+    : lanes_{flocks.size()},
+      stride_{(flocks.size() + batch_width - 1) / batch_width * batch_width},
+      boids_{flocks.empty() ? 0 : flocks.front().size()},
+      parameters_{parameters} {
+  if (flocks.size() != parameters.size()) {
+    throw std::runtime_error("ERROR: Every flock of a batch needs parameters");
+  }
+  r_x_.resize(stride_ * boids_);
+  r_y_.resize(stride_ * boids_);
+  v_x_.resize(stride_ * boids_);
+  v_y_.resize(stride_ * boids_);
+  // a negative squared distance leaves the padding lanes without neighbors
+  d_squared_.resize(stride_, -1.);
+  d_s_squared_.resize(stride_, -1.);
+  for (std::size_t lane{}; lane != lanes_; ++lane) {
+    if (flocks[lane].size() != boids_) {
+      throw std::runtime_error("ERROR: The flocks of a batch must have the "
+                               "same number of boids");
+    }
+    for (std::size_t i{}; i != boids_; ++i) {
+      std::size_t const index = i * stride_ + lane;
+      r_x_[index] = flocks[lane][i].r().x;
+      r_y_[index] = flocks[lane][i].r().y;
+      v_x_[index] = flocks[lane][i].v().x;
+      v_y_[index] = flocks[lane][i].v().y;
+    }
+    d_squared_[lane] = parameters[lane].d * parameters[lane].d;
+    d_s_squared_[lane] = parameters[lane].d_s * parameters[lane].d_s;
+  }
+}
+
+std::size_t flock_batch::lanes() const { return lanes_; }
+std::size_t flock_batch::boids() const { return boids_; }
+
+std::vector<Boid> flock_batch::flock(std::size_t lane) const {
+  std::vector<Boid> flock;
+  flock.reserve(boids_);
+  for (std::size_t i{}; i != boids_; ++i) {
+    std::size_t const index = i * stride_ + lane;
+    flock.emplace_back(r_x_[index], r_y_[index], v_x_[index], v_y_[index]);
+  }
+  return flock;
+}
+
+void flock_batch::evolve(double const delta_t) {
+  std::size_t const stride = stride_;
+  // like evolve_flock every boid sees the state before the step
+  std::vector<double> new_r_x(r_x_.size());
+  std::vector<double> new_r_y(r_y_.size());
+  std::vector<double> new_v_x(v_x_.size());
+  std::vector<double> new_v_y(v_y_.size());
+
+  double const *r_x = r_x_.data();
+  double const *r_y = r_y_.data();
+  double const *v_x = v_x_.data();
+  double const *v_y = v_y_.data();
+
+  for (std::size_t first_lane{}; first_lane < lanes_;
+       first_lane += batch_width) {
+    double const *d_squared = d_squared_.data() + first_lane;
+    double const *d_s_squared = d_s_squared_.data() + first_lane;
+    for (std::size_t i{}; i != boids_; ++i) {
+      double const *fixed_x = r_x + i * stride + first_lane;
+      double const *fixed_y = r_y + i * stride + first_lane;
+      // sums over the neighborhood of the current boid, they are local
+      // arrays of fixed size so that the compiler can keep them in vector
+      // registers
+      double count[batch_width]{};
+      double separation_x[batch_width]{};
+      double separation_y[batch_width]{};
+      double velocity_x[batch_width]{};
+      double velocity_y[batch_width]{};
+      double mass_x[batch_width]{};
+      double mass_y[batch_width]{};
+
+      // the neighborhood is selected with masks instead of branches so that
+      // the loop over the lanes can be vectorized, squared distances avoid
+      // the square roots
+      for (std::size_t j{}; j != boids_; ++j) {
+        double const *current_x = r_x + j * stride + first_lane;
+        double const *current_y = r_y + j * stride + first_lane;
+        double const *current_v_x = v_x + j * stride + first_lane;
+        double const *current_v_y = v_y + j * stride + first_lane;
+        for (std::size_t lane{}; lane != batch_width; ++lane) {
+          double const dx = current_x[lane] - fixed_x[lane];
+          double const dy = current_y[lane] - fixed_y[lane];
+          double const distance_squared = dx * dx + dy * dy;
+          double const neighbor =
+              static_cast<double>(distance_squared < d_squared[lane]);
+          double const separated =
+              neighbor *
+              static_cast<double>(distance_squared < d_s_squared[lane]);
+          count[lane] += neighbor;
+          velocity_x[lane] += neighbor * current_v_x[lane];
+          velocity_y[lane] += neighbor * current_v_y[lane];
+          mass_x[lane] += neighbor * current_x[lane];
+          mass_y[lane] += neighbor * current_y[lane];
+          separation_x[lane] += separated * dx;
+          separation_y[lane] += separated * dy;
+        }
+      }
+
+      // the rest of evolve_boid is done lane by lane, skipping the padding
+      std::size_t const last_lane = std::min(batch_width, lanes_ - first_lane);
+      for (std::size_t lane{}; lane != last_lane; ++lane) {
+        std::size_t const index = i * stride + first_lane + lane;
+        running_parameters const &parameters = parameters_[first_lane + lane];
+        math::R2 const r{r_x[index], r_y[index]};
+        math::R2 const v{v_x[index], v_y[index]};
+        math::R2 new_r = r + v * delta_t;
+        math::R2 new_v = v;
+        double const n = count[lane];
+        if (n > 1.) {
+          math::R2 const separation =
+              -math::R2{separation_x[lane], separation_y[lane]} *
+              parameters.s;
+          math::R2 const mean_velocity =
+              (math::R2{velocity_x[lane], velocity_y[lane]} - v) *
+              (1. / (n - 1.));
+          math::R2 const alignment = parameters.a * (mean_velocity - v);
+          math::R2 const mass_center =
+              (math::R2{mass_x[lane], mass_y[lane]} - r) * (1. / (n - 1.));
+          math::R2 const cohesion = parameters.c * (mass_center - r);
+          new_v += separation + alignment + cohesion;
+        }
+        teleport_toroidally(new_r, parameters);
+        limit_speed(new_v, parameters);
+        new_r_x[index] = new_r.x;
+        new_r_y[index] = new_r.y;
+        new_v_x[index] = new_v.x;
+        new_v_y[index] = new_v.y;
+      }
+    }
+  }
+
+  r_x_.swap(new_r_x);
+  r_y_.swap(new_r_y);
+  v_x_.swap(new_v_x);
+  v_y_.swap(new_v_y);
+}
+} // namespace dynamics
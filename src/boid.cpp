@@ -1,4 +1,6 @@
 #include "../include/boid.hpp"
+#include "../include/parallel.hpp"
+#include "../include/welford.hpp"
 
 #include <algorithm>
 #include <cassert>
@@ -29,12 +31,10 @@ math::R2 calculate_CDM(std::vector<Boid> const &flock, Boid const &fixed_boid) {
   // boid(the first case should not be possible) the position of the fixed boid
   // is returned
   assert(n > 1); // should never fail
-  math::R2 mass_sum =
-      std::accumulate(flock.begin(), flock.end(), math::R2{},
-                      [](math::R2 &cumulative_mass, Boid const &current_boid) {
-                        cumulative_mass += current_boid.r();
-                        return cumulative_mass;
-                      });
+  // this runs for every boid of a step, so the sum is pairwise but serial,
+  // its order is fixed and starting threads here would cost more than it
+  math::R2 mass_sum = parallel::pairwise_sum<math::R2>(
+      0, flock.size(), [&](std::size_t i) { return flock[i].r(); });
   return (mass_sum - fixed_boid.r()) * (1. / (n - 1.));
 }
 
@@ -50,6 +50,93 @@ std::vector<Boid> get_neighborhood(std::vector<Boid> const &flock,
 }
 } // namespace dynamics
 namespace view {
+namespace {
+// Boids in a side of a tile, two tiles of coordinates fit in the L1 cache
+constexpr std::size_t tile_size{512};
+// Distances computed together by the innermost loop, one for every SIMD lane
+constexpr std::size_t kernel_width{4};
+
+// Accumulates the distances between the points [first_i, last_i) and
+// [first_j, last_j), if the ranges are the same tile only the couples with
+// i < j are taken
+math::welford accumulate_tile(std::vector<double> const &x,
+                              std::vector<double> const &y,
+                              std::size_t first_i, std::size_t last_i,
+                              std::size_t first_j, std::size_t last_j) {
+  bool const diagonal = first_i == first_j;
+  // one Welford accumulator for every lane, every lane receives a value at
+  // each step so they share the count and the loop can be vectorized
+  double count{0.};
+  double mean[kernel_width]{};
+  double m2[kernel_width]{};
+  math::welford tail;
+  for (std::size_t i{first_i}; i != last_i; ++i) {
+    double const fixed_x = x[i];
+    double const fixed_y = y[i];
+    std::size_t j = diagonal ? i + 1 : first_j;
+    for (; j + kernel_width <= last_j; j += kernel_width) {
+      count += 1.;
+      double const weight = 1. / count;
+      for (std::size_t lane{}; lane != kernel_width; ++lane) {
+        double const dx = x[j + lane] - fixed_x;
+        double const dy = y[j + lane] - fixed_y;
+        double const distance = std::sqrt(dx * dx + dy * dy);
+        double const delta = distance - mean[lane];
+        mean[lane] += delta * weight;
+        m2[lane] += delta * (distance - mean[lane]);
+      }
+    }
+    for (; j < last_j; ++j) {
+      tail.add(std::sqrt((x[j] - fixed_x) * (x[j] - fixed_x) +
+                         (y[j] - fixed_y) * (y[j] - fixed_y)));
+    }
+  }
+  for (std::size_t lane{}; lane != kernel_width; ++lane) {
+    tail += math::welford{count, mean[lane], m2[lane]};
+  }
+  return tail;
+}
+} // namespace
+
+math::welford
+calculate_distance_statistics(std::vector<dynamics::Boid> const &flock) {
+  std::size_t const n = flock.size();
+  // the coordinates are copied in two contiguous arrays for the kernel
+  std::vector<double> x(n);
+  std::vector<double> y(n);
+  for (std::size_t i{}; i != n; ++i) {
+    x[i] = flock[i].r().x;
+    y[i] = flock[i].r().y;
+  }
+
+  // the couples of tiles (I, J) with I <= J are numbered row by row
+  std::size_t const tiles = (n + tile_size - 1) / tile_size;
+  std::vector<std::size_t> row_start(tiles + 1);
+  for (std::size_t row{}; row != tiles; ++row) {
+    row_start[row + 1] = row_start[row] + tiles - row;
+  }
+  std::vector<math::welford> partial_statistics(row_start[tiles]);
+  parallel::parallel_for(partial_statistics.size(), [&](std::size_t tile_pair) {
+    std::size_t const row = static_cast<std::size_t>(
+        std::upper_bound(row_start.begin(), row_start.end(), tile_pair) -
+        row_start.begin() - 1);
+    std::size_t const column = row + tile_pair - row_start[row];
+    partial_statistics[tile_pair] = accumulate_tile(
+        x, y, row * tile_size, std::min(n, (row + 1) * tile_size),
+        column * tile_size, std::min(n, (column + 1) * tile_size));
+  });
+
+  // the partial results are merged in a fixed order
+  return parallel::pairwise_sum<math::welford>(
+      0, partial_statistics.size(),
+      [&](std::size_t i) { return partial_statistics[i]; });
+}
+
+distance_sums calculate_distance_sums(std::vector<dynamics::Boid> const &flock) {
+  math::welford const statistics = calculate_distance_statistics(flock);
+  double const sum = statistics.count() * statistics.mean();
+  return {sum, statistics.m2() + sum * statistics.mean()};
+}
 
 // Calculate mean distance of a flock of boids
 double calculate_mean_distance(std::vector<dynamics::Boid> const &flock) {
@@ -57,31 +144,8 @@ double calculate_mean_distance(std::vector<dynamics::Boid> const &flock) {
   // calculations of a srandard deviation
   double const n = flock.size();
   assert(n > 2); // should never fail
-  double total_sum{0};
-  int next_boid_index = 0;
-
-  // Iterate through each boid as a potential fixed_boid
-  std::for_each(
-      flock.begin(), flock.end(), [&](dynamics::Boid const &fixed_boid) {
-        auto next = std::next((flock.begin() + next_boid_index));
-
-        // Calculate the sum of distances from the fixed_boid to all other boids
-        double partial_sum = std::accumulate(
-            next, flock.end(), 0.,
-            [&](double sum_partial, dynamics::Boid const &current_boid) {
-              sum_partial += calculate_distance(fixed_boid, current_boid);
-              return sum_partial;
-            });
-
-        // Move to the next fixed_boid
-        ++next_boid_index;
-
-        // Accumulate the total sum of distances for later mean calculation
-        total_sum += partial_sum;
-
-        // Reset partial_sum for the next fixed_boid
-        partial_sum = 0.;
-      });
+  // Sum of the distances of every couple of boids
+  double total_sum = calculate_distance_sums(flock).sum;
 
   // Number of distances equals the combinations of n boid, taken at groups of
   // two
@@ -89,46 +153,14 @@ double calculate_mean_distance(std::vector<dynamics::Boid> const &flock) {
   return mean_distance;
 }
 
-// Calculate standard deviation of distances of a flock of boids; mean distance
-// is passed for efficiency
+// Calculate standard deviation of distances of a flock of boids, the sample
+// variance comes from the single sweep of calculate_distance_statistics, so
+// the mean distance is no longer needed
 double
 calculate_standard_deviation_distance(std::vector<dynamics::Boid> const &flock,
-                                      double mean_distance) {
-  double const n = flock.size();
-  assert(n > 1);
-
-  int next_boid_index = 0;
-  double total_sum{0.};
-  double sum_squared_distances{0.};
-
-  // Iterate through each boid as a potential fixed_boid
-  std::for_each(
-      flock.begin(), flock.end(), [&](dynamics::Boid const &fixed_boid) {
-        auto next = std::next((flock.begin() + next_boid_index));
-
-        // Calculate the sum of squared distances from the fixed_boid to all
-        // other boids
-        sum_squared_distances = std::accumulate(
-            next, flock.end(), 0.,
-            [&](double squared_distance, dynamics::Boid const &current_boid) {
-              double distance = calculate_distance(fixed_boid, current_boid);
-              squared_distance += distance * distance;
-              return squared_distance;
-            });
-        // Move to the next fixed_boid
-        ++next_boid_index;
-
-        // Accumulate the total sum of squared distances for later standard
-        // deviation calculation
-        total_sum += sum_squared_distances;
-        // Reset sum_squared_distances for the next fixed_boid
-        sum_squared_distances = 0.;
-      });
-
-  // Calculate standard deviation using the formula
-  double sigma = sqrt((total_sum / ((n * (n - 1.) / 2.) - 1.)) -
-                      n * mean_distance * mean_distance / (n - 1));
-  return sigma;
+                                      double /*mean_distance*/) {
+  assert(flock.size() > 1);
+  return calculate_distance_statistics(flock).sigma();
 }
 
 // Calculate mean of magnitudes of velocity vectors of a flock of boids
@@ -137,40 +169,27 @@ double calculate_mean_velocity(std::vector<dynamics::Boid> const &flock) {
   assert(n > 1); // should never fail
 
   // Calculate the sum of velocity magnitudes for all boids
-  double velocity_sum = std::accumulate(
-      flock.begin(), flock.end(), 0.,
-      [](double velocity_sum, dynamics::Boid const &current_boid) {
-        velocity_sum += math::calculate_norm(current_boid.v());
-        return velocity_sum;
-      });
+  double velocity_sum = parallel::deterministic_sum<double>(
+      flock.size(),
+      [&](std::size_t i) { return math::calculate_norm(flock[i].v()); });
 
   // Calculate the mean velocity magnitude
   double mean_velocity = velocity_sum * (1. / n);
   return mean_velocity;
 }
 
-// Calculate standard deviation of velocities of a flock of boids; mean velocity
-// is passed for efficiency
+// Calculate standard deviation of velocities of a flock of boids, the speeds
+// are accumulated with Welford's algorithm like in build_data, so the mean
+// velocity is no longer needed
 double
 calculate_standard_deviation_velocity(std::vector<dynamics::Boid> const &flock,
-                                      double mean_velocity) {
-  double const n = flock.size();
-  assert(n > 2);
-
-  double sum_squared_velocities{};
-
-  // Calculate the sum of squared velocity magnitudes for all boids
-  sum_squared_velocities = std::accumulate(
-      flock.begin(), flock.end(), 0.,
-      [&](double velocity_sum, dynamics::Boid const &current_boid) {
-        double vel_magnitude = math::calculate_norm(current_boid.v());
-        velocity_sum += vel_magnitude * vel_magnitude;
-        return velocity_sum;
-      });
-
-  // Calculate standard deviation using the formula
-  double sigma = sqrt((sum_squared_velocities / (n - 1.)) -
-                      n * mean_velocity * mean_velocity / (n - 1));
-  return sigma;
+                                      double /*mean_velocity*/) {
+  assert(flock.size() > 2);
+  return parallel::deterministic_sum<math::welford>(
+             flock.size(),
+             [&](std::size_t i) {
+               return math::welford{math::calculate_norm(flock[i].v())};
+             })
+      .sigma();
 }
 } // namespace view
\ No newline at end of file
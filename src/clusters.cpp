@@ -0,0 +1,103 @@
+#include "../include/clusters.hpp"
+#include "../include/spatial.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+namespace view {
+namespace {
+// Union-find whose unions can run concurrently. A root is always linked below
+// a smaller root with a compare and swap, so every parent is smaller than its
+// child, the root of a set is its smallest element whatever the order of the
+// unions, and the path halving of find only ever moves a parent towards the
+// root, which keeps it correct under concurrent writes
+class concurrent_union_find {
+private:
+  std::vector<std::atomic<std::size_t>> parent_;
+
+public:
+  explicit concurrent_union_find(std::size_t size) : parent_(size) {
+    for (std::size_t i{}; i != size; ++i) {
+      parent_[i].store(i, std::memory_order_relaxed);
+    }
+  }
+
+  std::size_t find(std::size_t i) {
+    while (true) {
+      std::size_t parent = parent_[i].load(std::memory_order_acquire);
+      if (parent == i) {
+        return i;
+      }
+      std::size_t const grandparent =
+          parent_[parent].load(std::memory_order_acquire);
+      if (grandparent != parent) {
+        // failing just means someone else moved it closer already
+        parent_[i].compare_exchange_weak(parent, grandparent,
+                                         std::memory_order_acq_rel);
+      }
+      i = grandparent;
+    }
+  }
+
+  void unite(std::size_t a, std::size_t b) {
+    while (true) {
+      a = find(a);
+      b = find(b);
+      if (a == b) {
+        return;
+      }
+      if (a < b) {
+        std::swap(a, b);
+      }
+      // a may have been linked by another thread since find, then retry
+      std::size_t expected = a;
+      if (parent_[a].compare_exchange_strong(expected, b,
+                                             std::memory_order_acq_rel)) {
+        return;
+      }
+    }
+  }
+};
+} // namespace
+
+cluster_data find_clusters(std::vector<dynamics::Boid> const &flock,
+                           dynamics::running_parameters const &parameters) {
+  concurrent_union_find sets{flock.size()};
+  dynamics::cell_list const cells{flock, parameters.d, parameters};
+  cells.for_each_pair(parameters.d,
+                      [&](std::size_t i, std::size_t j, math::R2 const &) {
+                        sets.unite(i, j);
+                      });
+
+  // the root of a cluster is its first boid, so it is labeled before the
+  // other boids of the cluster
+  cluster_data clusters{0, 0, std::vector<std::size_t>(flock.size()), {}};
+  for (std::size_t i{}; i != flock.size(); ++i) {
+    std::size_t const root = sets.find(i);
+    if (root == i) {
+      clusters.labels[i] = clusters.count++;
+      clusters.sizes.push_back(0);
+    } else {
+      clusters.labels[i] = clusters.labels[root];
+    }
+    std::size_t const size = ++clusters.sizes[clusters.labels[i]];
+    clusters.largest = std::max(clusters.largest, size);
+  }
+  return clusters;
+}
+
+std::vector<std::size_t>
+count_neighbors(std::vector<dynamics::Boid> const &flock,
+                dynamics::running_parameters const &parameters) {
+  dynamics::cell_list const cells{flock, parameters.d, parameters};
+  std::vector<std::size_t> counts(flock.size());
+  parallel::parallel_for(flock.size(), [&](std::size_t i) {
+    cells.for_each_neighbor(flock[i].r(), parameters.d,
+                            [&](std::size_t j, math::R2 const &) {
+                              counts[i] += j != i;
+                            });
+  });
+  return counts;
+}
+} // namespace view
@@ -0,0 +1,402 @@
+#include "../include/codec.hpp"
+#include "../include/parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+
+namespace io {
+namespace {
+static_assert(std::numeric_limits<double>::is_iec559,
+              "compressed trajectories store IEEE 754 doubles");
+
+constexpr char magic[8] = {'B', 'O', 'I', 'D', 'C', 'O', 'D', 'E'};
+constexpr std::size_t header_bytes{144};
+// step, time and keyframe flag at the beginning of a frame
+constexpr std::size_t frame_header_bytes{17};
+constexpr std::size_t block_size{128};
+constexpr std::size_t components{4};
+// quantized values are smaller than this, so the predictions and the
+// differences never overflow and a difference takes at most max_width bits
+constexpr double max_magnitude{1125899906842624.}; // 2^50
+constexpr unsigned max_width{53};
+// a corrupted header must not make the decoder allocate the whole memory
+constexpr std::uint64_t max_boids{std::uint64_t{1} << 32};
+
+void put_u64(char *&bytes, std::uint64_t value, int size = 8) {
+  for (int i{}; i != size; ++i) {
+    *bytes++ = static_cast<char>((value >> (8 * i)) & 0xff);
+  }
+}
+
+void put_f64(char *&bytes, double value) {
+  std::uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  put_u64(bytes, bits);
+}
+
+std::uint64_t get_u64(char const *&bytes, int size = 8) {
+  std::uint64_t value{};
+  for (int i{}; i != size; ++i) {
+    value |= static_cast<std::uint64_t>(static_cast<unsigned char>(*bytes++))
+             << (8 * i);
+  }
+  return value;
+}
+
+double get_f64(char const *&bytes) {
+  std::uint64_t const bits = get_u64(bytes);
+  double value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// small differences of both signs become small unsigned numbers
+std::uint64_t zigzag(std::int64_t value) {
+  return (static_cast<std::uint64_t>(value) << 1) ^
+         static_cast<std::uint64_t>(value >> 63);
+}
+
+std::int64_t unzigzag(std::uint64_t value) {
+  return static_cast<std::int64_t>(value >> 1) ^
+         -static_cast<std::int64_t>(value & 1);
+}
+
+unsigned bit_width(std::uint64_t value) {
+  unsigned width{};
+  for (; value != 0; value >>= 1) {
+    ++width;
+  }
+  return width;
+}
+
+std::size_t packed_bytes(unsigned width, std::size_t count) {
+  return (width * count + 7) / 8;
+}
+
+// packs the lowest width bits of every value one after the other
+void pack(std::uint64_t const *values, std::size_t count, unsigned width,
+          char *bytes) {
+  std::uint64_t buffer{};
+  unsigned filled{};
+  for (std::size_t k{}; k != count; ++k) {
+    buffer |= values[k] << filled;
+    filled += width;
+    for (; filled >= 8; filled -= 8) {
+      *bytes++ = static_cast<char>(buffer & 0xff);
+      buffer >>= 8;
+    }
+  }
+  if (filled != 0) {
+    *bytes = static_cast<char>(buffer & 0xff);
+  }
+}
+
+void unpack(char const *bytes, std::size_t count, unsigned width,
+            std::uint64_t *values) {
+  std::uint64_t const mask = (std::uint64_t{1} << width) - 1;
+  std::uint64_t buffer{};
+  unsigned filled{};
+  for (std::size_t k{}; k != count; ++k) {
+    for (; filled < width; filled += 8) {
+      buffer |= static_cast<std::uint64_t>(static_cast<unsigned char>(*bytes++))
+                << filled;
+    }
+    values[k] = buffer & mask;
+    buffer >>= width;
+    filled -= width;
+  }
+}
+
+// prediction of a quantized value from the previous frames, since is the
+// number of frames since the last keyframe
+std::int64_t predict(std::uint64_t since, std::int64_t previous,
+                     std::int64_t before_previous) {
+  if (since == 0) {
+    return 0;
+  }
+  return since == 1 ? previous : 2 * previous - before_previous;
+}
+
+std::size_t blocks_per_component(std::size_t boids) {
+  return (boids + block_size - 1) / block_size;
+}
+
+bool valid_settings(codec_settings const &settings) {
+  return settings.position_step > 0. && std::isfinite(settings.position_step) &&
+         settings.velocity_step > 0. && std::isfinite(settings.velocity_step) &&
+         settings.keyframe_interval > 0;
+}
+
+// the bottom left corner and the steps of the four components
+struct quantizer {
+  double origin[components];
+  double step[components];
+
+  quantizer(double left, double bottom, codec_settings const &settings)
+      : origin{left, bottom, 0., 0.},
+        step{settings.position_step, settings.position_step,
+             settings.velocity_step, settings.velocity_step} {}
+};
+} // namespace
+
+trajectory_encoder::trajectory_encoder(
+    std::ostream &output, std::size_t boids,
+    dynamics::running_parameters const &parameters,
+    codec_settings const &settings)
+    : output_{output}, boids_{boids}, settings_{settings},
+      left_{parameters.left_bound}, bottom_{parameters.bottom_bound},
+      frames_{0}, bytes_{0}, current_(components * boids),
+      previous_(components * boids), before_previous_(components * boids),
+      residuals_(components * boids),
+      widths_(components * blocks_per_component(boids)),
+      offsets_(components * blocks_per_component(boids)) {
+  if (!valid_settings(settings)) {
+    throw std::runtime_error("ERROR: Invalid codec settings");
+  }
+  char header[header_bytes];
+  char *bytes = header;
+  std::memcpy(bytes, magic, sizeof(magic));
+  bytes += sizeof(magic);
+  put_u64(bytes, codec_version, 4);
+  put_u64(bytes, 0, 4);
+  put_u64(bytes, boids);
+  put_f64(bytes, settings.position_step);
+  put_f64(bytes, settings.velocity_step);
+  put_u64(bytes, settings.keyframe_interval);
+  put_u64(bytes, static_cast<std::uint64_t>(
+                     static_cast<std::int64_t>(parameters.boids_number)));
+  for (double value :
+       {parameters.s, parameters.a, parameters.c, parameters.d_s, parameters.d,
+        parameters.left_bound, parameters.right_bound, parameters.upper_bound,
+        parameters.bottom_bound, parameters.maximum_velocity,
+        parameters.minimum_velocity}) {
+    put_f64(bytes, value);
+  }
+  output_.write(header, sizeof(header));
+  if (!output_) {
+    throw std::runtime_error("ERROR: Failed to write compressed trajectory");
+  }
+  bytes_ = sizeof(header);
+}
+
+void trajectory_encoder::append(std::uint64_t step, double time,
+                                std::vector<dynamics::Boid> const &flock) {
+  if (flock.size() != boids_) {
+    throw std::runtime_error("ERROR: Every frame of a trajectory must have " +
+                             std::to_string(boids_) + " boids");
+  }
+  std::uint64_t const since = frames_ % settings_.keyframe_interval;
+  std::size_t const blocks = blocks_per_component(boids_);
+  quantizer const scale{left_, bottom_, settings_};
+
+  // quantization and differences, every block finds its width
+  parallel::parallel_for(components * blocks, [&](std::size_t task) {
+    std::size_t const component = task / blocks;
+    std::size_t const first = (task % blocks) * block_size;
+    std::size_t const last = std::min(boids_, first + block_size);
+    std::uint64_t largest{};
+    for (std::size_t i{first}; i != last; ++i) {
+      math::R2 const value = component < 2 ? flock[i].r() : flock[i].v();
+      double const scaled =
+          ((component % 2 == 0 ? value.x : value.y) - scale.origin[component]) /
+          scale.step[component];
+      if (!(std::abs(scaled) < max_magnitude)) {
+        throw std::runtime_error(
+            "ERROR: Value out of the range of the trajectory codec");
+      }
+      std::size_t const k = component * boids_ + i;
+      current_[k] = std::llround(scaled);
+      residuals_[k] = zigzag(current_[k] -
+                             predict(since, previous_[k], before_previous_[k]));
+      largest = std::max(largest, residuals_[k]);
+    }
+    widths_[task] = static_cast<std::uint8_t>(bit_width(largest));
+  });
+
+  std::size_t size{frame_header_bytes};
+  for (std::size_t task{}; task != widths_.size(); ++task) {
+    offsets_[task] = sizeof(std::uint64_t) + size;
+    std::size_t const first = (task % blocks) * block_size;
+    size += 1 + packed_bytes(widths_[task],
+                             std::min(boids_, first + block_size) - first);
+  }
+  frame_.resize(sizeof(std::uint64_t) + size);
+  char *bytes = frame_.data();
+  put_u64(bytes, size);
+  put_u64(bytes, step);
+  put_f64(bytes, time);
+  *bytes = since == 0 ? 1 : 0;
+
+  parallel::parallel_for(widths_.size(), [&](std::size_t task) {
+    std::size_t const component = task / blocks;
+    std::size_t const first = (task % blocks) * block_size;
+    std::size_t const last = std::min(boids_, first + block_size);
+    char *const block = frame_.data() + offsets_[task];
+    *block = static_cast<char>(widths_[task]);
+    pack(residuals_.data() + component * boids_ + first, last - first,
+         widths_[task], block + 1);
+  });
+
+  output_.write(frame_.data(), static_cast<std::streamsize>(frame_.size()));
+  if (!output_) {
+    throw std::runtime_error("ERROR: Failed to write compressed trajectory");
+  }
+  bytes_ += frame_.size();
+  ++frames_;
+  before_previous_.swap(previous_);
+  previous_.swap(current_);
+}
+
+std::uint64_t trajectory_encoder::frames() const { return frames_; }
+std::uint64_t trajectory_encoder::bytes() const { return bytes_; }
+
+trajectory_decoder::trajectory_decoder(std::istream &input)
+    : input_{input}, boids_{0}, settings_{}, parameters_{}, frames_{0},
+      since_keyframe_{0} {
+  char header[header_bytes];
+  input_.read(header, sizeof(header));
+  if (static_cast<std::size_t>(input_.gcount()) != sizeof(header) ||
+      !std::equal(magic, magic + sizeof(magic), header)) {
+    throw std::runtime_error("ERROR: Not a compressed boids trajectory");
+  }
+  char const *bytes = header + sizeof(magic);
+  std::uint64_t const version = get_u64(bytes, 4);
+  if (version == 0 || version > codec_version) {
+    throw std::runtime_error(
+        "ERROR: Unsupported compressed trajectory version " +
+        std::to_string(version));
+  }
+  get_u64(bytes, 4);
+  std::uint64_t const boids = get_u64(bytes);
+  settings_.position_step = get_f64(bytes);
+  settings_.velocity_step = get_f64(bytes);
+  std::uint64_t const keyframe_interval = get_u64(bytes);
+  settings_.keyframe_interval = static_cast<std::uint32_t>(keyframe_interval);
+  parameters_.boids_number =
+      static_cast<int>(static_cast<std::int64_t>(get_u64(bytes)));
+  for (double *value :
+       {&parameters_.s, &parameters_.a, &parameters_.c, &parameters_.d_s,
+        &parameters_.d, &parameters_.left_bound, &parameters_.right_bound,
+        &parameters_.upper_bound, &parameters_.bottom_bound,
+        &parameters_.maximum_velocity, &parameters_.minimum_velocity}) {
+    *value = get_f64(bytes);
+  }
+  if (boids > max_boids || !valid_settings(settings_) ||
+      keyframe_interval > std::numeric_limits<std::uint32_t>::max()) {
+    throw std::runtime_error("ERROR: Corrupted compressed trajectory");
+  }
+  boids_ = boids;
+  current_.resize(components * boids_);
+  previous_.resize(components * boids_);
+  before_previous_.resize(components * boids_);
+  offsets_.resize(components * blocks_per_component(boids_));
+}
+
+bool trajectory_decoder::next(decoded_frame &frame) {
+  char size_bytes[sizeof(std::uint64_t)];
+  input_.read(size_bytes, sizeof(size_bytes));
+  if (input_.gcount() == 0 && input_.eof()) {
+    return false;
+  }
+  if (static_cast<std::size_t>(input_.gcount()) != sizeof(size_bytes)) {
+    throw std::runtime_error("ERROR: Truncated compressed trajectory");
+  }
+  char const *bytes = size_bytes;
+  std::uint64_t const size = get_u64(bytes);
+  std::size_t const blocks = blocks_per_component(boids_);
+  std::uint64_t const largest =
+      frame_header_bytes +
+      offsets_.size() * (1 + packed_bytes(max_width, block_size));
+  if (size < frame_header_bytes + offsets_.size() || size > largest) {
+    throw std::runtime_error("ERROR: Corrupted compressed trajectory");
+  }
+  frame_.resize(size);
+  input_.read(frame_.data(), static_cast<std::streamsize>(size));
+  if (static_cast<std::uint64_t>(input_.gcount()) != size) {
+    throw std::runtime_error("ERROR: Truncated compressed trajectory");
+  }
+
+  bytes = frame_.data();
+  std::uint64_t const step = get_u64(bytes);
+  double const time = get_f64(bytes);
+  char const keyframe = *bytes;
+  if ((keyframe != 0 && keyframe != 1) || (keyframe == 0 && frames_ == 0)) {
+    throw std::runtime_error("ERROR: Corrupted compressed trajectory");
+  }
+  std::uint64_t const since = keyframe == 1 ? 0 : since_keyframe_ + 1;
+
+  // the size of a block follows from its width, so the blocks are found
+  // with a sweep over the widths
+  std::size_t offset{frame_header_bytes};
+  for (std::size_t task{}; task != offsets_.size(); ++task) {
+    if (offset >= size) {
+      throw std::runtime_error("ERROR: Corrupted compressed trajectory");
+    }
+    unsigned const width = static_cast<unsigned char>(frame_[offset]);
+    std::size_t const first = (task % blocks) * block_size;
+    offsets_[task] = offset;
+    offset += 1 + packed_bytes(width, std::min(boids_, first + block_size) -
+                                          first);
+    if (width > max_width || offset > size) {
+      throw std::runtime_error("ERROR: Corrupted compressed trajectory");
+    }
+  }
+  if (offset != size) {
+    throw std::runtime_error("ERROR: Corrupted compressed trajectory");
+  }
+
+  parallel::parallel_for(offsets_.size(), [&](std::size_t task) {
+    std::size_t const component = task / blocks;
+    std::size_t const first = (task % blocks) * block_size;
+    std::size_t const last = std::min(boids_, first + block_size);
+    char const *const block = frame_.data() + offsets_[task];
+    std::uint64_t residuals[block_size];
+    unpack(block + 1, last - first, static_cast<unsigned char>(*block),
+           residuals);
+    for (std::size_t i{first}; i != last; ++i) {
+      std::size_t const k = component * boids_ + i;
+      current_[k] = predict(since, previous_[k], before_previous_[k]) +
+                    unzigzag(residuals[i - first]);
+      if (!(std::abs(static_cast<double>(current_[k])) < max_magnitude)) {
+        throw std::runtime_error("ERROR: Corrupted compressed trajectory");
+      }
+    }
+  });
+
+  quantizer const scale{parameters_.left_bound, parameters_.bottom_bound,
+                        settings_};
+  frame.step = step;
+  frame.time = time;
+  frame.flock.clear();
+  frame.flock.reserve(boids_);
+  for (std::size_t i{}; i != boids_; ++i) {
+    double values[components];
+    for (std::size_t component{}; component != components; ++component) {
+      values[component] =
+          scale.origin[component] +
+          static_cast<double>(current_[component * boids_ + i]) *
+              scale.step[component];
+    }
+    frame.flock.emplace_back(values[0], values[1], values[2], values[3]);
+  }
+  ++frames_;
+  since_keyframe_ = since;
+  before_previous_.swap(previous_);
+  previous_.swap(current_);
+  return true;
+}
+
+std::uint64_t trajectory_decoder::frames() const { return frames_; }
+std::size_t trajectory_decoder::boids() const { return boids_; }
+codec_settings const &trajectory_decoder::settings() const {
+  return settings_;
+}
+dynamics::running_parameters const &trajectory_decoder::parameters() const {
+  return parameters_;
+}
+} // namespace io
@@ -0,0 +1,170 @@
+#include "../include/density_field.hpp"
+#include "../include/parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+namespace view {
+namespace {
+// boids scattered on the private grids of a task
+constexpr std::size_t boids_per_chunk{4096};
+// cells holding less than this are considered empty by mean_velocity, the
+// blending and the smoothing leave tiny fractions of boids everywhere
+constexpr double empty_count{1e-9};
+
+// weights of a Gaussian sampled at the cells, normalized to 1
+std::vector<double> gaussian_kernel(double sigma, double cell_size) {
+  double const width = sigma / cell_size;
+  int const reach = static_cast<int>(std::ceil(3. * width));
+  std::vector<double> kernel(2 * reach + 1);
+  for (int offset{-reach}; offset <= reach; ++offset) {
+    kernel[offset + reach] = std::exp(-.5 * offset * offset / (width * width));
+  }
+  double sum{};
+  for (double weight : kernel) {
+    sum += weight;
+  }
+  for (double &weight : kernel) {
+    weight /= sum;
+  }
+  return kernel;
+}
+
+// convolution of the lines of a row major grid with a periodic kernel,
+// along the rows if stride is 1 and along the columns if it is the number of
+// columns
+void convolve(std::vector<double> &grid, std::size_t lines,
+              std::size_t length, std::size_t line_stride, std::size_t stride,
+              std::vector<double> const &kernel) {
+  int const reach = static_cast<int>(kernel.size() / 2);
+  int const size = static_cast<int>(length);
+  parallel::parallel_for(lines, [&](std::size_t line) {
+    std::size_t const first = line * line_stride;
+    std::vector<double> smoothed(length);
+    for (int i{}; i != size; ++i) {
+      double sum{};
+      for (int offset{-reach}; offset <= reach; ++offset) {
+        int const source = ((i + offset) % size + size) % size;
+        sum += kernel[offset + reach] * grid[first + source * stride];
+      }
+      smoothed[i] = sum;
+    }
+    for (std::size_t i{}; i != length; ++i) {
+      grid[first + i * stride] = smoothed[i];
+    }
+  });
+}
+} // namespace
+
+density_field::density_field(std::size_t columns, std::size_t rows,
+                             dynamics::running_parameters const &parameters)
+    : columns_{columns}, rows_{rows}, left_{parameters.left_bound},
+      bottom_{parameters.bottom_bound},
+      cell_width_{(parameters.right_bound - parameters.left_bound) / columns},
+      cell_height_{(parameters.upper_bound - parameters.bottom_bound) / rows},
+      counts_(columns * rows), momentum_x_(columns * rows),
+      momentum_y_(columns * rows) {
+  if (columns == 0 || rows == 0 || !(cell_width_ > 0.) ||
+      !(cell_height_ > 0.)) {
+    throw std::runtime_error("ERROR: Invalid density field grid");
+  }
+}
+
+void density_field::update(std::vector<dynamics::Boid> const &flock,
+                           double persistence) {
+  if (!(persistence >= 0. && persistence < 1.)) {
+    throw std::runtime_error("ERROR: The persistence must be in [0, 1)");
+  }
+  std::size_t const cells = counts_.size();
+  std::size_t const chunks =
+      (flock.size() + boids_per_chunk - 1) / boids_per_chunk;
+  // the three grids of every chunk, one after the other
+  std::vector<std::vector<double>> partial(chunks);
+  parallel::parallel_for(chunks, [&](std::size_t chunk) {
+    std::vector<double> grids(3 * cells);
+    std::size_t const last =
+        std::min(flock.size(), (chunk + 1) * boids_per_chunk);
+    for (std::size_t i{chunk * boids_per_chunk}; i != last; ++i) {
+      // boids out of the bounds belong to the border cells
+      math::R2 const r = flock[i].r();
+      std::size_t const column = static_cast<std::size_t>(std::clamp(
+          std::floor((r.x - left_) / cell_width_), 0., columns_ - 1.));
+      std::size_t const row = static_cast<std::size_t>(std::clamp(
+          std::floor((r.y - bottom_) / cell_height_), 0., rows_ - 1.));
+      std::size_t const cell = row * columns_ + column;
+      grids[cell] += 1.;
+      grids[cells + cell] += flock[i].v().x;
+      grids[2 * cells + cell] += flock[i].v().y;
+    }
+    partial[chunk] = std::move(grids);
+  });
+
+  double const fresh = 1. - persistence;
+  for (std::size_t cell{}; cell != cells; ++cell) {
+    double count{};
+    double momentum_x{};
+    double momentum_y{};
+    for (auto const &grids : partial) {
+      count += grids[cell];
+      momentum_x += grids[cells + cell];
+      momentum_y += grids[2 * cells + cell];
+    }
+    counts_[cell] = persistence * counts_[cell] + fresh * count;
+    momentum_x_[cell] = persistence * momentum_x_[cell] + fresh * momentum_x;
+    momentum_y_[cell] = persistence * momentum_y_[cell] + fresh * momentum_y;
+  }
+}
+
+density_field density_field::smoothed(double sigma) const {
+  density_field result{*this};
+  if (!(sigma > 0.)) {
+    return result;
+  }
+  std::vector<double> const row_kernel = gaussian_kernel(sigma, cell_width_);
+  std::vector<double> const column_kernel =
+      gaussian_kernel(sigma, cell_height_);
+  for (auto grid : {&result.counts_, &result.momentum_x_,
+                    &result.momentum_y_}) {
+    convolve(*grid, rows_, columns_, columns_, 1, row_kernel);
+    convolve(*grid, columns_, rows_, 1, columns_, column_kernel);
+  }
+  return result;
+}
+
+std::size_t density_field::columns() const { return columns_; }
+std::size_t density_field::rows() const { return rows_; }
+double density_field::cell_width() const { return cell_width_; }
+double density_field::cell_height() const { return cell_height_; }
+
+double density_field::count(std::size_t column, std::size_t row) const {
+  return counts_[row * columns_ + column];
+}
+
+double density_field::density(std::size_t column, std::size_t row) const {
+  return count(column, row) / (cell_width_ * cell_height_);
+}
+
+math::R2 density_field::mean_velocity(std::size_t column,
+                                      std::size_t row) const {
+  std::size_t const cell = row * columns_ + column;
+  if (counts_[cell] < empty_count) {
+    return {};
+  }
+  return math::R2{momentum_x_[cell], momentum_y_[cell]} *
+         (1. / counts_[cell]);
+}
+
+double density_field::total() const {
+  double total{};
+  for (double count : counts_) {
+    total += count;
+  }
+  return total;
+}
+
+double density_field::maximum_count() const {
+  return *std::max_element(counts_.begin(), counts_.end());
+}
+} // namespace view
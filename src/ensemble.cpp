@@ -0,0 +1,225 @@
+#include "../include/ensemble.hpp"
+#include "../include/batch.hpp"
+#include "../include/parallel.hpp"
+
+#include <algorithm>
+#include <istream>
+#include <sstream>
+#include <stdexcept>
+
+namespace dynamics {
+namespace {
+// splitmix64 finalizer, neighboring indices give unrelated seeds
+std::uint64_t mix(std::uint64_t value) {
+  value += 0x9e3779b97f4a7c15ULL;
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+  return value ^ (value >> 31);
+}
+
+std::string trim(std::string const &to_be_trimmed) {
+  auto const first = to_be_trimmed.find_first_not_of(" \t\r");
+  if (first == std::string::npos) {
+    return "";
+  }
+  auto const last = to_be_trimmed.find_last_not_of(" \t\r");
+  return to_be_trimmed.substr(first, last - first + 1);
+}
+
+// converts a whole token to a number, returns false if it isn't one
+template <typename Number>
+bool read_number(std::string const &token, Number &number) {
+  std::istringstream stream{token};
+  stream >> number;
+  return !stream.fail() && stream.eof();
+}
+
+// reads a range "first [last points]"
+bool read_range(std::vector<std::string> const &tokens, sweep_range &range) {
+  if (tokens.size() == 1 && read_number(tokens[0], range.first)) {
+    range.last = range.first;
+    range.points = 1;
+    return true;
+  }
+  return tokens.size() == 3 && read_number(tokens[0], range.first) &&
+         read_number(tokens[1], range.last) &&
+         read_number(tokens[2], range.points);
+}
+} // namespace
+
+std::vector<double> sweep_values(sweep_range const &range) {
+  std::vector<double> values;
+  if (range.points <= 1) {
+    values.push_back(range.first);
+    return values;
+  }
+  values.reserve(range.points);
+  double const step = (range.last - range.first) / (range.points - 1);
+  for (int i{}; i != range.points; ++i) {
+    values.push_back(range.first + i * step);
+  }
+  // the last value is exact whatever the rounding of step
+  values.back() = range.last;
+  return values;
+}
+
+sweep_specification parse_sweep(std::istream &input) {
+  sweep_specification sweep{};
+  std::string line;
+  int line_number{};
+  while (std::getline(input, line)) {
+    ++line_number;
+    line = trim(line.substr(0, line.find('#')));
+    if (line.empty()) {
+      continue;
+    }
+    auto const equal = line.find('=');
+    if (equal == std::string::npos) {
+      throw std::runtime_error("ERROR: Missing '=' at line " +
+                               std::to_string(line_number));
+    }
+    std::string const key = trim(line.substr(0, equal));
+    std::istringstream value{line.substr(equal + 1)};
+    std::vector<std::string> tokens;
+    for (std::string token; value >> token;) {
+      tokens.push_back(token);
+    }
+    running_parameters &base = sweep.base;
+    bool const single = tokens.size() == 1;
+    bool valid{false};
+
+    if (key == "s") {
+      valid = read_range(tokens, sweep.s);
+    } else if (key == "a") {
+      valid = read_range(tokens, sweep.a);
+    } else if (key == "c") {
+      valid = read_range(tokens, sweep.c);
+    } else if (key == "repetitions") {
+      valid = single && read_number(tokens[0], sweep.repetitions);
+    } else if (key == "steps") {
+      valid = single && read_number(tokens[0], sweep.steps);
+    } else if (key == "delta_t") {
+      valid = single && read_number(tokens[0], sweep.delta_t);
+    } else if (key == "lanes") {
+      valid = single && read_number(tokens[0], sweep.lanes);
+    } else if (key == "seed") {
+      valid = single && read_number(tokens[0], sweep.seed);
+    } else if (key == "boids_number") {
+      valid = single && read_number(tokens[0], base.boids_number);
+    } else if (key == "d_s") {
+      valid = single && read_number(tokens[0], base.d_s);
+    } else if (key == "d") {
+      valid = single && read_number(tokens[0], base.d);
+    } else if (key == "left_bound") {
+      valid = single && read_number(tokens[0], base.left_bound);
+    } else if (key == "right_bound") {
+      valid = single && read_number(tokens[0], base.right_bound);
+    } else if (key == "upper_bound") {
+      valid = single && read_number(tokens[0], base.upper_bound);
+    } else if (key == "bottom_bound") {
+      valid = single && read_number(tokens[0], base.bottom_bound);
+    } else if (key == "maximum_velocity") {
+      valid = single && read_number(tokens[0], base.maximum_velocity);
+    } else if (key == "minimum_velocity") {
+      valid = single && read_number(tokens[0], base.minimum_velocity);
+    } else {
+      throw std::runtime_error("ERROR: Unknown key " + key + " at line " +
+                               std::to_string(line_number));
+    }
+    if (!valid) {
+      throw std::runtime_error("ERROR: Invalid value for " + key +
+                               " at line " + std::to_string(line_number));
+    }
+  }
+
+  // the statistics need at least three boids
+  if (sweep.base.boids_number < 3 || sweep.repetitions < 1 ||
+      sweep.steps < 0 || sweep.lanes < 1 || sweep.s.points < 1 || sweep.a.points < 1 ||
+      sweep.c.points < 1) {
+    throw std::runtime_error("ERROR: Invalid sweep specification");
+  }
+  return sweep;
+}
+
+std::uint64_t run_seed(std::uint64_t sweep_seed, int index) {
+  return mix(mix(sweep_seed) + static_cast<std::uint64_t>(index));
+}
+
+std::vector<run_result> run_ensemble(sweep_specification const &sweep) {
+  // every combination of the swept values, repeated
+  std::vector<running_parameters> runs;
+  for (double s : sweep_values(sweep.s)) {
+    for (double a : sweep_values(sweep.a)) {
+      for (double c : sweep_values(sweep.c)) {
+        running_parameters parameters = sweep.base;
+        parameters.s = s;
+        parameters.a = a;
+        parameters.c = c;
+        runs.insert(runs.end(), sweep.repetitions, parameters);
+      }
+    }
+  }
+
+  // the batches are handed out dynamically to the threads, inside a batch
+  // the parallel algorithms are serial. A small sweep is split in smaller
+  // batches so that every thread gets one, the lanes of a batch evolve
+  // independently, so results do not depend on the batches
+  std::size_t const threads = parallel::thread_count();
+  std::size_t const lanes = std::max<std::size_t>(
+      1, std::min<std::size_t>(sweep.lanes,
+                               (runs.size() + threads - 1) / threads));
+  std::size_t const batches = (runs.size() + lanes - 1) / lanes;
+  std::vector<run_result> results(runs.size());
+  parallel::parallel_for(batches, [&](std::size_t batch_index) {
+    std::size_t const first = batch_index * lanes;
+    std::size_t const last = std::min(runs.size(), first + lanes);
+    std::vector<std::vector<Boid>> flocks;
+    std::vector<std::uint64_t> seeds;
+    for (std::size_t index{first}; index != last; ++index) {
+      seeds.push_back(run_seed(sweep.seed, static_cast<int>(index)));
+      std::mt19937_64 engine{seeds.back()};
+      flocks.push_back(create_flock(runs[index], engine));
+    }
+    flock_batch batch{flocks,
+                      {runs.begin() + first, runs.begin() + last}};
+    for (int step{}; step != sweep.steps; ++step) {
+      batch.evolve(sweep.delta_t);
+    }
+    for (std::size_t index{first}; index != last; ++index) {
+      results[index] = {static_cast<int>(index), seeds[index - first],
+                        runs[index],
+                        view::build_data(batch.flock(index - first))};
+    }
+  });
+  return results;
+}
+
+std::string print_result_header_to_csv() {
+  return "run,seed,s,a,c,mean_distance,sigma_mean_distance,"
+         "confidence_mean_distance,mean_velocity,sigma_mean_velocity,"
+         "polarization,milling,mean_nearest_distance,sigma_nearest_distance\n";
+}
+
+std::string print_result_to_csv(run_result const &result) {
+  std::string to_be_returned{""};
+  to_be_returned += std::to_string(result.index);
+  to_be_returned += ',' + std::to_string(result.seed);
+  to_be_returned += ',' + std::to_string(result.parameters.s);
+  to_be_returned += ',' + std::to_string(result.parameters.a);
+  to_be_returned += ',' + std::to_string(result.parameters.c);
+  to_be_returned += ',' + std::to_string(result.statistics.mean_distance);
+  to_be_returned += ',' + std::to_string(result.statistics.sigma_mean_distance);
+  to_be_returned +=
+      ',' + std::to_string(result.statistics.confidence_mean_distance);
+  to_be_returned += ',' + std::to_string(result.statistics.mean_velocity);
+  to_be_returned += ',' + std::to_string(result.statistics.sigma_mean_velocity);
+  to_be_returned += ',' + std::to_string(result.statistics.polarization);
+  to_be_returned += ',' + std::to_string(result.statistics.milling);
+  to_be_returned +=
+      ',' + std::to_string(result.statistics.mean_nearest_distance);
+  to_be_returned +=
+      ',' + std::to_string(result.statistics.sigma_nearest_distance);
+  to_be_returned += '\n';
+  return to_be_returned;
+}
+} // namespace dynamics
@@ -0,0 +1,88 @@
+#include "../include/fft.hpp"
+#include "../include/parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+namespace math {
+namespace {
+constexpr double pi{3.14159265358979323846};
+
+bool is_power_of_two(std::size_t value) {
+  return value != 0 && (value & (value - 1)) == 0;
+}
+} // namespace
+
+std::size_t next_power_of_two(std::size_t value) {
+  std::size_t power{1};
+  while (power < value) {
+    power *= 2;
+  }
+  return power;
+}
+
+// iterative Cooley-Tukey, the values are put in bit reversed order and then
+// combined in butterflies of growing length
+void fft(std::vector<std::complex<double>> &values, bool inverse) {
+  std::size_t const n = values.size();
+  if (!is_power_of_two(n)) {
+    throw std::runtime_error("ERROR: The size of a FFT must be a power of two");
+  }
+  for (std::size_t i{1}, j{}; i != n; ++i) {
+    std::size_t bit = n >> 1;
+    for (; (j & bit) != 0; bit >>= 1) {
+      j ^= bit;
+    }
+    j ^= bit;
+    if (i < j) {
+      std::swap(values[i], values[j]);
+    }
+  }
+  double const sign = inverse ? 1. : -1.;
+  for (std::size_t length{2}; length <= n; length *= 2) {
+    double const angle = sign * 2. * pi / static_cast<double>(length);
+    std::size_t const half = length / 2;
+    for (std::size_t k{}; k != half; ++k) {
+      // the twiddle factors are computed directly, repeated multiplications
+      // would accumulate rounding errors
+      std::complex<double> const twiddle = std::polar(1., angle * k);
+      for (std::size_t first{}; first < n; first += length) {
+        std::complex<double> const even = values[first + k];
+        std::complex<double> const odd = values[first + k + half] * twiddle;
+        values[first + k] = even + odd;
+        values[first + k + half] = even - odd;
+      }
+    }
+  }
+  if (inverse) {
+    for (auto &value : values) {
+      value /= static_cast<double>(n);
+    }
+  }
+}
+
+void fft_2d(std::vector<std::complex<double>> &values, std::size_t columns,
+            std::size_t rows, bool inverse) {
+  if (values.size() != columns * rows) {
+    throw std::runtime_error("ERROR: The grid of a FFT has the wrong size");
+  }
+  parallel::parallel_for(rows, [&](std::size_t row) {
+    std::vector<std::complex<double>> line(values.begin() + row * columns,
+                                           values.begin() + (row + 1) * columns);
+    fft(line, inverse);
+    std::copy(line.begin(), line.end(), values.begin() + row * columns);
+  });
+  parallel::parallel_for(columns, [&](std::size_t column) {
+    std::vector<std::complex<double>> line(rows);
+    for (std::size_t row{}; row != rows; ++row) {
+      line[row] = values[row * columns + column];
+    }
+    fft(line, inverse);
+    for (std::size_t row{}; row != rows; ++row) {
+      values[row * columns + column] = line[row];
+    }
+  });
+}
+} // namespace math
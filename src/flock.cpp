@@ -1,7 +1,10 @@
 #include "../include/flock.hpp"
+#include "../include/parallel.hpp"
+#include "../include/welford.hpp"
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <numeric>
 #include <random>
 
@@ -67,13 +70,10 @@ math::R2 calculate_alignment(Boid const &boid_to_evolve,
                              std::vector<Boid> const &flock, double const a) {
   double const n = flock.size();
   assert(n > 1);
-  // Calculate the sum of velocity vectors of all boids in the flock
-  auto velocity_sum =
-      std::accumulate(flock.begin(), flock.end(), math::R2{},
-                      [](math::R2 velocity_sum, Boid const &current_boid) {
-                        velocity_sum += current_boid.v();
-                        return velocity_sum;
-                      });
+  // Calculate the sum of velocity vectors of all boids in the flock, like
+  // calculate_CDM pairwise and serially since it runs for every boid
+  math::R2 velocity_sum = parallel::pairwise_sum<math::R2>(
+      0, flock.size(), [&](std::size_t i) { return flock[i].v(); });
 
   // Calculate the mean velocity vector of the flock (excluding the
   // boid_to_evolve)
@@ -128,30 +128,103 @@ Boid evolve_boid(std::vector<Boid> const &flock, Boid &boid_to_evolve,
 // step
 void evolve_flock(std::vector<Boid> &flock, double const delta_t,
                   running_parameters const &parameters) {
+  order_parameters ignored{};
+  evolve_flock(flock, delta_t, parameters, ignored);
+}
+
+namespace {
+// Accumulates the sums needed by the order parameters one boid at a time, the
+// angular momentum around the center of mass R is obtained from the identity
+// sum (r - R) x u = sum r x u - R x sum u, so R is not needed in advance. The
+// positions are accumulated with Welford's algorithm, which gives the squared
+// distances from R without subtracting two large nearly equal sums
+class order_accumulator {
+private:
+  double count_{0.};
+  math::R2 heading_sum_;
+  math::welford x_;
+  math::welford y_;
+  double momentum_sum_{0.};
+
+  static double cross(math::R2 const &lhs, math::R2 const &rhs) {
+    return lhs.x * rhs.y - lhs.y * rhs.x;
+  }
+
+public:
+  void add(Boid const &boid) {
+    double const speed = math::calculate_norm(boid.v());
+    // a boid standing still has no heading
+    math::R2 const heading =
+        speed > 0. ? boid.v() * (1. / speed) : math::R2{};
+    count_ += 1.;
+    heading_sum_ += heading;
+    x_.add(boid.r().x);
+    y_.add(boid.r().y);
+    momentum_sum_ += cross(boid.r(), heading);
+  }
+
+  order_parameters result() const {
+    if (count_ == 0.) {
+      return {0., 0.};
+    }
+    math::R2 const mass_center{x_.mean(), y_.mean()};
+    double const momentum =
+        (momentum_sum_ - cross(mass_center, heading_sum_)) / count_;
+    // the root mean square distance from the center of mass makes the
+    // milling of a rigid circular motion equal to 1
+    double const spread = std::sqrt((x_.m2() + y_.m2()) / count_);
+    return {math::calculate_norm(heading_sum_) / count_,
+            spread > 0. ? std::abs(momentum) / spread : 0.};
+  }
+};
+} // namespace
+
+void evolve_flock(std::vector<Boid> &flock, double const delta_t,
+                  running_parameters const &parameters,
+                  order_parameters &order) {
   // since it was decided to use the std algorithm transform, we prepare
   // new vector to hold the new state
   std::vector<Boid> evolved_flock;
   evolved_flock.reserve(flock.size());
+  order_accumulator accumulator;
 
   // Iterate through each boid in the flock and evolve it
   std::transform(flock.begin(), flock.end(), std::back_inserter(evolved_flock),
                  [&](Boid boid_to_evolve) {
-                   // return the evolved boid to the new satate
-                   return evolve_boid(
+                   // return the evolved boid to the new satate, adding it to
+                   // the order parameters on the way
+                   Boid const evolved_boid = evolve_boid(
                        get_neighborhood(flock, boid_to_evolve, parameters.d),
                        boid_to_evolve, delta_t, parameters);
+                   accumulator.add(evolved_boid);
+                   return evolved_boid;
                  });
   // Update the flock to the evolved state, this operation is the reason the
   // flock parameter is not const
   flock = evolved_flock;
+  order = accumulator.result();
+}
+
+order_parameters calculate_order_parameters(std::vector<Boid> const &flock) {
+  order_accumulator accumulator;
+  std::for_each(flock.begin(), flock.end(),
+                [&](Boid const &boid) { accumulator.add(boid); });
+  return accumulator.result();
 }
+
 // Function to create a flock of boids with uniformly distributed random
 // positions and velocities
 std::vector<dynamics::Boid>
 create_flock(dynamics::running_parameters const &parameters) {
-  std::vector<dynamics::Boid> flock;
   std::random_device rd;
-  std::default_random_engine eng(rd());
+  std::mt19937_64 engine(rd());
+  return create_flock(parameters, engine);
+}
+
+std::vector<dynamics::Boid>
+create_flock(dynamics::running_parameters const &parameters,
+             std::mt19937_64 &engine) {
+  std::vector<dynamics::Boid> flock;
   std::uniform_real_distribution<double> dist_width(parameters.left_bound,
                                                     parameters.right_bound);
   std::uniform_real_distribution<double> dist_height(parameters.bottom_bound,
@@ -160,10 +233,15 @@ create_flock(dynamics::running_parameters const &parameters) {
       -parameters.minimum_velocity * 2, parameters.maximum_velocity / 2);
   flock.reserve(parameters.boids_number);
   for (int i{}; i != parameters.boids_number; ++i) {
-    flock.emplace_back(
-        dist_width(rd), dist_height(rd), dist_speed(rd),
-        dist_speed(rd)); // it's better than push back since it build the object
-                         // directly inside the vector
+    // the draws are sequenced so that a seed gives the same flock with every
+    // compiler, the order of evaluation of arguments is unspecified
+    double const r_x = dist_width(engine);
+    double const r_y = dist_height(engine);
+    double const v_x = dist_speed(engine);
+    double const v_y = dist_speed(engine);
+    flock.emplace_back(r_x, r_y, v_x,
+                       v_y); // it's better than push back since it build the
+                             // object directly inside the vector
   }
   return flock;
 }
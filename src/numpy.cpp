@@ -0,0 +1,243 @@
+#include "../include/numpy.hpp"
+
+#include <array>
+#include <cstring>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <type_traits>
+
+namespace io {
+namespace {
+// the rows of the arrays are the boids as they are in memory
+static_assert(std::numeric_limits<double>::is_iec559,
+              "arrays of float64 are IEEE 754 doubles");
+static_assert(sizeof(math::R2) == 2 * sizeof(double) &&
+                  sizeof(dynamics::Boid) == 4 * sizeof(double),
+              "a boid is r_x r_y v_x v_y without padding");
+static_assert(std::is_standard_layout<dynamics::Boid>::value &&
+                  std::is_trivially_copyable<dynamics::Boid>::value,
+              "the memory of a flock can be written as it is");
+
+constexpr char npy_magic[6] = {'\x93', 'N', 'U', 'M', 'P', 'Y'};
+// magic, version and length of the header text
+constexpr std::size_t npy_preamble_bytes{10};
+constexpr std::size_t npy_alignment{64};
+constexpr std::size_t boid_bytes{sizeof(dynamics::Boid)};
+
+// zip records, every number little endian
+constexpr std::uint32_t local_header_signature{0x04034b50};
+constexpr std::uint32_t central_header_signature{0x02014b50};
+constexpr std::uint32_t end_signature{0x06054b50};
+constexpr std::size_t local_header_bytes{30};
+constexpr std::size_t central_header_bytes{46};
+constexpr std::size_t end_bytes{22};
+constexpr std::uint16_t zip_version{20};   // 2.0, stored files
+constexpr std::uint16_t dos_date{(1 << 5) | 1}; // 1 January 1980
+constexpr std::uint64_t max_zip_bytes{std::numeric_limits<std::uint32_t>::max()};
+constexpr std::size_t max_entries{std::numeric_limits<std::uint16_t>::max()};
+
+bool little_endian_host() {
+  std::uint16_t const probe{1};
+  unsigned char first{};
+  std::memcpy(&first, &probe, 1);
+  return first == 1;
+}
+
+void encode_u16(std::uint16_t value, char *bytes) {
+  bytes[0] = static_cast<char>(value & 0xff);
+  bytes[1] = static_cast<char>(value >> 8);
+}
+
+void encode_u32(std::uint32_t value, char *bytes) {
+  for (int i{}; i != 4; ++i) {
+    bytes[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+  }
+}
+
+void write_array(std::ostream &output, char const *data, std::size_t boids) {
+  std::string const header = npy_header(boids);
+  output.write(header.data(), static_cast<std::streamsize>(header.size()));
+  output.write(data, static_cast<std::streamsize>(boids * boid_bytes));
+  if (!output) {
+    throw std::runtime_error("ERROR: Failed to write the array");
+  }
+}
+
+void save_array(std::string const &path, char const *data, std::size_t boids) {
+  std::ofstream file{path, std::ios::binary};
+  if (!file) {
+    throw std::runtime_error("ERROR: Failed to create " + path);
+  }
+  write_array(file, data, boids);
+  file.close();
+  if (!file) {
+    throw std::runtime_error("ERROR: Failed to write " + path);
+  }
+}
+} // namespace
+
+std::uint32_t crc32(char const *bytes, std::size_t size, std::uint32_t crc) {
+  // the table of the reflected polynomial 0xedb88320, built once
+  static std::array<std::uint32_t, 256> const table = [] {
+    std::array<std::uint32_t, 256> built{};
+    for (std::uint32_t byte{}; byte != 256; ++byte) {
+      std::uint32_t value = byte;
+      for (int bit{}; bit != 8; ++bit) {
+        value = (value & 1) ? 0xedb88320 ^ (value >> 1) : value >> 1;
+      }
+      built[byte] = value;
+    }
+    return built;
+  }();
+  crc = ~crc;
+  for (std::size_t i{}; i != size; ++i) {
+    crc = table[(crc ^ static_cast<unsigned char>(bytes[i])) & 0xff] ^
+          (crc >> 8);
+  }
+  return ~crc;
+}
+
+std::string npy_header(std::size_t boids) {
+  std::string text = "{'descr': '";
+  text += little_endian_host() ? '<' : '>';
+  text += "f8', 'fortran_order': False, 'shape': (" + std::to_string(boids) +
+          ", 4), }";
+  // spaces and a newline up to the alignment of the data
+  std::size_t const unpadded = npy_preamble_bytes + text.size() + 1;
+  text.append((npy_alignment - unpadded % npy_alignment) % npy_alignment, ' ');
+  text += '\n';
+
+  std::string header(npy_magic, sizeof(npy_magic));
+  header += '\x01'; // version 1.0
+  header += '\x00';
+  char length[2];
+  encode_u16(static_cast<std::uint16_t>(text.size()), length);
+  header.append(length, 2);
+  return header + text;
+}
+
+void write_npy(std::ostream &output, std::vector<dynamics::Boid> const &flock) {
+  write_array(output, reinterpret_cast<char const *>(flock.data()),
+              flock.size());
+}
+
+void write_npy(std::ostream &output, frame_view const &frame) {
+  write_array(output, reinterpret_cast<char const *>(frame.values()),
+              frame.boids());
+}
+
+void save_npy(std::string const &path,
+              std::vector<dynamics::Boid> const &flock) {
+  save_array(path, reinterpret_cast<char const *>(flock.data()), flock.size());
+}
+
+void save_npy(std::string const &path, frame_view const &frame) {
+  save_array(path, reinterpret_cast<char const *>(frame.values()),
+             frame.boids());
+}
+
+npz_writer::npz_writer(std::string const &path)
+    : path_{path}, file_{path, std::ios::binary}, offset_{0} {
+  if (!file_) {
+    throw std::runtime_error("ERROR: Failed to create " + path);
+  }
+}
+
+npz_writer::~npz_writer() {
+  try {
+    close();
+  } catch (...) {
+    // errors can't be reported from a destructor
+  }
+}
+
+void npz_writer::add(std::string const &name,
+                     std::vector<dynamics::Boid> const &flock) {
+  add(name, reinterpret_cast<char const *>(flock.data()), flock.size());
+}
+
+void npz_writer::add(std::string const &name, frame_view const &frame) {
+  add(name, reinterpret_cast<char const *>(frame.values()), frame.boids());
+}
+
+void npz_writer::add(std::string const &name, char const *data,
+                     std::size_t boids) {
+  if (!file_.is_open()) {
+    throw std::runtime_error("ERROR: The archive is closed");
+  }
+  std::string const file_name = name + ".npy";
+  for (auto const &existing : entries_) {
+    if (existing.name == file_name) {
+      throw std::runtime_error("ERROR: " + name + " is already in " + path_);
+    }
+  }
+  std::string const header = npy_header(boids);
+  std::uint64_t const size = header.size() + std::uint64_t{boids} * boid_bytes;
+  // the central directory of the entries must fit too
+  std::uint64_t directory{end_bytes};
+  for (auto const &existing : entries_) {
+    directory += central_header_bytes + existing.name.size();
+  }
+  directory += central_header_bytes + file_name.size();
+  if (entries_.size() == max_entries ||
+      offset_ + local_header_bytes + file_name.size() + size + directory >
+          max_zip_bytes) {
+    throw std::runtime_error("ERROR: The array doesn't fit in " + path_);
+  }
+
+  entry const added{
+      file_name,
+      crc32(data, boids * boid_bytes, crc32(header.data(), header.size())),
+      static_cast<std::uint32_t>(size), static_cast<std::uint32_t>(offset_)};
+  char local[local_header_bytes]{};
+  encode_u32(local_header_signature, local);
+  encode_u16(zip_version, local + 4);
+  // flags, method (stored) and time are 0
+  encode_u16(dos_date, local + 12);
+  encode_u32(added.crc, local + 14);
+  encode_u32(added.size, local + 18); // compressed
+  encode_u32(added.size, local + 22); // uncompressed
+  encode_u16(static_cast<std::uint16_t>(file_name.size()), local + 26);
+  file_.write(local, sizeof(local));
+  file_.write(file_name.data(),
+              static_cast<std::streamsize>(file_name.size()));
+  write_array(file_, data, boids);
+  offset_ += local_header_bytes + file_name.size() + size;
+  entries_.push_back(added);
+}
+
+void npz_writer::close() {
+  if (!file_.is_open()) {
+    return;
+  }
+  std::uint64_t const directory_offset = offset_;
+  for (auto const &written : entries_) {
+    char central[central_header_bytes]{};
+    encode_u32(central_header_signature, central);
+    encode_u16(zip_version, central + 4); // made by
+    encode_u16(zip_version, central + 6); // needed
+    encode_u16(dos_date, central + 14);
+    encode_u32(written.crc, central + 16);
+    encode_u32(written.size, central + 20);
+    encode_u32(written.size, central + 24);
+    encode_u16(static_cast<std::uint16_t>(written.name.size()), central + 28);
+    encode_u32(written.offset, central + 42);
+    file_.write(central, sizeof(central));
+    file_.write(written.name.data(),
+                static_cast<std::streamsize>(written.name.size()));
+    offset_ += central_header_bytes + written.name.size();
+  }
+  char end[end_bytes]{};
+  encode_u32(end_signature, end);
+  encode_u16(static_cast<std::uint16_t>(entries_.size()), end + 8);
+  encode_u16(static_cast<std::uint16_t>(entries_.size()), end + 10);
+  encode_u32(static_cast<std::uint32_t>(offset_ - directory_offset), end + 12);
+  encode_u32(static_cast<std::uint32_t>(directory_offset), end + 16);
+  file_.write(end, sizeof(end));
+  file_.close();
+  if (!file_) {
+    throw std::runtime_error("ERROR: Failed to write " + path_);
+  }
+}
+} // namespace io
@@ -0,0 +1,104 @@
+#include "../include/pair_correlation.hpp"
+#include "../include/parallel.hpp"
+#include "../include/spatial.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace view {
+namespace {
+// boids whose couples are counted in a private histogram before touching the
+// shared counters, it keeps the atomic additions few and uncontended
+constexpr std::size_t boids_per_block{256};
+constexpr double pi{3.14159265358979323846};
+} // namespace
+
+pair_correlation::pair_correlation(
+    double r_max, std::size_t bins,
+    dynamics::running_parameters const &parameters)
+    : r_max_{r_max}, bin_width_{r_max / static_cast<double>(bins)},
+      area_{(parameters.right_bound - parameters.left_bound) *
+            (parameters.upper_bound - parameters.bottom_bound)},
+      parameters_{parameters}, counts_(bins), frames_{0}, couples_{0} {
+  double const shortest =
+      std::min(parameters.right_bound - parameters.left_bound,
+               parameters.upper_bound - parameters.bottom_bound);
+  if (bins == 0 || !(r_max > 0.) || r_max > shortest / 2.) {
+    throw std::runtime_error("ERROR: Invalid radial distribution range");
+  }
+  reset();
+}
+
+void pair_correlation::add_frame(std::vector<dynamics::Boid> const &flock) {
+  std::size_t const n = flock.size();
+  dynamics::cell_list const cells{flock, r_max_, parameters_, true};
+  std::size_t const blocks = (n + boids_per_block - 1) / boids_per_block;
+  parallel::parallel_for(blocks, [&](std::size_t block) {
+    std::vector<std::uint64_t> local(counts_.size());
+    std::size_t const last = std::min(n, (block + 1) * boids_per_block);
+    for (std::size_t i{block * boids_per_block}; i != last; ++i) {
+      cells.for_each_neighbor(flock[i].r(), r_max_,
+                              [&](std::size_t j, math::R2 const &d) {
+                                // every couple is counted once
+                                if (j > i) {
+                                  std::size_t const bin = static_cast<
+                                      std::size_t>(
+                                      std::sqrt(d * d) / bin_width_);
+                                  ++local[std::min(bin, local.size() - 1)];
+                                }
+                              });
+    }
+    for (std::size_t bin{}; bin != local.size(); ++bin) {
+      if (local[bin] != 0) {
+        counts_[bin].fetch_add(local[bin], std::memory_order_relaxed);
+      }
+    }
+  });
+  std::uint64_t const couples = n < 2 ? 0 : n * (n - 1) / 2;
+  couples_.fetch_add(couples, std::memory_order_relaxed);
+  frames_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void pair_correlation::reset() {
+  for (auto &count : counts_) {
+    count.store(0, std::memory_order_relaxed);
+  }
+  frames_.store(0, std::memory_order_relaxed);
+  couples_.store(0, std::memory_order_relaxed);
+}
+
+std::size_t pair_correlation::bins() const { return counts_.size(); }
+double pair_correlation::bin_width() const { return bin_width_; }
+std::uint64_t pair_correlation::frames() const {
+  return frames_.load(std::memory_order_relaxed);
+}
+
+std::vector<double> pair_correlation::radii() const {
+  std::vector<double> radii(counts_.size());
+  for (std::size_t bin{}; bin != radii.size(); ++bin) {
+    radii[bin] = (bin + .5) * bin_width_;
+  }
+  return radii;
+}
+
+// in a frame of n boids an ideal gas puts n (n - 1) / 2 * shell / area
+// couples in the shell of a bin
+std::vector<double> pair_correlation::values() const {
+  std::vector<double> values(counts_.size());
+  double const couples =
+      static_cast<double>(couples_.load(std::memory_order_relaxed));
+  if (couples == 0.) {
+    return values;
+  }
+  for (std::size_t bin{}; bin != values.size(); ++bin) {
+    double const inner = bin * bin_width_;
+    double const outer = inner + bin_width_;
+    double const shell = pi * (outer * outer - inner * inner);
+    values[bin] = static_cast<double>(
+                      counts_[bin].load(std::memory_order_relaxed)) /
+                  (couples * shell / area_);
+  }
+  return values;
+}
+} // namespace view
@@ -0,0 +1,39 @@
+#include "../include/parallel.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace parallel {
+namespace {
+// hardware_concurrency is allowed to return 0 when it can't be determined
+unsigned default_thread_count() {
+  unsigned const hardware = std::thread::hardware_concurrency();
+  return hardware == 0 ? 1 : hardware;
+}
+
+std::atomic<unsigned> current_thread_count{default_thread_count()};
+} // namespace
+
+unsigned thread_count() { return current_thread_count; }
+// at least one thread is always used
+void thread_count(unsigned new_count) {
+  current_thread_count = new_count == 0 ? 1 : new_count;
+}
+
+void back_off(unsigned &idle) {
+  if (idle < 64) {
+    ++idle;
+    std::this_thread::yield();
+  } else {
+    std::this_thread::sleep_for(std::chrono::microseconds{200});
+  }
+}
+
+namespace detail {
+bool &inside_parallel_region() {
+  thread_local bool inside{false};
+  return inside;
+}
+} // namespace detail
+} // namespace parallel
@@ -0,0 +1,143 @@
+#include "../include/recorder.hpp"
+#include "../include/parallel.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace io {
+namespace {
+// the decimation stops doubling at one frame in this many
+constexpr std::uint64_t max_decimation{64};
+} // namespace
+
+recorder::recorder(frame_sink sink, std::size_t boids, std::size_t buffers,
+                   backpressure policy)
+    : sink_{std::move(sink)}, policy_{policy}, buffers_(buffers),
+      full_{buffers}, free_{buffers}, stopping_{false}, failed_{false},
+      offered_{0}, queued_{0}, written_{0}, dropped_{0}, decimation_{1} {
+  if (buffers == 0) {
+    throw std::runtime_error("ERROR: A recorder needs at least one buffer");
+  }
+  for (std::size_t index{}; index != buffers; ++index) {
+    buffers_[index].flock.reserve(boids);
+    free_.try_push(index);
+  }
+  // the thread starts once every member is ready
+  thread_ = std::thread{&recorder::work, this};
+}
+
+recorder::~recorder() {
+  try {
+    close();
+  } catch (...) {
+    // the error of the sink can't be reported from a destructor
+  }
+}
+
+bool recorder::record(std::uint64_t step, double time,
+                      std::vector<dynamics::Boid> const &flock) {
+  if (failed_.load(std::memory_order_acquire)) {
+    std::rethrow_exception(error_);
+  }
+  if (stopping_.load(std::memory_order_relaxed)) {
+    throw std::runtime_error("ERROR: The recorder is closed");
+  }
+  std::uint64_t const offered = offered_.load(std::memory_order_relaxed);
+  offered_.store(offered + 1, std::memory_order_relaxed);
+  // only the producer changes these, so plain loads and stores are enough
+  auto const drop = [this]() {
+    dropped_.store(dropped_.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_relaxed);
+    return false;
+  };
+  std::uint64_t decimation = decimation_.load(std::memory_order_relaxed);
+  if (offered % decimation != 0) {
+    return drop();
+  }
+
+  std::size_t index;
+  if (policy_ == backpressure::block) {
+    unsigned idle{};
+    while (!free_.try_pop(index)) {
+      if (failed_.load(std::memory_order_acquire)) {
+        std::rethrow_exception(error_);
+      }
+      parallel::back_off(idle);
+    }
+  } else if (!free_.try_pop(index)) {
+    if (policy_ == backpressure::decimate) {
+      decimation_.store(std::min(2 * decimation, max_decimation),
+                        std::memory_order_relaxed);
+    }
+    return drop();
+  }
+  // the writer has caught up when few frames are waiting
+  if (policy_ == backpressure::decimate && decimation > 1 &&
+      4 * full_.size() <= buffers_.size()) {
+    decimation_.store(decimation / 2, std::memory_order_relaxed);
+  }
+
+  frame_buffer &buffer = buffers_[index];
+  buffer.step = step;
+  buffer.time = time;
+  // the capacity of the buffer is reused, nothing is allocated
+  buffer.flock.assign(flock.begin(), flock.end());
+  full_.try_push(index);
+  queued_.store(queued_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+  return true;
+}
+
+void recorder::close() {
+  if (thread_.joinable()) {
+    stopping_.store(true, std::memory_order_release);
+    thread_.join();
+  }
+  if (failed_.load(std::memory_order_acquire)) {
+    std::rethrow_exception(error_);
+  }
+}
+
+recorder_statistics recorder::statistics() const {
+  return {offered_.load(std::memory_order_relaxed),
+          queued_.load(std::memory_order_relaxed),
+          written_.load(std::memory_order_relaxed),
+          dropped_.load(std::memory_order_relaxed),
+          decimation_.load(std::memory_order_relaxed)};
+}
+
+void recorder::work() {
+  auto const write = [this](std::size_t index) {
+    if (!failed_.load(std::memory_order_relaxed)) {
+      frame_buffer const &buffer = buffers_[index];
+      try {
+        sink_(buffer.step, buffer.time, buffer.flock);
+        written_.fetch_add(1, std::memory_order_relaxed);
+      } catch (...) {
+        error_ = std::current_exception();
+        failed_.store(true, std::memory_order_release);
+      }
+    }
+    // there are never more indices than slots, so the push succeeds
+    free_.try_push(index);
+  };
+
+  unsigned idle{};
+  std::size_t index;
+  while (true) {
+    if (full_.try_pop(index)) {
+      write(index);
+      idle = 0;
+    } else if (stopping_.load(std::memory_order_acquire)) {
+      // every frame recorded before close is visible now
+      if (!full_.try_pop(index)) {
+        return;
+      }
+      write(index);
+    } else {
+      parallel::back_off(idle);
+    }
+  }
+}
+} // namespace io
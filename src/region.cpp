@@ -0,0 +1,340 @@
+#include "../include/region.hpp"
+#include "../include/spatial.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+
+namespace io {
+namespace {
+static_assert(std::numeric_limits<double>::is_iec559,
+              "region trajectories store IEEE 754 doubles");
+static_assert(sizeof(dynamics::Boid) == 4 * sizeof(double) &&
+                  std::is_trivially_copyable<dynamics::Boid>::value,
+              "the selected boids are written as they are in memory");
+
+constexpr char magic[8] = {'B', 'O', 'I', 'D', 'R', 'E', 'G', 'N'};
+// magic, version, rectangle, boids, vertices, boids_number and parameters
+constexpr std::size_t header_bytes{8 + 4 + 4 + 8 + 8 + 8 + 11 * 8};
+// step, time and selected boids
+constexpr std::size_t frame_header_bytes{3 * 8};
+// the ids are indices of u32
+constexpr std::uint64_t max_boids{std::uint64_t{1} << 32};
+// more vertices in a header are taken for a corrupted file
+constexpr std::uint64_t max_vertices{std::uint64_t{1} << 20};
+
+void check_little_endian() {
+  std::uint16_t const probe{1};
+  unsigned char first{};
+  std::memcpy(&first, &probe, 1);
+  if (first != 1) {
+    throw std::runtime_error(
+        "ERROR: Region trajectories need a little endian machine");
+  }
+}
+
+// values in the layout of the machine, which is little endian
+template <typename T> void put(char *&bytes, T value) {
+  std::memcpy(bytes, &value, sizeof(T));
+  bytes += sizeof(T);
+}
+
+template <typename T> T get(char const *&bytes) {
+  T value;
+  std::memcpy(&value, bytes, sizeof(T));
+  bytes += sizeof(T);
+  return value;
+}
+
+// bytes of the ids of a frame, padded so that the boids stay aligned
+std::size_t id_bytes(std::size_t count) {
+  return (count * sizeof(std::uint32_t) + 7) / 8 * 8;
+}
+
+bool read_exactly(std::istream &input, char *data, std::size_t size) {
+  input.read(data, static_cast<std::streamsize>(size));
+  return static_cast<std::size_t>(input.gcount()) == size;
+}
+} // namespace
+
+region::region(double left, double bottom, double right, double top)
+    : vertices_{{left, bottom}, {right, bottom}, {right, top}, {left, top}},
+      lower_{left, bottom}, upper_{right, top}, rectangle_{true} {
+  if (!(left < right) || !(bottom < top) || !std::isfinite(right - left) ||
+      !std::isfinite(top - bottom)) {
+    throw std::runtime_error("ERROR: Invalid rectangular region");
+  }
+}
+
+region::region(std::vector<math::R2> const &vertices)
+    : vertices_{vertices}, rectangle_{false} {
+  if (vertices.size() < 3) {
+    throw std::runtime_error("ERROR: A polygon needs at least three vertices");
+  }
+  lower_ = upper_ = vertices.front();
+  for (auto const &vertex : vertices) {
+    if (!std::isfinite(vertex.x) || !std::isfinite(vertex.y)) {
+      throw std::runtime_error("ERROR: Invalid vertex of a polygon");
+    }
+    lower_ = {std::min(lower_.x, vertex.x), std::min(lower_.y, vertex.y)};
+    upper_ = {std::max(upper_.x, vertex.x), std::max(upper_.y, vertex.y)};
+  }
+}
+
+bool region::contains(math::R2 const &point) const {
+  if (!(point.x >= lower_.x && point.x <= upper_.x && point.y >= lower_.y &&
+        point.y <= upper_.y)) {
+    return false;
+  }
+  if (rectangle_) {
+    return true;
+  }
+  // a ray from the point to the right crosses the border an odd number of
+  // times from the inside
+  bool inside{false};
+  for (std::size_t i{}, j{vertices_.size() - 1}; i != vertices_.size();
+       j = i++) {
+    math::R2 const &a = vertices_[i];
+    math::R2 const &b = vertices_[j];
+    if ((a.y > point.y) != (b.y > point.y) &&
+        point.x < a.x + (b.x - a.x) * (point.y - a.y) / (b.y - a.y)) {
+      inside = !inside;
+    }
+  }
+  return inside;
+}
+
+bool region::rectangle() const { return rectangle_; }
+std::vector<math::R2> const &region::vertices() const { return vertices_; }
+math::R2 region::lower() const { return lower_; }
+math::R2 region::upper() const { return upper_; }
+
+region parse_region(std::string const &text) {
+  std::vector<double> values;
+  std::istringstream stream{text};
+  std::string value;
+  while (std::getline(stream, value, ',')) {
+    std::size_t parsed{};
+    try {
+      values.push_back(std::stod(value, &parsed));
+    } catch (std::exception const &) {
+      parsed = 0;
+    }
+    if (parsed == 0 || value.find_first_not_of(" ", parsed) !=
+                           std::string::npos) {
+      throw std::runtime_error("ERROR: Invalid region " + text);
+    }
+  }
+  if (values.size() == 4) {
+    return region{values[0], values[1], values[2], values[3]};
+  }
+  if (values.size() < 6 || values.size() % 2 != 0) {
+    throw std::runtime_error("ERROR: Invalid region " + text);
+  }
+  std::vector<math::R2> vertices;
+  for (std::size_t i{}; i != values.size(); i += 2) {
+    vertices.emplace_back(values[i], values[i + 1]);
+  }
+  return region{vertices};
+}
+
+void select_region(region const &selection,
+                   std::vector<dynamics::Boid> const &flock,
+                   dynamics::running_parameters const &parameters,
+                   std::vector<std::uint32_t> &ids,
+                   std::vector<dynamics::Boid> &selected) {
+  ids.clear();
+  selected.clear();
+  if (flock.empty()) {
+    return;
+  }
+  // about a boid per cell, so the query looks at few boids out of the region
+  double const area = (parameters.right_bound - parameters.left_bound) *
+                      (parameters.upper_bound - parameters.bottom_bound);
+  dynamics::cell_list const cells{
+      flock, std::sqrt(area / static_cast<double>(flock.size())), parameters};
+  cells.for_each_in_box(selection.lower(), selection.upper(),
+                        [&](std::size_t i, math::R2 const &position) {
+                          if (selection.contains(position)) {
+                            ids.push_back(static_cast<std::uint32_t>(i));
+                          }
+                        });
+  // the cell list visits the boids by cell
+  std::sort(ids.begin(), ids.end());
+  for (std::uint32_t id : ids) {
+    selected.push_back(flock[id]);
+  }
+}
+
+region_writer::region_writer(std::ostream &output, region const &selection,
+                             std::size_t boids,
+                             dynamics::running_parameters const &parameters)
+    : output_{output}, region_{selection}, parameters_{parameters},
+      boids_{boids}, frames_{0}, bytes_{0} {
+  check_little_endian();
+  if (boids > max_boids) {
+    throw std::runtime_error("ERROR: Too many boids for a region trajectory");
+  }
+  std::vector<char> header(header_bytes +
+                           2 * sizeof(double) * selection.vertices().size());
+  char *bytes = header.data();
+  std::memcpy(bytes, magic, sizeof(magic));
+  bytes += sizeof(magic);
+  put<std::uint32_t>(bytes, region_version);
+  put<std::uint32_t>(bytes, selection.rectangle());
+  put<std::uint64_t>(bytes, boids);
+  put<std::uint64_t>(bytes, selection.vertices().size());
+  put<std::int64_t>(bytes, parameters.boids_number);
+  for (double value :
+       {parameters.s, parameters.a, parameters.c, parameters.d_s, parameters.d,
+        parameters.left_bound, parameters.right_bound, parameters.upper_bound,
+        parameters.bottom_bound, parameters.maximum_velocity,
+        parameters.minimum_velocity}) {
+    put(bytes, value);
+  }
+  for (auto const &vertex : selection.vertices()) {
+    put(bytes, vertex.x);
+    put(bytes, vertex.y);
+  }
+  output_.write(header.data(), static_cast<std::streamsize>(header.size()));
+  if (!output_) {
+    throw std::runtime_error("ERROR: Failed to write region trajectory");
+  }
+  bytes_ = header.size();
+  // one more id for the padding
+  ids_.reserve(boids + 1);
+  selected_.reserve(boids);
+}
+
+void region_writer::append(std::uint64_t step, double time,
+                           std::vector<dynamics::Boid> const &flock) {
+  if (flock.size() != boids_) {
+    throw std::runtime_error("ERROR: Every frame of a trajectory must have " +
+                             std::to_string(boids_) + " boids");
+  }
+  select_region(region_, flock, parameters_, ids_, selected_);
+  std::size_t const count = ids_.size();
+  char frame_header[frame_header_bytes];
+  char *bytes = frame_header;
+  put<std::uint64_t>(bytes, step);
+  put(bytes, time);
+  put<std::uint64_t>(bytes, count);
+  // the padding of the ids is zeroed
+  ids_.resize(id_bytes(count) / sizeof(std::uint32_t), 0);
+  output_.write(frame_header, sizeof(frame_header));
+  output_.write(reinterpret_cast<char const *>(ids_.data()),
+                static_cast<std::streamsize>(id_bytes(count)));
+  output_.write(reinterpret_cast<char const *>(selected_.data()),
+                static_cast<std::streamsize>(count * sizeof(dynamics::Boid)));
+  if (!output_) {
+    throw std::runtime_error("ERROR: Failed to write region trajectory");
+  }
+  bytes_ += sizeof(frame_header) + id_bytes(count) +
+            count * sizeof(dynamics::Boid);
+  ++frames_;
+}
+
+std::uint64_t region_writer::frames() const { return frames_; }
+std::uint64_t region_writer::bytes() const { return bytes_; }
+
+region_reader::region_reader(std::istream &input)
+    : input_{input}, boids_{0}, parameters_{}, rectangle_{false} {
+  check_little_endian();
+  char header[header_bytes];
+  if (!read_exactly(input_, header, sizeof(header)) ||
+      !std::equal(magic, magic + sizeof(magic), header)) {
+    throw std::runtime_error("ERROR: Not a region trajectory");
+  }
+  char const *bytes = header + sizeof(magic);
+  std::uint32_t const version = get<std::uint32_t>(bytes);
+  if (version == 0 || version > region_version) {
+    throw std::runtime_error("ERROR: Unsupported region trajectory version " +
+                             std::to_string(version));
+  }
+  std::uint32_t const rectangle = get<std::uint32_t>(bytes);
+  std::uint64_t const boids = get<std::uint64_t>(bytes);
+  std::uint64_t const vertices = get<std::uint64_t>(bytes);
+  parameters_.boids_number = static_cast<int>(get<std::int64_t>(bytes));
+  for (double *value :
+       {&parameters_.s, &parameters_.a, &parameters_.c, &parameters_.d_s,
+        &parameters_.d, &parameters_.left_bound, &parameters_.right_bound,
+        &parameters_.upper_bound, &parameters_.bottom_bound,
+        &parameters_.maximum_velocity, &parameters_.minimum_velocity}) {
+    *value = get<double>(bytes);
+  }
+  if (rectangle > 1 || boids > max_boids || vertices < 3 ||
+      vertices > max_vertices || (rectangle == 1 && vertices != 4)) {
+    throw std::runtime_error("ERROR: Corrupted region trajectory");
+  }
+  std::vector<char> coordinates(2 * sizeof(double) * vertices);
+  if (!read_exactly(input_, coordinates.data(), coordinates.size())) {
+    throw std::runtime_error("ERROR: Truncated region trajectory");
+  }
+  bytes = coordinates.data();
+  for (std::uint64_t vertex{}; vertex != vertices; ++vertex) {
+    double const x = get<double>(bytes);
+    vertices_.emplace_back(x, get<double>(bytes));
+  }
+  boids_ = boids;
+  rectangle_ = rectangle == 1;
+  // a region that can't be built is a corrupted header too
+  try {
+    selection();
+  } catch (std::runtime_error const &) {
+    throw std::runtime_error("ERROR: Corrupted region trajectory");
+  }
+}
+
+bool region_reader::next(region_frame &frame) {
+  char frame_header[frame_header_bytes];
+  input_.read(frame_header, sizeof(frame_header));
+  if (input_.gcount() == 0 && input_.eof()) {
+    return false;
+  }
+  if (static_cast<std::size_t>(input_.gcount()) != sizeof(frame_header)) {
+    throw std::runtime_error("ERROR: Truncated region trajectory");
+  }
+  char const *bytes = frame_header;
+  frame.step = get<std::uint64_t>(bytes);
+  frame.time = get<double>(bytes);
+  std::uint64_t const count = get<std::uint64_t>(bytes);
+  if (count > boids_) {
+    throw std::runtime_error("ERROR: Corrupted region trajectory");
+  }
+  frame.ids.resize(id_bytes(count) / sizeof(std::uint32_t));
+  frame.flock.assign(count, dynamics::Boid{0., 0., 0., 0.});
+  if (!read_exactly(input_, reinterpret_cast<char *>(frame.ids.data()),
+                    id_bytes(count)) ||
+      !read_exactly(input_, reinterpret_cast<char *>(frame.flock.data()),
+                    count * sizeof(dynamics::Boid))) {
+    throw std::runtime_error("ERROR: Truncated region trajectory");
+  }
+  frame.ids.resize(count);
+  // the ids grow and index the flock
+  for (std::size_t i{}; i != count; ++i) {
+    if (frame.ids[i] >= boids_ || (i != 0 && frame.ids[i] <= frame.ids[i - 1])) {
+      throw std::runtime_error("ERROR: Corrupted region trajectory");
+    }
+  }
+  return true;
+}
+
+std::size_t region_reader::boids() const { return boids_; }
+dynamics::running_parameters const &region_reader::parameters() const {
+  return parameters_;
+}
+
+region region_reader::selection() const {
+  if (rectangle_) {
+    return region{vertices_[0].x, vertices_[0].y, vertices_[2].x,
+                  vertices_[2].y};
+  }
+  return region{vertices_};
+}
+} // namespace io
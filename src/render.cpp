@@ -1,9 +1,19 @@
 #include "../include/render.hpp"
+#include "../include/codec.hpp"
+#include "../include/numpy.hpp"
+#include "../include/recorder.hpp"
+#include "../include/replay.hpp"
+#include "../include/statistics_worker.hpp"
+#include "../include/time_series.hpp"
+#include "../include/trajectory.hpp"
 
 #include <SFML/Graphics.hpp>
 #include <SFML/Window.hpp>
 
+#include <chrono>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
 
 namespace view {
 // Function to create parameters for the simulation
@@ -75,9 +85,10 @@ dynamics::running_parameters create_parameters() {
                                       cohesion};
 }
 
-void render_boids(std::vector<dynamics::Boid> const &flock,
-                  dynamics::running_parameters const &parameters,
-                  sf::RenderWindow &simulation_window) {
+namespace {
+void draw_boids(std::vector<dynamics::Boid> const &flock,
+                dynamics::running_parameters const &parameters,
+                sf::RenderWindow &simulation_window) {
   // calculation of the scales necessary to render the boids on screen
   auto const x_scale = (.75 * sf::VideoMode::getDesktopMode().width) /
                        (parameters.right_bound - parameters.left_bound);
@@ -86,64 +97,79 @@ void render_boids(std::vector<dynamics::Boid> const &flock,
 
   sf::CircleShape boid_shape{2.0f, 5};
   boid_shape.setFillColor(sf::Color(sf::Color::White));
-  // The simulation_window with the objects of the previous frame is cleared and
-  // filled with our
-  simulation_window.clear(sf::Color(sf::Color::Black));
   // Every dynamics::Boid inside flock gets assigned a boids sf::CircleShape
   // that are drawn at an equivalent position as their BOid
   std::for_each(flock.begin(), flock.end(), [&](auto &b_i) {
     boid_shape.setPosition(b_i.r().x * x_scale, b_i.r().y * y_scale);
     simulation_window.draw(boid_shape);
   });
-  // The simulation_window with every object is displayed
-  simulation_window.display();
 }
 
-// Function to build data structure from the flock
-data build_data(std::vector<dynamics::Boid> const &flock) {
-  double mean_distance{view::calculate_mean_distance(flock)};
-  double sigma_mean_distance{
-      view::calculate_standard_deviation_distance(flock, mean_distance)};
-  double mean_velocity{view::calculate_mean_velocity(flock)};
-  double sigma_mean_velocity{
-      view::calculate_standard_deviation_velocity(flock, mean_velocity)};
-  data built{mean_distance, sigma_mean_distance, mean_velocity,
-             sigma_mean_velocity};
-  return built;
+// every cell is a quad whose red intensity is its density relative to the
+// densest cell
+void draw_density(density_field const &heatmap,
+                  dynamics::running_parameters const &parameters,
+                  sf::RenderWindow &simulation_window) {
+  auto const x_scale = (.75 * sf::VideoMode::getDesktopMode().width) /
+                       (parameters.right_bound - parameters.left_bound);
+  auto const y_scale = (.75 * sf::VideoMode::getDesktopMode().height) /
+                       (parameters.upper_bound - parameters.bottom_bound);
+  float const width = static_cast<float>(heatmap.cell_width() * x_scale);
+  float const height = static_cast<float>(heatmap.cell_height() * y_scale);
+  double const maximum = heatmap.maximum_count();
+  if (maximum <= 0.) {
+    return;
+  }
+  sf::VertexArray quads(sf::Quads, 4 * heatmap.columns() * heatmap.rows());
+  std::size_t vertex{};
+  for (std::size_t row{}; row != heatmap.rows(); ++row) {
+    for (std::size_t column{}; column != heatmap.columns(); ++column) {
+      auto const intensity =
+          static_cast<sf::Uint8>(255. * heatmap.count(column, row) / maximum);
+      sf::Color const color{intensity, 0, 0};
+      float const x = column * width;
+      float const y = row * height;
+      quads[vertex++] = sf::Vertex{{x, y}, color};
+      quads[vertex++] = sf::Vertex{{x + width, y}, color};
+      quads[vertex++] = sf::Vertex{{x + width, y + height}, color};
+      quads[vertex++] = sf::Vertex{{x, y + height}, color};
+    }
+  }
+  simulation_window.draw(quads);
+}
+} // namespace
+
+void render_boids(std::vector<dynamics::Boid> const &flock,
+                  dynamics::running_parameters const &parameters,
+                  sf::RenderWindow &simulation_window) {
+  // The simulation_window with the objects of the previous frame is cleared and
+  // filled with our
+  simulation_window.clear(sf::Color(sf::Color::Black));
+  draw_boids(flock, parameters, simulation_window);
+  // The simulation_window with every object is displayed
+  simulation_window.display();
 }
 
-// Function to convert data to a formatted string
-std::string
-print_data_to_string(data const &to_be_printed,
-                     dynamics::running_parameters const &parameters) {
-  std::string to_be_returned{""};
-  to_be_returned += "Mean Distance:  ";
-  to_be_returned += std::to_string(to_be_printed.mean_distance);
-  std::string plus_minus{"  +/-  "};
-  to_be_returned += plus_minus;
-  to_be_returned += std::to_string(to_be_printed.sigma_mean_distance);
-  to_be_returned += "\nMean Velocity:   ";
-  to_be_returned += std::to_string(to_be_printed.mean_velocity);
-  to_be_returned += plus_minus;
-  to_be_returned += std::to_string(to_be_printed.sigma_mean_velocity);
-  to_be_returned += "\nBoids Number:   ";
-  to_be_returned += std::to_string(parameters.boids_number);
-  to_be_returned += "\nSeparation Parameter:   ";
-  to_be_returned += std::to_string(parameters.s);
-  to_be_returned += "\nAlignement Parameter:   ";
-  to_be_returned += std::to_string(parameters.a);
-  to_be_returned += "\nCohesion Parameter:   ";
-  to_be_returned += std::to_string(parameters.c);
-  return to_be_returned;
+void render_boids(std::vector<dynamics::Boid> const &flock,
+                  dynamics::running_parameters const &parameters,
+                  sf::RenderWindow &simulation_window,
+                  density_field const &heatmap) {
+  simulation_window.clear(sf::Color(sf::Color::Black));
+  // the boids are drawn over the heatmap
+  draw_density(heatmap, parameters, simulation_window);
+  draw_boids(flock, parameters, simulation_window);
+  simulation_window.display();
 }
 
 // function to display the data window
-void render_data(std::vector<dynamics::Boid> const &flock,
+// the statistics are computed elsewhere, so drawing them is cheap
+void render_data(data const &to_be_rendered, window_summary const &history,
                  sf::RenderWindow &data_window, sf::Font const &font,
                  dynamics::running_parameters const &parameters) {
   sf::Text text;
   text.setFont(font);
-  text.setString(print_data_to_string(build_data(flock), parameters));
+  text.setString(print_data_to_string(to_be_rendered, parameters) + "\n\n" +
+                 print_window_to_string(history));
   text.setCharacterSize(24);
   text.setFillColor(sf::Color::White);
   text.setPosition(0, 0);
@@ -154,13 +180,19 @@ void render_data(std::vector<dynamics::Boid> const &flock,
 
 void run_simulation(std::vector<dynamics::Boid> &flock,
                     dynamics::running_parameters const &parameters) {
+  run_simulation(flock, parameters, simulation_options{});
+}
+
+void run_simulation(std::vector<dynamics::Boid> &flock,
+                    dynamics::running_parameters const &parameters,
+                    simulation_options const &options) {
   // let's build a simulation_window 3/4 of our desktop
   unsigned const display_width = .75 * sf::VideoMode::getDesktopMode().width;
   unsigned const display_height = .75 * sf::VideoMode::getDesktopMode().height;
   sf::RenderWindow simulation_window(
       sf::VideoMode(display_width, display_height), "Boids Simulation");
   sf::RenderWindow data_window(
-      sf::VideoMode(.33 * display_width, 0.22 * display_height),
+      sf::VideoMode(.33 * display_width, 0.6 * display_height),
       "Data Display");
   simulation_window.setPosition({0, 50});
   data_window.setPosition({static_cast<int>(display_width), 50});
@@ -174,6 +206,81 @@ void run_simulation(std::vector<dynamics::Boid> &flock,
   if (!font.loadFromFile("utils/arial.ttf")) {
     throw std::runtime_error("ERROR: Failed to load  files");
   }
+  // the statistics are computed off the frame loop
+  statistics_worker statistics{statistics_options_for(parameters)};
+  // every step is recorded with its timing, its order parameters and the
+  // latest statistics of the worker, a minute at 60 frames per second, the
+  // window covers the last second
+  time_series history{3600, 60};
+  std::optional<data> current;
+  unsigned long recorded{};
+  std::uint64_t statistics_step{options.first_step};
+  std::uint64_t step{options.first_step};
+  double simulated_time{options.start_time};
+  // the checkpoints hold everything needed to resume the run, they are
+  // written while the simulation goes on
+  io::snapshot_saver saver{options.io_backend};
+  auto const checkpoint = [&]() {
+    if (!options.checkpoint.empty()) {
+      saver.save(options.checkpoint,
+                 {step, simulated_time, parameters, options.engine, flock});
+    }
+  };
+  auto last_checkpoint = std::chrono::steady_clock::now();
+  std::unique_ptr<io::trajectory_writer> trajectory;
+  if (!options.trajectory.empty()) {
+    trajectory = std::make_unique<io::trajectory_writer>(
+        options.trajectory, flock.size(), parameters);
+  }
+  std::unique_ptr<io::async_file_writer> compressed_output;
+  std::unique_ptr<io::trajectory_encoder> compressed;
+  if (!options.compressed_trajectory.empty()) {
+    compressed_output = std::make_unique<io::async_file_writer>(
+        options.compressed_trajectory, options.io_backend);
+    compressed = std::make_unique<io::trajectory_encoder>(
+        compressed_output->stream(), flock.size(), parameters);
+  }
+  std::unique_ptr<io::async_file_writer> region_output;
+  std::unique_ptr<io::region_writer> region_recording;
+  if (!options.region_trajectory.empty() && options.region) {
+    region_output = std::make_unique<io::async_file_writer>(
+        options.region_trajectory, options.io_backend);
+    region_recording = std::make_unique<io::region_writer>(
+        region_output->stream(), *options.region, flock.size(), parameters);
+  }
+  // the recordings are written by background threads, the recorders are
+  // declared after the files so that they are stopped before them
+  std::vector<std::unique_ptr<io::recorder>> recorders;
+  if (trajectory) {
+    recorders.push_back(std::make_unique<io::recorder>(
+        [&trajectory](std::uint64_t frame_step, double time,
+                      std::vector<dynamics::Boid> const &frame) {
+          trajectory->append(frame_step, time, frame);
+        },
+        flock.size(), 8, options.record_policy));
+  }
+  if (compressed) {
+    recorders.push_back(std::make_unique<io::recorder>(
+        [&compressed](std::uint64_t frame_step, double time,
+                      std::vector<dynamics::Boid> const &frame) {
+          compressed->append(frame_step, time, frame);
+        },
+        flock.size(), 8, options.record_policy));
+  }
+  // the boids inside the region are selected by the thread of the recorder
+  if (region_recording) {
+    recorders.push_back(std::make_unique<io::recorder>(
+        [&region_recording](std::uint64_t frame_step, double time,
+                            std::vector<dynamics::Boid> const &frame) {
+          region_recording->append(frame_step, time, frame);
+        },
+        flock.size(), 8, options.record_policy));
+  }
+  // the heatmap is toggled with the H key, the field is averaged over about
+  // ten frames and smoothed on the scale of the neighborhood. The N key dumps
+  // the flock to boids-<step>.npy
+  density_field density{64, 36, parameters};
+  bool show_heatmap{false};
   // render of the starting conditions
   render_boids(flock, parameters, simulation_window);
   // Game loop, while both windows are open the simulation is rendered
@@ -184,6 +291,20 @@ void run_simulation(std::vector<dynamics::Boid> &flock,
         simulation_window.close();
         data_window.close();
       }
+      if (event.type == sf::Event::KeyPressed &&
+          event.key.code == sf::Keyboard::H) {
+        show_heatmap = !show_heatmap;
+      }
+      if (event.type == sf::Event::KeyPressed &&
+          event.key.code == sf::Keyboard::N) {
+        // a failed export is reported, the simulation and its recordings
+        // go on
+        try {
+          io::save_npy("boids-" + std::to_string(step) + ".npy", flock);
+        } catch (std::runtime_error const &error) {
+          std::cerr << error.what() << '\n';
+        }
+      }
     }
     while (data_window.pollEvent(event)) {
       if (event.type == sf::Event::Closed) {
@@ -194,15 +315,151 @@ void run_simulation(std::vector<dynamics::Boid> &flock,
     // let's measure the elapsed time in a frame and convert it in a double
     sf::Time frame_time = frame_clock.restart();
     double frame_time_double = static_cast<double>(frame_time.asSeconds());
-    dynamics::evolve_flock(flock, frame_time_double, parameters);
-    render_boids(flock, parameters, simulation_window);
+    // the order parameters come with the evolution of the flock, so they are
+    // always those of the displayed frame
+    dynamics::order_parameters order{};
+    auto const evolution_start = std::chrono::steady_clock::now();
+    dynamics::evolve_flock(flock, frame_time_double, parameters, order);
+    std::chrono::duration<double> const evolution_time =
+        std::chrono::steady_clock::now() - evolution_start;
+    simulated_time += frame_time_double;
+    unsigned long const completed = statistics.completed();
+    if (completed != recorded) {
+      recorded = completed;
+      current = statistics.latest();
+      statistics_step = step;
+    }
+    data sampled = current.value_or(data{});
+    sampled.polarization = order.polarization;
+    sampled.milling = order.milling;
+    if (current) {
+      current = sampled;
+    }
+    history.push({step, simulated_time, evolution_time.count(),
+                  statistics_step, sampled});
+    ++step;
+    for (auto &recording : recorders) {
+      recording->record(step, simulated_time, flock);
+    }
+    if (show_heatmap) {
+      density.update(flock, .9);
+      render_boids(flock, parameters, simulation_window,
+                   density.smoothed(parameters.d / 2.));
+    } else {
+      render_boids(flock, parameters, simulation_window);
+    }
 
-    // every two seconds the data are updated for half a second
+    // every two seconds the data are updated for a second, the statistics
+    // of the submitted snapshots are computed by the worker thread and the
+    // most recent completed result is displayed
     sf::Time data_time = data_clock.getElapsedTime();
     int integer_data_time = static_cast<int>(data_time.asSeconds());
     if (integer_data_time % 2 == 0) {
-      render_data(flock, data_window, font, parameters);
+      statistics.submit(flock, order);
+      if (current) {
+        render_data(*current, history.window(), data_window, font, parameters);
+      }
+    }
+
+    std::chrono::duration<double> const since_checkpoint =
+        std::chrono::steady_clock::now() - last_checkpoint;
+    if (since_checkpoint.count() >= options.checkpoint_interval) {
+      checkpoint();
+      last_checkpoint = std::chrono::steady_clock::now();
+    }
+  }
+  // the last state is kept when the windows are closed
+  checkpoint();
+  saver.finish();
+  for (auto &recording : recorders) {
+    recording->close();
+    io::recorder_statistics const recorded = recording->statistics();
+    if (recorded.dropped != 0) {
+      std::cout << "Recording dropped " << recorded.dropped << " of "
+                << recorded.offered << " frames\n";
+    }
+  }
+  if (compressed_output) {
+    compressed_output->close();
+  }
+  if (region_output) {
+    region_output->close();
+  }
+}
+
+void run_replay(std::string const &path) {
+  io::trajectory_reader const reader{path};
+  if (reader.frames() == 0) {
+    throw std::runtime_error("ERROR: " + path + " has no frames");
+  }
+  dynamics::running_parameters const &parameters = reader.parameters();
+  std::uint64_t const last_frame = reader.frames() - 1;
+  unsigned const display_width = .75 * sf::VideoMode::getDesktopMode().width;
+  unsigned const display_height = .75 * sf::VideoMode::getDesktopMode().height;
+  sf::RenderWindow replay_window(sf::VideoMode(display_width, display_height),
+                                 "Boids Replay");
+  replay_window.setPosition({0, 50});
+  replay_window.setVerticalSyncEnabled(true);
+
+  // Space pauses, R reverses, Up and Down double and halve the speed, Left
+  // and Right move by a frame when paused and by a second otherwise, N dumps
+  // the frame shown to boids-<step>.npy
+  playback player{reader.frame(0).time(), reader.frame(last_frame).time()};
+  player.paused(false);
+  replay_prefetcher prefetcher{reader};
+  sf::Clock frame_clock;
+  std::uint64_t shown{};
+  while (replay_window.isOpen()) {
+    sf::Event event;
+    while (replay_window.pollEvent(event)) {
+      if (event.type == sf::Event::Closed) {
+        replay_window.close();
+      }
+      if (event.type != sf::Event::KeyPressed) {
+        continue;
+      }
+      switch (event.key.code) {
+      case sf::Keyboard::Space:
+        player.paused(!player.paused());
+        break;
+      case sf::Keyboard::R:
+        player.speed(-player.speed());
+        break;
+      case sf::Keyboard::Up:
+        player.speed(2. * player.speed());
+        break;
+      case sf::Keyboard::Down:
+        player.speed(player.speed() / 2.);
+        break;
+      case sf::Keyboard::Left:
+        player.seek(player.paused() && shown != 0
+                        ? reader.frame(shown - 1).time()
+                        : player.time() - 1.);
+        break;
+      case sf::Keyboard::Right:
+        player.seek(player.paused() && shown != last_frame
+                        ? reader.frame(shown + 1).time()
+                        : player.time() + 1.);
+        break;
+      case sf::Keyboard::N:
+        // a failed export is reported, the replay goes on
+        try {
+          io::save_npy("boids-" +
+                           std::to_string(reader.frame(shown).step()) + ".npy",
+                       reader.frame(shown));
+        } catch (std::runtime_error const &error) {
+          std::cerr << error.what() << '\n';
+        }
+        break;
+      default:
+        break;
+      }
     }
+    player.advance(frame_clock.restart().asSeconds());
+    // the frame shown is the first one recorded at or after the playhead
+    shown = std::min(reader.find_time(player.time()), last_frame);
+    prefetcher.follow(shown, player.speed() >= 0.);
+    render_boids(reader.frame(shown).flock(), parameters, replay_window);
   }
 }
-} // namespace view
\ No newline at end of file
+} // namespace view
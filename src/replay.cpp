@@ -0,0 +1,105 @@
+#include "../include/replay.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace view {
+playback::playback(double first_time, double last_time)
+    : first_{first_time}, last_{last_time}, time_{first_time}, speed_{1.},
+      paused_{true} {
+  if (!(last_time >= first_time)) {
+    throw std::runtime_error("ERROR: Invalid time range of a replay");
+  }
+}
+
+void playback::advance(double wall_seconds) {
+  if (paused_) {
+    return;
+  }
+  time_ += speed_ * wall_seconds;
+  if (time_ <= first_ || time_ >= last_) {
+    time_ = std::clamp(time_, first_, last_);
+    paused_ = true;
+  }
+}
+
+void playback::seek(double time) { time_ = std::clamp(time, first_, last_); }
+double playback::time() const { return time_; }
+double playback::speed() const { return speed_; }
+void playback::speed(double new_speed) { speed_ = new_speed; }
+bool playback::paused() const { return paused_; }
+void playback::paused(bool new_paused) { paused_ = new_paused; }
+
+replay_prefetcher::replay_prefetcher(io::trajectory_reader const &reader,
+                                     std::uint64_t ahead)
+    : reader_{reader}, ahead_{ahead}, playhead_{0}, forward_{true},
+      moved_{false}, stopping_{false}, prefetched_{0},
+      thread_{&replay_prefetcher::work, this} {}
+
+replay_prefetcher::~replay_prefetcher() {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stopping_ = true;
+  }
+  wake_up_.notify_one();
+  thread_.join();
+}
+
+void replay_prefetcher::follow(std::uint64_t frame, bool forward) {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (frame == playhead_ && forward == forward_) {
+      return;
+    }
+    playhead_ = frame;
+    forward_ = forward;
+    moved_ = true;
+  }
+  wake_up_.notify_one();
+}
+
+std::uint64_t replay_prefetcher::prefetched() {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return prefetched_;
+}
+
+void replay_prefetcher::work() {
+  // frames [ready_first, ready_last) were prefetched last time, a playhead
+  // moving inside them only needs the frames past their end
+  std::uint64_t ready_first{0};
+  std::uint64_t ready_last{0};
+  std::uint64_t const frames = reader_.frames();
+  std::unique_lock<std::mutex> lock{mutex_};
+  // the frames at the beginning are prefetched before the first follow
+  moved_ = true;
+  while (true) {
+    wake_up_.wait(lock, [this] { return moved_ || stopping_; });
+    if (stopping_) {
+      return;
+    }
+    moved_ = false;
+    std::uint64_t const playhead = std::min(playhead_, frames);
+    std::uint64_t const target_first =
+        forward_ ? playhead : playhead - std::min(playhead, ahead_);
+    std::uint64_t const target_last =
+        std::min(frames, forward_ ? playhead + ahead_ : playhead + 1);
+    std::uint64_t first = target_first;
+    std::uint64_t last = target_last;
+    if (first >= ready_first && first < ready_last) {
+      first = ready_last;
+    }
+    if (last > ready_first && last <= ready_last) {
+      last = ready_first;
+    }
+    if (first < last) {
+      // follow doesn't wait for the disk
+      lock.unlock();
+      reader_.prefetch(first, last);
+      lock.lock();
+      prefetched_ += last - first;
+    }
+    ready_first = target_first;
+    ready_last = target_last;
+  }
+}
+} // namespace view
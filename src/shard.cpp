@@ -0,0 +1,363 @@
+#include "../include/shard.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace dynamics {
+namespace {
+// the shared memory is used by different processes, so its atomics must not
+// rely on hidden locks
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+              "process shared atomics must be lock free");
+static_assert(std::atomic<unsigned>::is_always_lock_free,
+              "process shared atomics must be lock free");
+
+// A boid as it travels through the rings, migrants change owner while ghosts
+// are only used as neighbors by the receiving shard
+struct boid_record {
+  double r_x;
+  double r_y;
+  double v_x;
+  double v_y;
+  std::uint64_t is_migrant;
+};
+
+// Single producer single consumer ring, head and tail are kept on different
+// cache lines since they are written by different processes
+struct ring_header {
+  alignas(64) std::atomic<std::uint64_t> head;
+  alignas(64) std::atomic<std::uint64_t> tail;
+};
+
+// Header of the shared memory, it contains the lockstep barrier
+struct shared_header {
+  alignas(64) std::atomic<unsigned> arrived;
+  alignas(64) std::atomic<unsigned> generation;
+  std::atomic<unsigned> aborted;
+  unsigned shards;
+  std::uint64_t capacity;
+};
+
+// The ring from shard i to shard j is the ring i * shards + j, the ring from a
+// shard to itself is used to send the evolved boids back to the launcher
+class shared_memory {
+private:
+  void *address_;
+  std::size_t size_;
+  std::size_t ring_size_;
+
+  // rounded up so that every ring header stays aligned
+  static std::size_t ring_size(std::uint64_t capacity) {
+    std::size_t const size =
+        sizeof(ring_header) + capacity * sizeof(boid_record);
+    std::size_t const alignment = alignof(ring_header);
+    return (size + alignment - 1) / alignment * alignment;
+  }
+
+public:
+  shared_memory(unsigned shards, std::uint64_t capacity)
+      : address_{nullptr},
+        size_{sizeof(shared_header) +
+              shards * shards * ring_size(capacity)},
+        ring_size_{ring_size(capacity)} {
+    static std::atomic<unsigned> counter{0};
+    std::string const name = "/boids-" + std::to_string(getpid()) + "-" +
+                             std::to_string(counter++);
+    int const fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd == -1) {
+      throw std::runtime_error("ERROR: Failed to create shared memory " +
+                               name);
+    }
+    // the name is removed immediately, the forked processes inherit the
+    // mapping and the memory is released when the last of them unmaps it
+    shm_unlink(name.c_str());
+    if (ftruncate(fd, static_cast<off_t>(size_)) == -1) {
+      close(fd);
+      throw std::runtime_error("ERROR: Failed to size shared memory " + name);
+    }
+    address_ =
+        mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (address_ == MAP_FAILED) {
+      throw std::runtime_error("ERROR: Failed to map shared memory " + name);
+    }
+    auto header = new (address_) shared_header;
+    header->arrived = 0;
+    header->generation = 0;
+    header->aborted = 0;
+    header->shards = shards;
+    header->capacity = capacity;
+    for (unsigned i{}; i != shards * shards; ++i) {
+      auto ring = new (static_cast<char *>(address_) + sizeof(shared_header) +
+                       i * ring_size_) ring_header;
+      ring->head = 0;
+      ring->tail = 0;
+    }
+  }
+  shared_memory(shared_memory const &) = delete;
+  shared_memory &operator=(shared_memory const &) = delete;
+  ~shared_memory() { munmap(address_, size_); }
+
+  shared_header &header() { return *static_cast<shared_header *>(address_); }
+
+  ring_header &ring(unsigned from, unsigned to) {
+    return *reinterpret_cast<ring_header *>(
+        static_cast<char *>(address_) + sizeof(shared_header) +
+        (from * header().shards + to) * ring_size_);
+  }
+
+  boid_record *slots(ring_header &ring) {
+    return reinterpret_cast<boid_record *>(reinterpret_cast<char *>(&ring) +
+                                           sizeof(ring_header));
+  }
+
+  // returns false if the ring is full
+  bool push(unsigned from, unsigned to, boid_record const &record) {
+    ring_header &r = ring(from, to);
+    std::uint64_t const tail = r.tail.load(std::memory_order_relaxed);
+    if (tail - r.head.load(std::memory_order_acquire) ==
+        header().capacity) {
+      return false;
+    }
+    slots(r)[tail % header().capacity] = record;
+    r.tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // returns false if the ring is empty
+  bool pop(unsigned from, unsigned to, boid_record &record) {
+    ring_header &r = ring(from, to);
+    std::uint64_t const head = r.head.load(std::memory_order_relaxed);
+    if (head == r.tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    record = slots(r)[head % header().capacity];
+    r.head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Sense reversing barrier, the last process to arrive starts a new
+  // generation, returns false if the run was aborted while waiting
+  bool arrive_and_wait() {
+    shared_header &h = header();
+    unsigned const generation = h.generation.load(std::memory_order_acquire);
+    if (h.arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == h.shards) {
+      h.arrived.store(0, std::memory_order_relaxed);
+      h.generation.fetch_add(1, std::memory_order_release);
+      return true;
+    }
+    while (h.generation.load(std::memory_order_acquire) == generation) {
+      if (h.aborted.load(std::memory_order_acquire) != 0) {
+        return false;
+      }
+      std::this_thread::yield();
+    }
+    return h.aborted.load(std::memory_order_acquire) == 0;
+  }
+};
+
+// horizontal distance of a point from a strip, 0 if the point is inside it
+double distance_from_shard(double x, int shard,
+                           running_parameters const &parameters, int shards) {
+  double const width = (parameters.right_bound - parameters.left_bound) / shards;
+  double const left = parameters.left_bound + shard * width;
+  return std::max({left - x, x - (left + width), 0.});
+}
+
+boid_record to_record(Boid const &boid, bool is_migrant) {
+  return {boid.r().x, boid.r().y, boid.v().x, boid.v().y,
+          is_migrant ? 1u : 0u};
+}
+
+// Body of a shard process, returns the exit status of the process
+int run_shard(shared_memory &memory, int shard, std::vector<Boid> held,
+              running_parameters const &parameters,
+              shard_options const &options) {
+  int const shards = options.shards;
+  // ghosts must cover both the neighborhood and the separation distance
+  double const halo = std::max(parameters.d, parameters.d_s);
+  std::vector<Boid> owned;
+  std::vector<Boid> local;
+  owned.reserve(held.size());
+
+  for (int step{}; step != options.steps; ++step) {
+    // Every held boid goes to its owner, and as a ghost to every other strip
+    // closer than the halo. Distances are not toroidal in the simulation, so
+    // ghosts never wrap around the borders
+    owned.clear();
+    for (Boid const &boid : held) {
+      int const owner = find_shard(boid.r(), parameters, shards);
+      if (owner == shard) {
+        owned.push_back(boid);
+      } else if (!memory.push(shard, owner, to_record(boid, true))) {
+        return 2;
+      }
+      for (int other{}; other != shards; ++other) {
+        if (other != owner &&
+            distance_from_shard(boid.r().x, other, parameters, shards) <
+                halo) {
+          if (other == shard) {
+            local.push_back(boid);
+          } else if (!memory.push(shard, other, to_record(boid, false))) {
+            return 2;
+          }
+        }
+      }
+    }
+    if (!memory.arrive_and_wait()) {
+      return 3;
+    }
+
+    // own ghosts (boids leaving this strip) are already in local
+    boid_record record{};
+    std::vector<Boid> ghosts;
+    ghosts.swap(local);
+    for (int other{}; other != shards; ++other) {
+      if (other == shard) {
+        continue;
+      }
+      while (memory.pop(other, shard, record)) {
+        Boid boid{record.r_x, record.r_y, record.v_x, record.v_y};
+        if (record.is_migrant != 0) {
+          owned.push_back(boid);
+        } else {
+          ghosts.push_back(boid);
+        }
+      }
+    }
+    // nobody may push the next step before every shard emptied its rings
+    if (!memory.arrive_and_wait()) {
+      return 3;
+    }
+
+    local.clear();
+    local.insert(local.end(), owned.begin(), owned.end());
+    local.insert(local.end(), ghosts.begin(), ghosts.end());
+    held.clear();
+    for (Boid boid_to_evolve : owned) {
+      held.push_back(evolve_boid(
+          get_neighborhood(local, boid_to_evolve, parameters.d),
+          boid_to_evolve, options.delta_t, parameters));
+    }
+    local.clear();
+  }
+
+  // the evolved boids are handed back to the launcher
+  for (Boid const &boid : held) {
+    if (!memory.push(shard, shard, to_record(boid, true))) {
+      return 2;
+    }
+  }
+  return 0;
+}
+
+std::uint64_t default_capacity(std::size_t boids) {
+  std::uint64_t capacity{1};
+  while (capacity < boids) {
+    capacity *= 2;
+  }
+  return capacity;
+}
+} // namespace
+
+int find_shard(math::R2 const &r, running_parameters const &parameters,
+               int shards) {
+  double const width = (parameters.right_bound - parameters.left_bound) / shards;
+  int const shard =
+      static_cast<int>(std::floor((r.x - parameters.left_bound) / width));
+  return std::clamp(shard, 0, shards - 1);
+}
+
+std::vector<Boid> run_sharded(std::vector<Boid> const &flock,
+                              running_parameters const &parameters,
+                              shard_options const &options) {
+  if (options.shards < 1 || options.steps < 0) {
+    throw std::runtime_error("ERROR: Invalid shard options");
+  }
+  unsigned const shards = options.shards;
+  std::uint64_t const capacity = options.ring_capacity == 0
+                                     ? default_capacity(flock.size())
+                                     : options.ring_capacity;
+  shared_memory memory{shards, capacity};
+
+  std::vector<pid_t> children;
+  for (unsigned shard{}; shard != shards; ++shard) {
+    pid_t const pid = fork();
+    if (pid == -1) {
+      memory.header().aborted = 1;
+      break;
+    }
+    if (pid == 0) {
+      // the child takes the boids of its strip from the copy of the flock
+      std::vector<Boid> held;
+      std::copy_if(flock.begin(), flock.end(), std::back_inserter(held),
+                   [&](Boid const &boid) {
+                     return find_shard(boid.r(), parameters, shards) ==
+                            static_cast<int>(shard);
+                   });
+      int status{1};
+      try {
+        status = run_shard(memory, shard, std::move(held), parameters,
+                           options);
+      } catch (...) {
+        status = 1;
+      }
+      if (status != 0) {
+        memory.header().aborted = 1;
+      }
+      // _exit skips the destructors and atexit handlers of the parent copy
+      _exit(status);
+    }
+    children.push_back(pid);
+  }
+
+  // a failing shard aborts the others, which would wait forever at the
+  // barrier otherwise, so the children are polled instead of waited in order
+  bool failed = children.size() != shards;
+  std::vector<pid_t> running = children;
+  while (!running.empty()) {
+    auto exited = std::remove_if(running.begin(), running.end(), [&](pid_t pid) {
+      int status{};
+      pid_t const result = waitpid(pid, &status, WNOHANG);
+      if (result == 0) {
+        return false;
+      }
+      if (result == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        failed = true;
+        memory.header().aborted = 1;
+      }
+      return true;
+    });
+    if (exited == running.end()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    running.erase(exited, running.end());
+  }
+  if (failed) {
+    throw std::runtime_error("ERROR: A shard of the simulation failed");
+  }
+
+  std::vector<Boid> evolved_flock;
+  evolved_flock.reserve(flock.size());
+  boid_record record{};
+  for (unsigned shard{}; shard != shards; ++shard) {
+    while (memory.pop(shard, shard, record)) {
+      evolved_flock.emplace_back(record.r_x, record.r_y, record.v_x,
+                                 record.v_y);
+    }
+  }
+  return evolved_flock;
+}
+} // namespace dynamics
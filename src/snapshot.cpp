@@ -0,0 +1,392 @@
+#include "../include/snapshot.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace io {
+namespace {
+static_assert(std::numeric_limits<double>::is_iec559,
+              "snapshots store IEEE 754 doubles");
+
+constexpr char magic[8] = {'B', 'O', 'I', 'D', 'S', 'N', 'A', 'P'};
+// boids converted at once, so that a corrupted count can't make the reader
+// allocate more than the data actually in the stream
+constexpr std::uint64_t boids_per_chunk{65536};
+constexpr std::size_t boid_bytes{4 * sizeof(double)};
+// buffers of the asynchronous saves, a save waits for the disk only when the
+// snapshot is larger than all of them
+constexpr std::size_t save_buffer_bytes{std::size_t{1} << 20};
+constexpr std::size_t max_save_buffers{64};
+
+bool little_endian_host() {
+  std::uint16_t const probe{1};
+  unsigned char first{};
+  std::memcpy(&first, &probe, 1);
+  return first == 1;
+}
+
+// FNV-1a, enough to detect truncated or damaged files
+class hasher {
+private:
+  std::uint64_t hash_{0xcbf29ce484222325ULL};
+
+public:
+  void add(char const *bytes, std::size_t size) {
+    for (std::size_t i{}; i != size; ++i) {
+      hash_ ^= static_cast<unsigned char>(bytes[i]);
+      hash_ *= 0x100000001b3ULL;
+    }
+  }
+  std::uint64_t hash() const { return hash_; }
+};
+
+void encode_u64(std::uint64_t value, char *bytes) {
+  for (int i{}; i != 8; ++i) {
+    bytes[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+  }
+}
+
+std::uint64_t decode_u64(char const *bytes) {
+  std::uint64_t value{};
+  for (int i{}; i != 8; ++i) {
+    value |= static_cast<std::uint64_t>(static_cast<unsigned char>(bytes[i]))
+             << (8 * i);
+  }
+  return value;
+}
+
+// doubles go through their bit pattern
+void encode_f64(double value, char *bytes) {
+  std::uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  encode_u64(bits, bytes);
+}
+
+double decode_f64(char const *bytes) {
+  std::uint64_t const bits = decode_u64(bytes);
+  double value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// the four doubles of every boid, on little endian machines they are copied
+// as they are
+void encode_boids(std::vector<double> const &values, char *bytes) {
+  if (little_endian_host()) {
+    std::memcpy(bytes, values.data(), values.size() * sizeof(double));
+    return;
+  }
+  for (std::size_t i{}; i != values.size(); ++i) {
+    encode_f64(values[i], bytes + i * sizeof(double));
+  }
+}
+
+void decode_boids(char const *bytes, std::vector<double> &values) {
+  if (little_endian_host()) {
+    std::memcpy(values.data(), bytes, values.size() * sizeof(double));
+    return;
+  }
+  for (std::size_t i{}; i != values.size(); ++i) {
+    values[i] = decode_f64(bytes + i * sizeof(double));
+  }
+}
+
+// Writes the fields to the stream hashing them on the way
+class writer {
+private:
+  std::ostream &output_;
+  hasher hash_;
+
+public:
+  explicit writer(std::ostream &output) : output_{output} {}
+  void bytes(char const *data, std::size_t size) {
+    hash_.add(data, size);
+    output_.write(data, static_cast<std::streamsize>(size));
+  }
+  void u32(std::uint32_t value) {
+    char buffer[8];
+    encode_u64(value, buffer);
+    bytes(buffer, 4);
+  }
+  void u64(std::uint64_t value) {
+    char buffer[8];
+    encode_u64(value, buffer);
+    bytes(buffer, 8);
+  }
+  void f64(double value) {
+    char buffer[8];
+    encode_f64(value, buffer);
+    bytes(buffer, 8);
+  }
+  std::uint64_t hash() const { return hash_.hash(); }
+};
+
+// Reads the fields from the stream hashing them on the way, a short read
+// means a truncated snapshot
+class reader {
+private:
+  std::istream &input_;
+  hasher hash_;
+
+public:
+  explicit reader(std::istream &input) : input_{input} {}
+  void bytes(char *data, std::size_t size) {
+    input_.read(data, static_cast<std::streamsize>(size));
+    if (static_cast<std::size_t>(input_.gcount()) != size) {
+      throw std::runtime_error("ERROR: Truncated snapshot");
+    }
+    hash_.add(data, size);
+  }
+  std::uint32_t u32() {
+    char buffer[8]{};
+    bytes(buffer, 4);
+    return static_cast<std::uint32_t>(decode_u64(buffer));
+  }
+  std::uint64_t u64() {
+    char buffer[8];
+    bytes(buffer, 8);
+    return decode_u64(buffer);
+  }
+  double f64() {
+    char buffer[8];
+    bytes(buffer, 8);
+    return decode_f64(buffer);
+  }
+  std::uint64_t hash() const { return hash_.hash(); }
+};
+
+// writes the cached data of a file or directory to the disk, false on failure
+bool sync_path(std::string const &path, int flags) {
+  int const fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC | flags);
+  if (fd < 0) {
+    return false;
+  }
+  bool const synced = ::fsync(fd) == 0;
+  ::close(fd);
+  return synced;
+}
+
+// Renames the complete temporary file over path. The file is synced first,
+// otherwise a crash could leave the rename on the disk but not the data, and
+// the directory after, so that the rename itself is on the disk. The
+// temporary file is removed on failure
+void replace_file(std::string const &temporary, std::string const &path) {
+  if (!sync_path(temporary, 0)) {
+    std::remove(temporary.c_str());
+    throw std::runtime_error("ERROR: Failed to write " + temporary);
+  }
+  if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+    std::remove(temporary.c_str());
+    throw std::runtime_error("ERROR: Failed to replace " + path);
+  }
+  std::size_t const slash = path.find_last_of('/');
+  std::string const directory = slash == std::string::npos ? "."
+                                : slash == 0              ? "/"
+                                                          : path.substr(0, slash);
+  if (!sync_path(directory, O_DIRECTORY)) {
+    throw std::runtime_error("ERROR: Failed to sync " + directory);
+  }
+}
+} // namespace
+
+void write_snapshot(std::ostream &output, snapshot const &to_be_written) {
+  writer out{output};
+  out.bytes(magic, sizeof(magic));
+  out.u32(snapshot_version);
+  out.u32(0);
+  out.u64(to_be_written.step);
+  out.f64(to_be_written.time);
+
+  dynamics::running_parameters const &parameters = to_be_written.parameters;
+  out.u64(static_cast<std::uint64_t>(
+      static_cast<std::int64_t>(parameters.boids_number)));
+  for (double value :
+       {parameters.s, parameters.a, parameters.c, parameters.d_s, parameters.d,
+        parameters.left_bound, parameters.right_bound, parameters.upper_bound,
+        parameters.bottom_bound, parameters.maximum_velocity,
+        parameters.minimum_velocity}) {
+    out.f64(value);
+  }
+
+  // the standard text representation of the engine state is portable
+  std::ostringstream engine;
+  engine << to_be_written.engine;
+  std::string const state = engine.str();
+  out.u64(state.size());
+  out.bytes(state.data(), state.size());
+
+  std::vector<dynamics::Boid> const &flock = to_be_written.flock;
+  out.u64(flock.size());
+  std::vector<double> values;
+  std::vector<char> buffer;
+  for (std::size_t first{}; first < flock.size(); first += boids_per_chunk) {
+    std::size_t const last =
+        std::min<std::size_t>(flock.size(), first + boids_per_chunk);
+    values.resize(4 * (last - first));
+    for (std::size_t i{first}; i != last; ++i) {
+      double *boid = values.data() + 4 * (i - first);
+      boid[0] = flock[i].r().x;
+      boid[1] = flock[i].r().y;
+      boid[2] = flock[i].v().x;
+      boid[3] = flock[i].v().y;
+    }
+    buffer.resize(values.size() * sizeof(double));
+    encode_boids(values, buffer.data());
+    out.bytes(buffer.data(), buffer.size());
+  }
+
+  char hash[8];
+  encode_u64(out.hash(), hash);
+  output.write(hash, sizeof(hash));
+  if (!output) {
+    throw std::runtime_error("ERROR: Failed to write snapshot");
+  }
+}
+
+snapshot read_snapshot(std::istream &input) {
+  reader in{input};
+  char header[sizeof(magic)];
+  in.bytes(header, sizeof(header));
+  if (!std::equal(header, header + sizeof(header), magic)) {
+    throw std::runtime_error("ERROR: Not a boids snapshot");
+  }
+  std::uint32_t const version = in.u32();
+  if (version == 0 || version > snapshot_version) {
+    throw std::runtime_error("ERROR: Unsupported snapshot version " +
+                             std::to_string(version));
+  }
+  in.u32();
+
+  snapshot read{};
+  read.step = in.u64();
+  read.time = in.f64();
+  dynamics::running_parameters &parameters = read.parameters;
+  parameters.boids_number =
+      static_cast<int>(static_cast<std::int64_t>(in.u64()));
+  for (double *value :
+       {&parameters.s, &parameters.a, &parameters.c, &parameters.d_s,
+        &parameters.d, &parameters.left_bound, &parameters.right_bound,
+        &parameters.upper_bound, &parameters.bottom_bound,
+        &parameters.maximum_velocity, &parameters.minimum_velocity}) {
+    *value = in.f64();
+  }
+
+  // the state of a mt19937_64 is a few kilobytes of text
+  std::uint64_t const state_size = in.u64();
+  if (state_size > (1u << 16)) {
+    throw std::runtime_error("ERROR: Corrupted snapshot");
+  }
+  std::string state(state_size, '\0');
+  in.bytes(&state[0], state.size());
+
+  std::uint64_t const boids = in.u64();
+  std::vector<double> values;
+  std::vector<char> buffer;
+  for (std::uint64_t first{}; first < boids; first += boids_per_chunk) {
+    std::uint64_t const last = std::min(boids, first + boids_per_chunk);
+    buffer.resize((last - first) * boid_bytes);
+    in.bytes(buffer.data(), buffer.size());
+    values.resize(4 * (last - first));
+    decode_boids(buffer.data(), values);
+    for (std::size_t k{}; k != values.size(); k += 4) {
+      read.flock.emplace_back(values[k], values[k + 1], values[k + 2],
+                              values[k + 3]);
+    }
+  }
+
+  std::uint64_t const expected = in.hash();
+  if (in.u64() != expected) {
+    throw std::runtime_error("ERROR: Corrupted snapshot");
+  }
+  std::istringstream engine{state};
+  engine >> read.engine;
+  if (engine.fail()) {
+    throw std::runtime_error("ERROR: Corrupted snapshot");
+  }
+  return read;
+}
+
+void save_snapshot(std::string const &path, snapshot const &to_be_saved) {
+  std::string const temporary = path + ".tmp";
+  {
+    std::ofstream output{temporary, std::ios::binary | std::ios::trunc};
+    if (!output) {
+      throw std::runtime_error("ERROR: Failed to open " + temporary);
+    }
+    write_snapshot(output, to_be_saved);
+    output.close();
+    if (!output) {
+      throw std::runtime_error("ERROR: Failed to write " + temporary);
+    }
+  }
+  replace_file(temporary, path);
+}
+
+snapshot load_snapshot(std::string const &path) {
+  std::ifstream input{path, std::ios::binary};
+  if (!input) {
+    throw std::runtime_error("ERROR: Failed to open " + path);
+  }
+  return read_snapshot(input);
+}
+
+snapshot_saver::snapshot_saver(io_backend backend)
+    : backend_{backend}, pending_{false} {}
+
+snapshot_saver::~snapshot_saver() {
+  try {
+    finish();
+  } catch (...) {
+    // a destructor can't report the failure, the previous checkpoint is
+    // still in place
+  }
+}
+
+void snapshot_saver::save(std::string const &path,
+                          snapshot const &to_be_saved) {
+  finish();
+  std::string const temporary = path + ".tmp";
+  if (writer_) {
+    writer_->reopen(temporary);
+  } else {
+    // the buffers fit the first snapshot, the state of the engine takes a
+    // few kilobytes. The flock of a run keeps its size, so they fit the next
+    // ones too
+    std::size_t const bytes =
+        (std::size_t{1} << 14) + to_be_saved.flock.size() * boid_bytes;
+    std::size_t const buffers =
+        std::min(max_save_buffers, bytes / save_buffer_bytes + 1);
+    writer_ = std::make_unique<async_file_writer>(temporary, backend_, buffers,
+                                                  save_buffer_bytes);
+  }
+  path_ = path;
+  pending_ = true;
+  write_snapshot(writer_->stream(), to_be_saved);
+  writer_->submit();
+}
+
+void snapshot_saver::finish() {
+  if (!pending_) {
+    return;
+  }
+  pending_ = false;
+  std::string const temporary = path_ + ".tmp";
+  try {
+    writer_->flush();
+  } catch (...) {
+    std::remove(temporary.c_str());
+    throw;
+  }
+  replace_file(temporary, path_);
+}
+} // namespace io
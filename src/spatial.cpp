@@ -0,0 +1,90 @@
+#include "../include/spatial.hpp"
+
+#include <stdexcept>
+
+namespace dynamics {
+namespace {
+// more cells than boids only cost memory and empty visits
+constexpr double cells_per_boid{4.};
+
+// number of cells at least cell_size wide in an extent
+int count_cells(double extent, double cell_size) {
+  return std::max(1, static_cast<int>(std::floor(extent / cell_size)));
+}
+} // namespace
+
+cell_list::cell_list(std::vector<Boid> const &flock, double cell_size,
+                     running_parameters const &parameters, bool periodic)
+    : left_{parameters.left_bound}, bottom_{parameters.bottom_bound},
+      width_{parameters.right_bound - parameters.left_bound},
+      height_{parameters.upper_bound - parameters.bottom_bound},
+      periodic_{periodic} {
+  if (!(cell_size > 0.) || !(width_ > 0.) || !(height_ > 0.)) {
+    throw std::runtime_error("ERROR: Invalid cell size or bounds");
+  }
+  columns_ = count_cells(width_, cell_size);
+  rows_ = count_cells(height_, cell_size);
+  // for a small radius the grid is coarsened, the visits of the neighbors
+  // only depend on the radius
+  double const limit =
+      cells_per_boid * std::max<double>(1., static_cast<double>(flock.size()));
+  double const cells = static_cast<double>(columns_) * rows_;
+  if (cells > limit) {
+    double const factor = std::sqrt(cells / limit);
+    columns_ = std::max(1, static_cast<int>(columns_ / factor));
+    rows_ = std::max(1, static_cast<int>(rows_ / factor));
+  }
+  cell_width_ = width_ / columns_;
+  cell_height_ = height_ / rows_;
+
+  // counting sort of the boids by cell
+  std::size_t const total = static_cast<std::size_t>(columns_) * rows_;
+  std::vector<std::size_t> cell_of_boid(flock.size());
+  cell_start_.assign(total + 1, 0);
+  for (std::size_t i{}; i != flock.size(); ++i) {
+    cell_of_boid[i] = static_cast<std::size_t>(row(flock[i].r().y)) * columns_ +
+                      column(flock[i].r().x);
+    ++cell_start_[cell_of_boid[i] + 1];
+  }
+  for (std::size_t cell{}; cell != total; ++cell) {
+    cell_start_[cell + 1] += cell_start_[cell];
+  }
+  std::vector<std::size_t> next(cell_start_.begin(), cell_start_.end() - 1);
+  indices_.resize(flock.size());
+  x_.resize(flock.size());
+  y_.resize(flock.size());
+  for (std::size_t i{}; i != flock.size(); ++i) {
+    std::size_t const k = next[cell_of_boid[i]]++;
+    indices_[k] = i;
+    x_[k] = flock[i].r().x;
+    y_[k] = flock[i].r().y;
+  }
+}
+
+// boids out of the bounds belong to the border cells, the clamp is done
+// before the conversion so that far away points don't overflow it
+int cell_list::column(double x) const {
+  return static_cast<int>(std::clamp(std::floor((x - left_) / cell_width_), 0.,
+                                     columns_ - 1.));
+}
+
+int cell_list::row(double y) const {
+  return static_cast<int>(std::clamp(std::floor((y - bottom_) / cell_height_),
+                                     0., rows_ - 1.));
+}
+
+std::size_t cell_list::size() const { return indices_.size(); }
+int cell_list::columns() const { return columns_; }
+int cell_list::rows() const { return rows_; }
+bool cell_list::periodic() const { return periodic_; }
+std::size_t cell_list::cell_start(std::size_t cell) const {
+  return cell_start_[cell];
+}
+std::size_t cell_list::index(std::size_t k) const { return indices_[k]; }
+math::R2 cell_list::position(std::size_t k) const { return {x_[k], y_[k]}; }
+
+math::R2 cell_list::displacement(math::R2 const &from,
+                                 math::R2 const &to) const {
+  return {wrap(to.x - from.x, width_), wrap(to.y - from.y, height_)};
+}
+} // namespace dynamics
@@ -0,0 +1,219 @@
+#include "../include/statistics.hpp"
+#include "../include/parallel.hpp"
+#include "../include/spatial.hpp"
+#include "../include/welford.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace view {
+// Estimate the distances between couples of boids from random samples
+distance_estimate estimate_distances(std::vector<dynamics::Boid> const &flock,
+                                     std::size_t samples,
+                                     std::mt19937_64 &engine) {
+  std::size_t const n = flock.size();
+  assert(n > 1 && samples > 1);
+  std::uniform_int_distribution<std::size_t> first_index(0, n - 1);
+  // the second boid is drawn among the other n - 1 ones
+  std::uniform_int_distribution<std::size_t> second_index(0, n - 2);
+  math::welford distances;
+  for (std::size_t sample{}; sample != samples; ++sample) {
+    std::size_t const i = first_index(engine);
+    std::size_t j = second_index(engine);
+    if (j >= i) {
+      ++j;
+    }
+    distances.add(dynamics::calculate_distance(flock[i], flock[j]));
+  }
+  // 1.96 is the 97.5% quantile of the normal distribution
+  return {distances.mean(), distances.sigma(),
+          1.96 * distances.sigma() / std::sqrt(distances.count()), samples};
+}
+
+// Nearest neighbor distances found with a cell list of about one boid per
+// cell, the search radius is doubled until a neighbor is found
+nearest_neighbor_data
+calculate_nearest_neighbors(std::vector<dynamics::Boid> const &flock,
+                            std::size_t bins, double bin_width) {
+  if (!(bin_width > 0.)) {
+    throw std::runtime_error("ERROR: The bins must have a positive width");
+  }
+  nearest_neighbor_data nearest{0., 0., bin_width,
+                                std::vector<std::size_t>(bins), 0};
+  std::size_t const n = flock.size();
+  if (n < 2) {
+    return nearest;
+  }
+  // the flock may leave the bounds of the simulation, so the grid covers the
+  // bounding box of the flock, at least a unit wide
+  dynamics::running_parameters box{};
+  auto const [left, right] = std::minmax_element(
+      flock.begin(), flock.end(), [](dynamics::Boid const &lhs,
+                                     dynamics::Boid const &rhs) {
+        return lhs.r().x < rhs.r().x;
+      });
+  auto const [bottom, top] = std::minmax_element(
+      flock.begin(), flock.end(), [](dynamics::Boid const &lhs,
+                                     dynamics::Boid const &rhs) {
+        return lhs.r().y < rhs.r().y;
+      });
+  box.left_bound = left->r().x;
+  box.right_bound = std::max(right->r().x, box.left_bound + 1.);
+  box.bottom_bound = bottom->r().y;
+  box.upper_bound = std::max(top->r().y, box.bottom_bound + 1.);
+  double const width = box.right_bound - box.left_bound;
+  double const height = box.upper_bound - box.bottom_bound;
+  double const diagonal = std::sqrt(width * width + height * height);
+  double const cell_size = std::sqrt(width * height / n);
+  dynamics::cell_list const cells{flock, cell_size, box};
+
+  std::vector<double> distances(n);
+  parallel::parallel_for(n, [&](std::size_t i) {
+    double nearest_squared = std::numeric_limits<double>::infinity();
+    for (double radius{cell_size}; std::isinf(nearest_squared);
+         radius *= 2.) {
+      // past the diagonal every boid has been looked at
+      double const search = std::min(radius, diagonal * 1.001);
+      cells.for_each_neighbor(flock[i].r(), search,
+                              [&](std::size_t j, math::R2 const &d) {
+                                if (j != i) {
+                                  nearest_squared =
+                                      std::min(nearest_squared, d * d);
+                                }
+                              });
+    }
+    distances[i] = std::sqrt(nearest_squared);
+  });
+
+  math::welford const statistics = parallel::deterministic_sum<math::welford>(
+      n, [&](std::size_t i) { return math::welford{distances[i]}; });
+  nearest.mean = statistics.mean();
+  nearest.sigma = statistics.sigma();
+  for (double distance : distances) {
+    std::size_t const bin = static_cast<std::size_t>(distance / bin_width);
+    if (bin < bins) {
+      ++nearest.histogram[bin];
+    } else {
+      ++nearest.overflow;
+    }
+  }
+  return nearest;
+}
+
+statistics_options
+statistics_options_for(dynamics::running_parameters const &parameters) {
+  statistics_options options{};
+  options.nearest_bin_width = parameters.d / nearest_bins;
+  return options;
+}
+
+// Function to build data structure from the flock
+data build_data(std::vector<dynamics::Boid> const &flock) {
+  return build_data(flock, statistics_options{});
+}
+
+data build_data(std::vector<dynamics::Boid> const &flock,
+                statistics_options const &options) {
+  return build_data(flock, dynamics::calculate_order_parameters(flock),
+                    options);
+}
+
+data build_data(std::vector<dynamics::Boid> const &flock,
+                dynamics::order_parameters const &order,
+                statistics_options const &options) {
+  // a single pass over the flock gives mean and standard deviation of the
+  // speeds, the partial results of the threads are merged in a fixed order
+  math::welford const velocities = parallel::deterministic_sum<math::welford>(
+      flock.size(), [&](std::size_t i) {
+        return math::welford{math::calculate_norm(flock[i].v())};
+      });
+  data built{0., 0., velocities.mean(), velocities.sigma()};
+  // large flocks have too many couples to enumerate them
+  if (flock.size() > options.exact_limit) {
+    std::mt19937_64 engine{options.seed};
+    distance_estimate const estimate =
+        estimate_distances(flock, options.samples, engine);
+    built.mean_distance = estimate.mean;
+    built.sigma_mean_distance = estimate.sigma;
+    built.confidence_mean_distance = estimate.confidence;
+  } else {
+    // and a single sweep over the couples gives the ones of the distances
+    math::welford const distances = calculate_distance_statistics(flock);
+    built.mean_distance = distances.mean();
+    built.sigma_mean_distance = distances.sigma();
+  }
+  built.polarization = order.polarization;
+  built.milling = order.milling;
+  nearest_neighbor_data const nearest = calculate_nearest_neighbors(
+      flock, nearest_bins, options.nearest_bin_width);
+  built.mean_nearest_distance = nearest.mean;
+  built.sigma_nearest_distance = nearest.sigma;
+  built.nearest_bin_width = nearest.bin_width;
+  if (flock.size() > 1) {
+    for (std::size_t bin{}; bin != nearest_bins; ++bin) {
+      built.nearest_histogram[bin] =
+          static_cast<double>(nearest.histogram[bin]) / flock.size();
+    }
+  }
+  return built;
+}
+
+// Function to convert data to a formatted string
+std::string
+print_data_to_string(data const &to_be_printed,
+                     dynamics::running_parameters const &parameters) {
+  std::string to_be_returned{""};
+  to_be_returned += "Mean Distance:  ";
+  to_be_returned += std::to_string(to_be_printed.mean_distance);
+  std::string plus_minus{"  +/-  "};
+  to_be_returned += plus_minus;
+  to_be_returned += std::to_string(to_be_printed.sigma_mean_distance);
+  // estimated distances come with their confidence interval
+  if (to_be_printed.confidence_mean_distance > 0.) {
+    to_be_returned += "  (95% CI +/- ";
+    to_be_returned += std::to_string(to_be_printed.confidence_mean_distance);
+    to_be_returned += ")";
+  }
+  to_be_returned += "\nNearest Neighbor Distance:   ";
+  to_be_returned += std::to_string(to_be_printed.mean_nearest_distance);
+  to_be_returned += plus_minus;
+  to_be_returned += std::to_string(to_be_printed.sigma_nearest_distance);
+  // a character per bin, darker for the bins holding more boids
+  if (to_be_printed.nearest_bin_width > 0.) {
+    std::string const shades{" .:-=+*#%@"};
+    double const fullest =
+        *std::max_element(to_be_printed.nearest_histogram.begin(),
+                          to_be_printed.nearest_histogram.end());
+    to_be_returned += "\nNearest Neighbor Histogram:   [";
+    for (double fraction : to_be_printed.nearest_histogram) {
+      std::size_t const shade =
+          fullest > 0. ? static_cast<std::size_t>(
+                             fraction / fullest * (shades.size() - 1) + .5)
+                       : 0;
+      to_be_returned += shades[shade];
+    }
+    to_be_returned += "]  bins of ";
+    to_be_returned += std::to_string(to_be_printed.nearest_bin_width);
+  }
+  to_be_returned += "\nMean Velocity:   ";
+  to_be_returned += std::to_string(to_be_printed.mean_velocity);
+  to_be_returned += plus_minus;
+  to_be_returned += std::to_string(to_be_printed.sigma_mean_velocity);
+  to_be_returned += "\nPolarization:   ";
+  to_be_returned += std::to_string(to_be_printed.polarization);
+  to_be_returned += "\nMilling:   ";
+  to_be_returned += std::to_string(to_be_printed.milling);
+  to_be_returned += "\nBoids Number:   ";
+  to_be_returned += std::to_string(parameters.boids_number);
+  to_be_returned += "\nSeparation Parameter:   ";
+  to_be_returned += std::to_string(parameters.s);
+  to_be_returned += "\nAlignement Parameter:   ";
+  to_be_returned += std::to_string(parameters.a);
+  to_be_returned += "\nCohesion Parameter:   ";
+  to_be_returned += std::to_string(parameters.c);
+  return to_be_returned;
+}
+} // namespace view
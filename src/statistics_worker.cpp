@@ -0,0 +1,60 @@
+#include "../include/statistics_worker.hpp"
+
+namespace view {
+statistics_worker::statistics_worker(statistics_options const &options)
+    : options_{options}, pending_order_{0., 0.}, has_pending_{false}, stopping_{false},
+      completed_{0},
+      thread_{&statistics_worker::work, this} {}
+
+statistics_worker::~statistics_worker() {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stopping_ = true;
+  }
+  wake_up_.notify_one();
+  thread_.join();
+}
+
+void statistics_worker::submit(std::vector<dynamics::Boid> const &flock,
+                               dynamics::order_parameters const &order) {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    // the capacity of pending_ is reused across submissions
+    pending_.assign(flock.begin(), flock.end());
+    pending_order_ = order;
+    has_pending_ = true;
+  }
+  wake_up_.notify_one();
+}
+
+std::optional<data> statistics_worker::latest() {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return latest_;
+}
+
+unsigned long statistics_worker::completed() {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return completed_;
+}
+
+void statistics_worker::work() {
+  std::vector<dynamics::Boid> snapshot;
+  std::unique_lock<std::mutex> lock{mutex_};
+  while (true) {
+    wake_up_.wait(lock, [this] { return has_pending_ || stopping_; });
+    if (stopping_) {
+      return;
+    }
+    snapshot.swap(pending_);
+    dynamics::order_parameters const order = pending_order_;
+    has_pending_ = false;
+    // the statistics are computed without holding the lock, so submit and
+    // latest never wait for them
+    lock.unlock();
+    data const built = build_data(snapshot, order, options_);
+    lock.lock();
+    latest_ = built;
+    ++completed_;
+  }
+}
+} // namespace view
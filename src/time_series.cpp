@@ -0,0 +1,199 @@
+#include "../include/time_series.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+namespace view {
+namespace {
+static_assert(std::is_trivially_copyable<sample>::value &&
+                  sizeof(sample) % sizeof(std::uint64_t) == 0,
+              "a sample must be made of whole words");
+static_assert(std::is_trivially_copyable<window_summary>::value &&
+                  sizeof(window_summary) % sizeof(std::uint64_t) == 0,
+              "a window summary must be made of whole words");
+
+// every field of data is followed in the window, data is made of doubles
+// only, so they are read and written as an array
+constexpr std::size_t field_count{sizeof(data) / sizeof(double)};
+static_assert(std::is_trivially_copyable<data>::value &&
+                  sizeof(data) == field_count * sizeof(double),
+              "data must be made of doubles only");
+
+std::array<double, field_count> fields(data const &statistics) {
+  std::array<double, field_count> values;
+  std::memcpy(values.data(), &statistics, sizeof(data));
+  return values;
+}
+
+data from_fields(std::array<double, field_count> const &values) {
+  data statistics;
+  std::memcpy(static_cast<void *>(&statistics), values.data(), sizeof(data));
+  return statistics;
+}
+
+// the words are copied relaxed, the fences order them with the sequence
+template <typename T, std::size_t Words>
+void write_words(std::array<std::atomic<std::uint64_t>, Words> &words,
+                 T const &value) {
+  std::uint64_t buffer[Words];
+  std::memcpy(buffer, &value, sizeof(T));
+  for (std::size_t w{}; w != Words; ++w) {
+    words[w].store(buffer[w], std::memory_order_relaxed);
+  }
+}
+
+template <typename T, std::size_t Words>
+T read_words(std::array<std::atomic<std::uint64_t>, Words> const &words) {
+  std::uint64_t buffer[Words];
+  for (std::size_t w{}; w != Words; ++w) {
+    buffer[w] = words[w].load(std::memory_order_relaxed);
+  }
+  T value;
+  std::memcpy(&value, buffer, sizeof(T));
+  return value;
+}
+
+// writer side of a sequence lock, sequence must be even
+template <typename T, typename Slot>
+void publish(Slot &slot, std::uint64_t sequence, T const &value) {
+  slot.sequence.store(sequence - 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  write_words(slot.words, value);
+  slot.sequence.store(sequence, std::memory_order_release);
+}
+
+// reader side, false if the slot did not hold sequence for the whole copy
+template <typename T, typename Slot>
+bool try_read(Slot const &slot, std::uint64_t sequence, T &value) {
+  if (slot.sequence.load(std::memory_order_acquire) != sequence) {
+    return false;
+  }
+  value = read_words<T>(slot.words);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return slot.sequence.load(std::memory_order_relaxed) == sequence;
+}
+} // namespace
+
+time_series::time_series(std::size_t capacity, std::size_t window)
+    : capacity_{capacity}, window_{window}, slots_(capacity), pushed_{0},
+      accumulators_(field_count + 1) {
+  if (capacity == 0 || window == 0 || window > capacity) {
+    throw std::runtime_error("ERROR: Invalid time series capacity or window");
+  }
+}
+
+void time_series::push(sample const &to_be_pushed) {
+  std::uint64_t const index = pushed_.load(std::memory_order_relaxed);
+  auto const add = [&](sample const &added) {
+    accumulators_[0].add(added.step_seconds);
+    auto const values = fields(added.statistics);
+    for (std::size_t f{}; f != field_count; ++f) {
+      accumulators_[f + 1].add(values[f]);
+    }
+  };
+  // the sample leaving the window is still in the buffer, since the window
+  // is not longer than the buffer, and only this thread writes it
+  if (index >= window_) {
+    auto const leaving = read_words<sample>(
+        slots_[(index - window_) % capacity_].words);
+    accumulators_[0].remove(leaving.step_seconds);
+    auto const values = fields(leaving.statistics);
+    for (std::size_t f{}; f != field_count; ++f) {
+      accumulators_[f + 1].remove(values[f]);
+    }
+  }
+  add(to_be_pushed);
+  publish(slots_[index % capacity_], 2 * index + 2, to_be_pushed);
+
+  // the removals accumulate rounding errors, so once every window the
+  // accumulators are rebuilt from the samples in it
+  if ((index + 1) % window_ == 0) {
+    std::fill(accumulators_.begin(), accumulators_.end(), math::welford{});
+    for (std::uint64_t k{index + 1 - window_}; k != index + 1; ++k) {
+      add(read_words<sample>(slots_[k % capacity_].words));
+    }
+  }
+
+  window_summary summary{};
+  summary.samples = static_cast<std::uint64_t>(accumulators_[0].count());
+  summary.mean_step_seconds = accumulators_[0].mean();
+  summary.sigma_step_seconds = accumulators_[0].sigma();
+  summary.statistics_step = to_be_pushed.statistics_step;
+  std::array<double, field_count> mean;
+  std::array<double, field_count> sigma;
+  for (std::size_t f{}; f != field_count; ++f) {
+    mean[f] = accumulators_[f + 1].mean();
+    sigma[f] = accumulators_[f + 1].sigma();
+  }
+  summary.mean = from_fields(mean);
+  summary.sigma = from_fields(sigma);
+  publish(summary_, 2 * index + 2, summary);
+  pushed_.store(index + 1, std::memory_order_release);
+}
+
+std::vector<sample> time_series::snapshot() const {
+  std::uint64_t const pushed = pushed_.load(std::memory_order_acquire);
+  std::uint64_t const first = pushed > capacity_ ? pushed - capacity_ : 0;
+  std::vector<sample> samples;
+  samples.reserve(pushed - first);
+  for (std::uint64_t k{first}; k != pushed; ++k) {
+    sample copy;
+    if (try_read(slots_[k % capacity_], 2 * k + 2, copy)) {
+      samples.push_back(copy);
+    }
+  }
+  return samples;
+}
+
+// the summary is a single slot, a reader only retries while the writer is
+// publishing a newer one
+window_summary time_series::window() const {
+  window_summary summary{};
+  while (true) {
+    std::uint64_t const sequence =
+        summary_.sequence.load(std::memory_order_acquire);
+    if (sequence == 0) {
+      return summary;
+    }
+    if (sequence % 2 == 0 && try_read(summary_, sequence, summary)) {
+      return summary;
+    }
+  }
+}
+
+std::uint64_t time_series::pushed() const {
+  return pushed_.load(std::memory_order_acquire);
+}
+std::size_t time_series::capacity() const { return capacity_; }
+std::size_t time_series::window_size() const { return window_; }
+
+// Function to convert a window summary to a formatted string
+std::string print_window_to_string(window_summary const &to_be_printed) {
+  std::string plus_minus{"  +/-  "};
+  std::string to_be_returned{"Last "};
+  to_be_returned += std::to_string(to_be_printed.samples);
+  to_be_returned += " Steps";
+  // the worker fields change only when a new result arrives
+  if (to_be_printed.samples != 0) {
+    to_be_returned += " (statistics of step ";
+    to_be_returned += std::to_string(to_be_printed.statistics_step);
+    to_be_returned += ")";
+  }
+  to_be_returned += "\nMean Velocity:   ";
+  to_be_returned += std::to_string(to_be_printed.mean.mean_velocity);
+  to_be_returned += plus_minus;
+  to_be_returned += std::to_string(to_be_printed.sigma.mean_velocity);
+  to_be_returned += "\nPolarization:   ";
+  to_be_returned += std::to_string(to_be_printed.mean.polarization);
+  to_be_returned += plus_minus;
+  to_be_returned += std::to_string(to_be_printed.sigma.polarization);
+  to_be_returned += "\nStep Time (ms):   ";
+  to_be_returned += std::to_string(to_be_printed.mean_step_seconds * 1000.);
+  to_be_returned += plus_minus;
+  to_be_returned += std::to_string(to_be_printed.sigma_step_seconds * 1000.);
+  return to_be_returned;
+}
+} // namespace view
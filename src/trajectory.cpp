@@ -0,0 +1,319 @@
+#include "../include/trajectory.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace io {
+namespace {
+static_assert(std::numeric_limits<double>::is_iec559,
+              "trajectories store IEEE 754 doubles");
+
+constexpr char magic[8] = {'B', 'O', 'I', 'D', 'T', 'R', 'A', 'J'};
+// the file grows by doubling from this number of frames
+constexpr std::uint64_t initial_capacity{16};
+
+// Header at the beginning of the file, padded so that the frames start on a
+// cache line
+struct trajectory_header {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t reserved;
+  std::uint64_t boids;
+  std::uint64_t frames; // complete frames
+  std::uint64_t frame_bytes;
+  std::int64_t boids_number;
+  double parameters[11]; // running_parameters in their order of declaration
+  char padding[56];
+};
+static_assert(sizeof(trajectory_header) == 192,
+              "the header has a fixed layout");
+
+// every frame starts with its step and time
+constexpr std::size_t frame_header_bytes{2 * sizeof(std::uint64_t)};
+
+std::size_t frame_bytes(std::size_t boids) {
+  return frame_header_bytes + 4 * sizeof(double) * boids;
+}
+
+void check_little_endian() {
+  std::uint16_t const probe{1};
+  unsigned char first{};
+  std::memcpy(&first, &probe, 1);
+  if (first != 1) {
+    throw std::runtime_error(
+        "ERROR: Trajectories need a little endian machine");
+  }
+}
+} // namespace
+
+frame_view::frame_view(std::uint64_t step, double time, std::size_t boids,
+                       double const *values)
+    : step_{step}, time_{time}, boids_{boids}, values_{values} {}
+
+std::uint64_t frame_view::step() const { return step_; }
+double frame_view::time() const { return time_; }
+std::size_t frame_view::boids() const { return boids_; }
+math::R2 frame_view::r(std::size_t boid) const {
+  return {values_[4 * boid], values_[4 * boid + 1]};
+}
+math::R2 frame_view::v(std::size_t boid) const {
+  return {values_[4 * boid + 2], values_[4 * boid + 3]};
+}
+double const *frame_view::values() const { return values_; }
+
+std::vector<dynamics::Boid> frame_view::flock() const {
+  std::vector<dynamics::Boid> flock;
+  flock.reserve(boids_);
+  for (std::size_t i{}; i != boids_; ++i) {
+    flock.emplace_back(r(i), v(i));
+  }
+  return flock;
+}
+
+trajectory_writer::trajectory_writer(
+    std::string const &path, std::size_t boids,
+    dynamics::running_parameters const &parameters)
+    : fd_{-1}, boids_{boids}, frame_bytes_{frame_bytes(boids)}, frames_{0},
+      capacity_{0}, address_{nullptr}, mapped_bytes_{0} {
+  check_little_endian();
+  fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd_ == -1) {
+    throw std::runtime_error("ERROR: Failed to create " + path);
+  }
+  try {
+    map(initial_capacity);
+  } catch (...) {
+    ::close(fd_);
+    throw;
+  }
+  trajectory_header header{};
+  std::memcpy(header.magic, magic, sizeof(magic));
+  header.version = trajectory_version;
+  header.boids = boids;
+  header.frame_bytes = frame_bytes_;
+  header.boids_number = parameters.boids_number;
+  double const values[11] = {
+      parameters.s,           parameters.a,
+      parameters.c,           parameters.d_s,
+      parameters.d,           parameters.left_bound,
+      parameters.right_bound, parameters.upper_bound,
+      parameters.bottom_bound, parameters.maximum_velocity,
+      parameters.minimum_velocity};
+  std::memcpy(header.parameters, values, sizeof(values));
+  std::memcpy(address_, &header, sizeof(header));
+}
+
+// the file is sized before it is mapped, the old mapping is dropped
+void trajectory_writer::map(std::uint64_t capacity) {
+  std::size_t const bytes = sizeof(trajectory_header) + capacity * frame_bytes_;
+  if (::ftruncate(fd_, static_cast<off_t>(bytes)) == -1) {
+    throw std::runtime_error("ERROR: Failed to grow trajectory file");
+  }
+  void *const address =
+      ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (address == MAP_FAILED) {
+    throw std::runtime_error("ERROR: Failed to map trajectory file");
+  }
+  if (address_ != nullptr) {
+    ::munmap(address_, mapped_bytes_);
+  }
+  address_ = address;
+  mapped_bytes_ = bytes;
+  capacity_ = capacity;
+}
+
+trajectory_writer::~trajectory_writer() {
+  try {
+    close();
+  } catch (...) {
+    // a destructor can't report the failure, the frames counted in the
+    // header are still readable
+  }
+}
+
+void trajectory_writer::append(std::uint64_t step, double time,
+                               std::vector<dynamics::Boid> const &flock) {
+  if (fd_ == -1) {
+    throw std::runtime_error("ERROR: The trajectory is closed");
+  }
+  if (flock.size() != boids_) {
+    throw std::runtime_error("ERROR: Every frame of a trajectory must have " +
+                             std::to_string(boids_) + " boids");
+  }
+  if (frames_ == capacity_) {
+    map(2 * capacity_);
+  }
+  char *const frame = static_cast<char *>(address_) +
+                      sizeof(trajectory_header) + frames_ * frame_bytes_;
+  std::memcpy(frame, &step, sizeof(step));
+  std::memcpy(frame + sizeof(step), &time, sizeof(time));
+  double *const values = reinterpret_cast<double *>(frame + frame_header_bytes);
+  for (std::size_t i{}; i != boids_; ++i) {
+    values[4 * i] = flock[i].r().x;
+    values[4 * i + 1] = flock[i].r().y;
+    values[4 * i + 2] = flock[i].v().x;
+    values[4 * i + 3] = flock[i].v().y;
+  }
+  // the frame is counted only after it has been written
+  ++frames_;
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(static_cast<char *>(address_) +
+                  offsetof(trajectory_header, frames),
+              &frames_, sizeof(frames_));
+}
+
+std::uint64_t trajectory_writer::frames() const { return frames_; }
+
+void trajectory_writer::close() {
+  if (fd_ == -1) {
+    return;
+  }
+  ::munmap(address_, mapped_bytes_);
+  address_ = nullptr;
+  bool const trimmed =
+      ::ftruncate(fd_, static_cast<off_t>(sizeof(trajectory_header) +
+                                          frames_ * frame_bytes_)) == 0;
+  ::close(fd_);
+  fd_ = -1;
+  if (!trimmed) {
+    throw std::runtime_error("ERROR: Failed to trim trajectory file");
+  }
+}
+
+trajectory_reader::trajectory_reader(std::string const &path)
+    : address_{nullptr}, mapped_bytes_{0}, boids_{0}, frame_bytes_{0},
+      frames_{0}, parameters_{} {
+  check_little_endian();
+  int const fd = ::open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    throw std::runtime_error("ERROR: Failed to open " + path);
+  }
+  struct stat status {};
+  if (::fstat(fd, &status) == -1 ||
+      static_cast<std::size_t>(status.st_size) < sizeof(trajectory_header)) {
+    ::close(fd);
+    throw std::runtime_error("ERROR: Not a boids trajectory " + path);
+  }
+  mapped_bytes_ = static_cast<std::size_t>(status.st_size);
+  void *const address =
+      ::mmap(nullptr, mapped_bytes_, PROT_READ, MAP_SHARED, fd, 0);
+  // the mapping keeps the file alive
+  ::close(fd);
+  if (address == MAP_FAILED) {
+    throw std::runtime_error("ERROR: Failed to map " + path);
+  }
+  address_ = address;
+
+  trajectory_header header;
+  std::memcpy(&header, address_, sizeof(header));
+  std::uint64_t const largest_flock =
+      (std::numeric_limits<std::size_t>::max() - frame_header_bytes) /
+      (4 * sizeof(double));
+  if (!std::equal(magic, magic + sizeof(magic), header.magic) ||
+      header.boids > largest_flock || header.version == 0 ||
+      header.version > trajectory_version ||
+      header.frame_bytes != frame_bytes(header.boids)) {
+    ::munmap(const_cast<void *>(address_), mapped_bytes_);
+    throw std::runtime_error("ERROR: Not a boids trajectory " + path);
+  }
+  boids_ = header.boids;
+  frame_bytes_ = header.frame_bytes;
+  // a file cut short keeps its complete frames
+  frames_ = std::min<std::uint64_t>(
+      header.frames,
+      (mapped_bytes_ - sizeof(trajectory_header)) / frame_bytes_);
+  parameters_.boids_number = static_cast<int>(header.boids_number);
+  double *const values[11] = {
+      &parameters_.s,           &parameters_.a,
+      &parameters_.c,           &parameters_.d_s,
+      &parameters_.d,           &parameters_.left_bound,
+      &parameters_.right_bound, &parameters_.upper_bound,
+      &parameters_.bottom_bound, &parameters_.maximum_velocity,
+      &parameters_.minimum_velocity};
+  for (std::size_t k{}; k != 11; ++k) {
+    *values[k] = header.parameters[k];
+  }
+}
+
+trajectory_reader::~trajectory_reader() {
+  ::munmap(const_cast<void *>(address_), mapped_bytes_);
+}
+
+std::uint64_t trajectory_reader::frames() const { return frames_; }
+std::size_t trajectory_reader::boids() const { return boids_; }
+dynamics::running_parameters const &trajectory_reader::parameters() const {
+  return parameters_;
+}
+
+frame_view trajectory_reader::frame(std::uint64_t index) const {
+  if (index >= frames_) {
+    throw std::out_of_range("ERROR: No frame " + std::to_string(index));
+  }
+  char const *const frame = static_cast<char const *>(address_) +
+                            sizeof(trajectory_header) + index * frame_bytes_;
+  std::uint64_t step;
+  double time;
+  std::memcpy(&step, frame, sizeof(step));
+  std::memcpy(&time, frame + sizeof(step), sizeof(time));
+  return {step, time, boids_,
+          reinterpret_cast<double const *>(frame + frame_header_bytes)};
+}
+
+std::uint64_t trajectory_reader::find_step(std::uint64_t step) const {
+  std::uint64_t first{0};
+  std::uint64_t last{frames_};
+  while (first != last) {
+    std::uint64_t const middle = first + (last - first) / 2;
+    if (frame(middle).step() < step) {
+      first = middle + 1;
+    } else {
+      last = middle;
+    }
+  }
+  return first;
+}
+
+std::uint64_t trajectory_reader::find_time(double time) const {
+  std::uint64_t first{0};
+  std::uint64_t last{frames_};
+  while (first != last) {
+    std::uint64_t const middle = first + (last - first) / 2;
+    if (frame(middle).time() < time) {
+      first = middle + 1;
+    } else {
+      last = middle;
+    }
+  }
+  return first;
+}
+
+void trajectory_reader::prefetch(std::uint64_t first,
+                                 std::uint64_t last) const {
+  last = std::min(last, frames_);
+  if (first >= last) {
+    return;
+  }
+  std::size_t const page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+  std::size_t const begin =
+      (sizeof(trajectory_header) + first * frame_bytes_) / page * page;
+  std::size_t const end = sizeof(trajectory_header) + last * frame_bytes_;
+  char const *const base = static_cast<char const *>(address_);
+  ::madvise(const_cast<char *>(base) + begin, end - begin, MADV_WILLNEED);
+  // reading a byte of every page faults it in now, on this thread
+  unsigned char touched{};
+  for (std::size_t offset{begin}; offset < end; offset += page) {
+    touched ^= static_cast<unsigned char>(
+        *static_cast<char const volatile *>(base + offset));
+  }
+  static_cast<void>(touched);
+}
+} // namespace io
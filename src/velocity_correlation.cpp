@@ -0,0 +1,220 @@
+#include "../include/velocity_correlation.hpp"
+#include "../include/fft.hpp"
+#include "../include/parallel.hpp"
+#include "../include/spatial.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <limits>
+#include <stdexcept>
+
+namespace view {
+namespace {
+// boids whose couples are summed in private bins, the blocks are merged in
+// their order so the sums do not depend on the number of threads
+constexpr std::size_t boids_per_block{256};
+
+// velocity fluctuations of the boids around the mean velocity and their mean
+// square, which is taken as 0 when it is only made of rounding errors
+struct fluctuations_data {
+  std::vector<math::R2> values;
+  double variance;
+};
+
+fluctuations_data
+calculate_fluctuations(std::vector<dynamics::Boid> const &flock) {
+  fluctuations_data fluctuations{std::vector<math::R2>(flock.size()), 0.};
+  if (flock.empty()) {
+    return fluctuations;
+  }
+  double const n = static_cast<double>(flock.size());
+  math::R2 const mean =
+      parallel::deterministic_sum<math::R2>(
+          flock.size(), [&](std::size_t i) { return flock[i].v(); }) *
+      (1. / n);
+  for (std::size_t i{}; i != flock.size(); ++i) {
+    fluctuations.values[i] = flock[i].v() - mean;
+  }
+  fluctuations.variance =
+      parallel::deterministic_sum<double>(flock.size(), [&](std::size_t i) {
+        return fluctuations.values[i] * fluctuations.values[i];
+      }) /
+      n;
+  double const rounding = std::numeric_limits<double>::epsilon() *
+                          math::calculate_norm(mean) * 4.;
+  if (fluctuations.variance <= rounding * rounding) {
+    fluctuations.variance = 0.;
+  }
+  return fluctuations;
+}
+
+// normalizes the sums of the bins and looks for the first zero of C,
+// interpolating linearly between the centers of the bins
+void finish(velocity_correlation &correlation,
+            std::vector<double> const &sums, double variance) {
+  std::size_t const bins = sums.size();
+  correlation.values.assign(bins, 0.);
+  correlation.correlation_length = bins * correlation.bin_width;
+  if (variance == 0.) {
+    // without fluctuations there is nothing to correlate
+    correlation.correlation_length = 0.;
+    return;
+  }
+  for (std::size_t bin{}; bin != bins; ++bin) {
+    if (correlation.couples[bin] != 0) {
+      correlation.values[bin] =
+          sums[bin] / static_cast<double>(correlation.couples[bin]) / variance;
+    }
+  }
+  bool has_previous{false};
+  double previous_radius{};
+  double previous_value{};
+  for (std::size_t bin{}; bin != bins; ++bin) {
+    if (correlation.couples[bin] == 0) {
+      continue;
+    }
+    double const radius = (bin + .5) * correlation.bin_width;
+    double const value = correlation.values[bin];
+    if (value <= 0.) {
+      correlation.correlation_length =
+          has_previous ? previous_radius + (radius - previous_radius) *
+                                               previous_value /
+                                               (previous_value - value)
+                       : radius;
+      return;
+    }
+    has_previous = true;
+    previous_radius = radius;
+    previous_value = value;
+  }
+}
+
+} // namespace
+
+velocity_correlation
+calculate_velocity_correlation(std::vector<dynamics::Boid> const &flock,
+                               double r_max, std::size_t bins,
+                               dynamics::running_parameters const &parameters) {
+  double const shortest =
+      std::min(parameters.right_bound - parameters.left_bound,
+               parameters.upper_bound - parameters.bottom_bound);
+  if (bins == 0 || !(r_max > 0.) || r_max > shortest / 2.) {
+    throw std::runtime_error("ERROR: Invalid velocity correlation range");
+  }
+  velocity_correlation correlation{r_max / bins, {},
+                                   std::vector<std::uint64_t>(bins), 0.};
+  fluctuations_data const fluctuations = calculate_fluctuations(flock);
+  dynamics::cell_list const cells{flock, r_max, parameters, true};
+
+  std::size_t const n = flock.size();
+  std::size_t const blocks = (n + boids_per_block - 1) / boids_per_block;
+  std::vector<std::vector<double>> block_sums(blocks);
+  std::vector<std::vector<std::uint64_t>> block_couples(blocks);
+  parallel::parallel_for(blocks, [&](std::size_t block) {
+    std::vector<double> sums(bins);
+    std::vector<std::uint64_t> couples(bins);
+    std::size_t const last = std::min(n, (block + 1) * boids_per_block);
+    for (std::size_t i{block * boids_per_block}; i != last; ++i) {
+      cells.for_each_neighbor(
+          flock[i].r(), r_max, [&](std::size_t j, math::R2 const &d) {
+            if (j > i) {
+              std::size_t const bin = std::min(
+                  bins - 1,
+                  static_cast<std::size_t>(std::sqrt(d * d) /
+                                           correlation.bin_width));
+              sums[bin] += fluctuations.values[i] * fluctuations.values[j];
+              ++couples[bin];
+            }
+          });
+    }
+    block_sums[block] = std::move(sums);
+    block_couples[block] = std::move(couples);
+  });
+
+  std::vector<double> sums(bins);
+  for (std::size_t block{}; block != blocks; ++block) {
+    for (std::size_t bin{}; bin != bins; ++bin) {
+      sums[bin] += block_sums[block][bin];
+      correlation.couples[bin] += block_couples[block][bin];
+    }
+  }
+  finish(correlation, sums, fluctuations.variance);
+  return correlation;
+}
+
+// With f the sum of the fluctuations of the boids in every cell, the
+// autocorrelation sum_x f(x) * f(x + s) is the sum of du_i * du_j over the
+// couples of boids whose cells are s apart, and the one of the number of boids
+// in every cell counts those couples. Both are computed as the inverse
+// transform of the squared modulus of the transform. The two components of the
+// fluctuations are packed in a single complex field, the real part of its
+// autocorrelation is the sum of the autocorrelations of the components
+velocity_correlation calculate_velocity_correlation_fft(
+    std::vector<dynamics::Boid> const &flock, std::size_t bins,
+    std::size_t resolution, dynamics::running_parameters const &parameters) {
+  double const width = parameters.right_bound - parameters.left_bound;
+  double const height = parameters.upper_bound - parameters.bottom_bound;
+  if (bins == 0 || resolution == 0 || !(width > 0.) || !(height > 0.)) {
+    throw std::runtime_error("ERROR: Invalid velocity correlation grid");
+  }
+  std::size_t const side = math::next_power_of_two(resolution);
+  double const cell_width = width / side;
+  double const cell_height = height / side;
+  double const r_max = std::sqrt(width * width + height * height) / 2.;
+  velocity_correlation correlation{r_max / bins, {},
+                                   std::vector<std::uint64_t>(bins), 0.};
+  fluctuations_data const fluctuations = calculate_fluctuations(flock);
+
+  std::vector<std::complex<double>> field(side * side);
+  std::vector<std::complex<double>> density(side * side);
+  for (std::size_t i{}; i != flock.size(); ++i) {
+    auto const cell = [&](double coordinate, double origin, double size) {
+      return static_cast<std::size_t>(std::clamp(
+          std::floor((coordinate - origin) / size), 0., side - 1.));
+    };
+    std::size_t const index =
+        cell(flock[i].r().y, parameters.bottom_bound, cell_height) * side +
+        cell(flock[i].r().x, parameters.left_bound, cell_width);
+    field[index] += std::complex<double>{fluctuations.values[i].x,
+                                         fluctuations.values[i].y};
+    density[index] += 1.;
+  }
+  math::fft_2d(field, side, side);
+  math::fft_2d(density, side, side);
+  for (std::size_t k{}; k != field.size(); ++k) {
+    field[k] = std::norm(field[k]);
+    density[k] = std::norm(density[k]);
+  }
+  math::fft_2d(field, side, side, true);
+  math::fft_2d(density, side, side, true);
+
+  // the shift 0 contains the boids with themselves, which are not couples
+  field[0] -= fluctuations.variance * flock.size();
+  density[0] -= static_cast<double>(flock.size());
+
+  // every couple appears twice in the autocorrelations, once for every order
+  std::vector<double> sums(bins);
+  std::vector<double> couples(bins);
+  for (std::size_t row{}; row != side; ++row) {
+    double const dy =
+        (row <= side / 2 ? row : static_cast<double>(row) - side) * cell_height;
+    for (std::size_t column{}; column != side; ++column) {
+      double const dx = (column <= side / 2 ? column
+                                            : static_cast<double>(column) - side) *
+                        cell_width;
+      std::size_t const bin = std::min(
+          bins - 1, static_cast<std::size_t>(std::sqrt(dx * dx + dy * dy) /
+                                             correlation.bin_width));
+      sums[bin] += field[row * side + column].real() / 2.;
+      couples[bin] += density[row * side + column].real() / 2.;
+    }
+  }
+  for (std::size_t bin{}; bin != bins; ++bin) {
+    correlation.couples[bin] =
+        static_cast<std::uint64_t>(std::llround(std::max(0., couples[bin])));
+  }
+  finish(correlation, sums, fluctuations.variance);
+  return correlation;
+}
+} // namespace view
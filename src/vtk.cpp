@@ -0,0 +1,247 @@
+#include "../include/vtk.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace io {
+namespace {
+static_assert(std::numeric_limits<double>::is_iec559,
+              "Float64 arrays are IEEE 754 doubles");
+
+// bytes converted before they are written
+constexpr std::size_t buffer_bytes{std::size_t{1} << 16};
+// VTK_VERTEX, a cell made of a single point
+constexpr std::uint8_t vertex_cell{1};
+
+bool little_endian_host() {
+  std::uint16_t const probe{1};
+  unsigned char first{};
+  std::memcpy(&first, &probe, 1);
+  return first == 1;
+}
+
+// An array of the appended data, a value of element_bytes bytes per boid
+struct vtu_array {
+  std::string type;
+  std::string name;
+  int components;
+  std::size_t element_bytes;
+};
+
+// Collects the values of the arrays in a buffer and writes it when it is
+// full, so that the stream sees a few large writes
+class buffered_output {
+private:
+  std::ostream &output_;
+  std::vector<char> buffer_;
+  std::size_t size_;
+
+public:
+  explicit buffered_output(std::ostream &output)
+      : output_{output}, buffer_(buffer_bytes), size_{0} {}
+
+  template <typename T> void put(T const &value) {
+    if (size_ + sizeof(T) > buffer_.size()) {
+      flush();
+    }
+    std::memcpy(buffer_.data() + size_, &value, sizeof(T));
+    size_ += sizeof(T);
+  }
+
+  void flush() {
+    output_.write(buffer_.data(), static_cast<std::streamsize>(size_));
+    size_ = 0;
+  }
+};
+
+std::string format_time(double time) {
+  std::ostringstream formatted;
+  formatted << std::setprecision(17) << time;
+  return formatted.str();
+}
+} // namespace
+
+void write_vtu(std::ostream &output, std::vector<dynamics::Boid> const &flock,
+               vtu_scalars const &scalars) {
+  std::size_t const n = flock.size();
+  bool const neighbors = !scalars.neighbors.empty();
+  bool const clusters = !scalars.clusters.empty();
+  if ((neighbors && scalars.neighbors.size() != n) ||
+      (clusters && scalars.clusters.size() != n)) {
+    throw std::runtime_error("ERROR: The scalars don't match the flock");
+  }
+
+  // the offset of an array in the appended data is the sum of the sizes of
+  // the previous ones, each with its u64 size
+  std::uint64_t offset{};
+  auto const describe = [&](vtu_array const &array, std::string const &indent) {
+    std::string text = indent + "<DataArray type=\"" + array.type + "\"";
+    if (!array.name.empty()) {
+      text += " Name=\"" + array.name + "\"";
+    }
+    if (array.components != 1) {
+      text += " NumberOfComponents=\"" + std::to_string(array.components) +
+              "\"";
+    }
+    text += " format=\"appended\" offset=\"" + std::to_string(offset) +
+            "\"/>\n";
+    offset += sizeof(std::uint64_t) + array.element_bytes * n;
+    return text;
+  };
+  std::string const points = "      ";
+  std::string const data = "        ";
+  std::string xml{"<?xml version=\"1.0\"?>\n"};
+  xml += "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" byte_order=\"";
+  xml += little_endian_host() ? "LittleEndian" : "BigEndian";
+  xml += "\" header_type=\"UInt64\">\n";
+  xml += "  <UnstructuredGrid>\n";
+  xml += "    <Piece NumberOfPoints=\"" + std::to_string(n) +
+         "\" NumberOfCells=\"" + std::to_string(n) + "\">\n";
+  xml += points + "<Points>\n";
+  xml += describe({"Float64", "", 3, 3 * sizeof(double)}, data);
+  xml += points + "</Points>\n";
+  xml += points + "<PointData Vectors=\"velocity\"";
+  xml += neighbors ? " Scalars=\"neighbors\">\n" : ">\n";
+  xml += describe({"Float64", "velocity", 3, 3 * sizeof(double)}, data);
+  if (neighbors) {
+    xml += describe({"UInt64", "neighbors", 1, sizeof(std::uint64_t)}, data);
+  }
+  if (clusters) {
+    xml += describe({"UInt64", "cluster", 1, sizeof(std::uint64_t)}, data);
+  }
+  xml += points + "</PointData>\n";
+  xml += points + "<Cells>\n";
+  xml += describe({"Int64", "connectivity", 1, sizeof(std::int64_t)}, data);
+  xml += describe({"Int64", "offsets", 1, sizeof(std::int64_t)}, data);
+  xml += describe({"UInt8", "types", 1, sizeof(std::uint8_t)}, data);
+  xml += points + "</Cells>\n";
+  xml += "    </Piece>\n";
+  xml += "  </UnstructuredGrid>\n";
+  xml += "  <AppendedData encoding=\"raw\">\n   _";
+  output.write(xml.data(), static_cast<std::streamsize>(xml.size()));
+
+  // the arrays in the order of their offsets
+  buffered_output appended{output};
+  auto const size = [&](std::size_t element_bytes) {
+    appended.put(static_cast<std::uint64_t>(element_bytes * n));
+  };
+  size(3 * sizeof(double));
+  for (auto const &boid : flock) {
+    appended.put(boid.r().x);
+    appended.put(boid.r().y);
+    appended.put(0.);
+  }
+  size(3 * sizeof(double));
+  for (auto const &boid : flock) {
+    appended.put(boid.v().x);
+    appended.put(boid.v().y);
+    appended.put(0.);
+  }
+  if (neighbors) {
+    size(sizeof(std::uint64_t));
+    for (std::size_t count : scalars.neighbors) {
+      appended.put(static_cast<std::uint64_t>(count));
+    }
+  }
+  if (clusters) {
+    size(sizeof(std::uint64_t));
+    for (std::size_t label : scalars.clusters) {
+      appended.put(static_cast<std::uint64_t>(label));
+    }
+  }
+  // every cell is the vertex of a boid
+  size(sizeof(std::int64_t));
+  for (std::size_t i{}; i != n; ++i) {
+    appended.put(static_cast<std::int64_t>(i));
+  }
+  size(sizeof(std::int64_t));
+  for (std::size_t i{}; i != n; ++i) {
+    appended.put(static_cast<std::int64_t>(i + 1));
+  }
+  size(sizeof(std::uint8_t));
+  for (std::size_t i{}; i != n; ++i) {
+    appended.put(vertex_cell);
+  }
+  appended.flush();
+  std::string const end{"\n  </AppendedData>\n</VTKFile>\n"};
+  output.write(end.data(), static_cast<std::streamsize>(end.size()));
+  if (!output) {
+    throw std::runtime_error("ERROR: Failed to write the grid");
+  }
+}
+
+vtu_series::vtu_series(std::string const &pvd_path)
+    : path_{pvd_path}, stem_{pvd_path}, closed_{false} {
+  std::string const extension{".pvd"};
+  if (stem_.size() > extension.size() &&
+      stem_.compare(stem_.size() - extension.size(), extension.size(),
+                    extension) == 0) {
+    stem_.resize(stem_.size() - extension.size());
+  }
+}
+
+vtu_series::~vtu_series() {
+  try {
+    close();
+  } catch (...) {
+    // errors can't be reported from a destructor
+  }
+}
+
+void vtu_series::add(double time, std::vector<dynamics::Boid> const &flock,
+                     vtu_scalars const &scalars) {
+  if (closed_) {
+    throw std::runtime_error("ERROR: The series is closed");
+  }
+  std::ostringstream number;
+  number << std::setw(6) << std::setfill('0') << frames_.size();
+  std::string const path = stem_ + '_' + number.str() + ".vtu";
+  std::ofstream file{path, std::ios::binary};
+  if (!file) {
+    throw std::runtime_error("ERROR: Failed to create " + path);
+  }
+  write_vtu(file, flock, scalars);
+  file.close();
+  if (!file) {
+    throw std::runtime_error("ERROR: Failed to write " + path);
+  }
+  // the index refers to the frames relative to its directory
+  std::size_t const slash = path.find_last_of('/');
+  frames_.emplace_back(time, slash == std::string::npos
+                                 ? path
+                                 : path.substr(slash + 1));
+}
+
+std::size_t vtu_series::frames() const { return frames_.size(); }
+
+void vtu_series::close() {
+  if (closed_) {
+    return;
+  }
+  closed_ = true;
+  std::ofstream index{path_};
+  if (!index) {
+    throw std::runtime_error("ERROR: Failed to create " + path_);
+  }
+  index << "<?xml version=\"1.0\"?>\n"
+        << "<VTKFile type=\"Collection\" version=\"0.1\" byte_order=\""
+        << (little_endian_host() ? "LittleEndian" : "BigEndian") << "\">\n"
+        << "  <Collection>\n";
+  for (auto const &frame : frames_) {
+    index << "    <DataSet timestep=\"" << format_time(frame.first)
+          << "\" part=\"0\" file=\"" << frame.second << "\"/>\n";
+  }
+  index << "  </Collection>\n"
+        << "</VTKFile>\n";
+  index.close();
+  if (!index) {
+    throw std::runtime_error("ERROR: Failed to write " + path_);
+  }
+}
+} // namespace io
@@ -0,0 +1,61 @@
+#include "../include/welford.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace math {
+welford::welford() : welford(0., 0., 0.) {}
+welford::welford(double value) : welford(1., value, 0.) {}
+welford::welford(double count, double mean, double m2)
+    : count_{count}, mean_{mean}, m2_{m2} {}
+
+void welford::add(double value) {
+  count_ += 1.;
+  double const delta = value - mean_;
+  mean_ += delta / count_;
+  m2_ += delta * (value - mean_);
+}
+
+// add run backwards, rounding may leave a tiny negative m2 which is clipped
+void welford::remove(double value) {
+  if (count_ <= 1.) {
+    *this = welford{};
+    return;
+  }
+  count_ -= 1.;
+  double const delta = value - mean_;
+  mean_ -= delta / count_;
+  m2_ = std::max(0., m2_ - delta * (value - mean_));
+}
+
+// Chan's formula, the deviation of the means is weighted by the counts
+welford &welford::operator+=(welford const &rhs) {
+  if (rhs.count_ == 0.) {
+    return *this;
+  }
+  if (count_ == 0.) {
+    return *this = rhs;
+  }
+  double const count = count_ + rhs.count_;
+  double const delta = rhs.mean_ - mean_;
+  mean_ += delta * (rhs.count_ / count);
+  m2_ += rhs.m2_ + delta * delta * (count_ * rhs.count_ / count);
+  count_ = count;
+  return *this;
+}
+
+double welford::count() const { return count_; }
+double welford::mean() const { return mean_; }
+double welford::m2() const { return m2_; }
+
+double welford::variance() const {
+  return count_ > 1. ? m2_ / (count_ - 1.) : 0.;
+}
+
+double welford::sigma() const { return std::sqrt(variance()); }
+
+welford operator+(welford const &lhs, welford const &rhs) {
+  auto result{lhs};
+  return result += rhs;
+}
+} // namespace math
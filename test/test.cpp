@@ -1,6 +1,89 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "../include/doctest.h"
+#include "../include/analysis.hpp"
+#include "../include/async_writer.hpp"
+#include "../include/batch.hpp"
+#include "../include/clusters.hpp"
+#include "../include/codec.hpp"
+#include "../include/density_field.hpp"
+#include "../include/ensemble.hpp"
+#include "../include/fft.hpp"
 #include "../include/flock.hpp"
+#include "../include/numpy.hpp"
+#include "../include/pair_correlation.hpp"
+#include "../include/recorder.hpp"
+#include "../include/region.hpp"
+#include "../include/replay.hpp"
+#include "../include/parallel.hpp"
+#include "../include/shard.hpp"
+#include "../include/snapshot.hpp"
+#include "../include/spatial.hpp"
+#include "../include/spsc_queue.hpp"
+#include "../include/statistics_worker.hpp"
+#include "../include/time_series.hpp"
+#include "../include/trajectory.hpp"
+#include "../include/velocity_correlation.hpp"
+#include "../include/vtk.hpp"
+#include "../include/welford.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <unistd.h>
+
+namespace {
+// A directory of its own in the temporary directory for the files of a test,
+// removed with everything in it when the test leaves its scope
+class temporary_directory {
+private:
+  std::filesystem::path directory_;
+
+public:
+  temporary_directory()
+      : directory_{std::filesystem::temp_directory_path() /
+                   ("boids-test-" + std::to_string(std::random_device{}()))} {
+    std::filesystem::create_directories(directory_);
+  }
+  temporary_directory(temporary_directory const &) = delete;
+  temporary_directory &operator=(temporary_directory const &) = delete;
+  ~temporary_directory() {
+    std::error_code error;
+    std::filesystem::remove_all(directory_, error);
+  }
+
+  // path of a file in the directory
+  std::string path(std::string const &name) const {
+    return (directory_ / name).string();
+  }
+};
+
+// The default parameters with the given number of boids, and a flock created
+// with them from a seed, shared by the tests of files and formats
+dynamics::running_parameters test_parameters(int boids) {
+  dynamics::running_parameters parameters{};
+  parameters.boids_number = boids;
+  return parameters;
+}
+
+std::vector<dynamics::Boid>
+test_flock(dynamics::running_parameters const &parameters,
+           std::uint64_t seed) {
+  std::mt19937_64 engine{seed};
+  return dynamics::create_flock(parameters, engine);
+}
+} // namespace
 
 TEST_CASE("Class R2 and operators tests") {
   SUBCASE("Vector addition") {
@@ -499,8 +582,9 @@ TEST_CASE("Testing mean distance and std_dev") {
     double mean = view::calculate_mean_distance(flock);
 
     CHECK(mean == doctest::Approx(3.6966));
+    // sample standard deviation of the ten distances
     CHECK(view::calculate_standard_deviation_distance(flock, mean) ==
-          doctest::Approx(0.6890).epsilon(0.0001));
+          doctest::Approx(1.5403).epsilon(0.0001));
   }
 }
 
@@ -530,4 +614,2018 @@ TEST_CASE("Testing mean velocity and std_dev") {
     CHECK(view::calculate_standard_deviation_velocity(flock, mean) ==
           doctest::Approx(3.2184).epsilon(0.0001));
   }
+  SUBCASE("large speeds with a small spread") {
+    // the sums of the squares cancel, the standard deviation is still 1
+    std::vector<dynamics::Boid> flock;
+    for (double speed : {1e8, 1e8 + 1., 1e8 + 2.}) {
+      flock.emplace_back(0., 0., speed, 0.);
+    }
+    double mean = view::calculate_mean_velocity(flock);
+    CHECK(view::calculate_standard_deviation_velocity(flock, mean) ==
+          doctest::Approx(1.));
+  }
+}
+
+TEST_CASE("Testing deterministic reductions") {
+  // a flock large enough to be split in many reduction blocks
+  std::mt19937 eng(42);
+  std::uniform_real_distribution<double> dist(-100., 100.);
+  std::vector<dynamics::Boid> flock;
+  for (int i{}; i != 5000; ++i) {
+    flock.emplace_back(dist(eng), dist(eng), dist(eng), dist(eng));
+  }
+  std::vector<dynamics::Boid> small_flock(flock.begin(), flock.begin() + 700);
+  unsigned const default_threads = parallel::thread_count();
+
+  SUBCASE("pairwise sum") {
+    double sum = parallel::deterministic_sum<double>(
+        1000, [](std::size_t i) { return static_cast<double>(i + 1); });
+    CHECK(sum == 500500.);
+    CHECK(parallel::deterministic_sum<double>(
+              0, [](std::size_t) { return 1.; }) == 0.);
+  }
+
+  SUBCASE("same results for 1 and 64 threads") {
+    parallel::thread_count(1);
+    math::R2 cdm = dynamics::calculate_CDM(flock, flock[3]);
+    math::R2 alignment = dynamics::calculate_alignment(flock[3], flock, 0.5);
+    double mean_velocity = view::calculate_mean_velocity(flock);
+    double sigma_velocity =
+        view::calculate_standard_deviation_velocity(flock, mean_velocity);
+    double mean_distance = view::calculate_mean_distance(small_flock);
+    double sigma_distance =
+        view::calculate_standard_deviation_distance(small_flock, mean_distance);
+
+    parallel::thread_count(64);
+    CHECK(dynamics::calculate_CDM(flock, flock[3]) == cdm);
+    CHECK(dynamics::calculate_alignment(flock[3], flock, 0.5) == alignment);
+    CHECK(view::calculate_mean_velocity(flock) == mean_velocity);
+    CHECK(view::calculate_standard_deviation_velocity(flock, mean_velocity) ==
+          sigma_velocity);
+    CHECK(view::calculate_mean_distance(small_flock) == mean_distance);
+    CHECK(view::calculate_standard_deviation_distance(
+              small_flock, mean_distance) == sigma_distance);
+  }
+
+  SUBCASE("exceptions are rethrown on the calling thread") {
+    parallel::thread_count(4);
+    CHECK_THROWS_AS(parallel::parallel_for(100,
+                                           [](std::size_t i) {
+                                             if (i == 50) {
+                                               throw std::runtime_error{"50"};
+                                             }
+                                           }),
+                    std::runtime_error);
+  }
+  parallel::thread_count(default_threads);
+}
+
+TEST_CASE("Testing sharded simulation") {
+  dynamics::running_parameters const p{};
+  std::mt19937 eng(7);
+  std::uniform_real_distribution<double> dist_x(p.left_bound, p.right_bound);
+  std::uniform_real_distribution<double> dist_y(p.bottom_bound, p.upper_bound);
+  std::uniform_real_distribution<double> dist_v(-30., 30.);
+  std::vector<dynamics::Boid> flock;
+  for (int i{}; i != 200; ++i) {
+    flock.emplace_back(dist_x(eng), dist_y(eng), dist_v(eng), dist_v(eng));
+  }
+  // the sharded flock comes back in a different order
+  auto by_position = [](dynamics::Boid const &b1, dynamics::Boid const &b2) {
+    return b1.r().x < b2.r().x || (b1.r().x == b2.r().x && b1.r().y < b2.r().y);
+  };
+
+  SUBCASE("find_shard") {
+    CHECK(dynamics::find_shard({0., 5.}, p, 4) == 0);
+    CHECK(dynamics::find_shard({45., 5.}, p, 4) == 1);
+    CHECK(dynamics::find_shard({176., 5.}, p, 4) == 3);
+    CHECK(dynamics::find_shard({-1., 5.}, p, 4) == 0);
+  }
+
+  SUBCASE("same evolution as a single process") {
+    dynamics::shard_options options{};
+    options.shards = 3;
+    options.steps = 5;
+    options.delta_t = 0.05;
+    std::vector<dynamics::Boid> sharded =
+        dynamics::run_sharded(flock, p, options);
+    for (int step{}; step != options.steps; ++step) {
+      dynamics::evolve_flock(flock, options.delta_t, p);
+    }
+    REQUIRE(sharded.size() == flock.size());
+    std::sort(sharded.begin(), sharded.end(), by_position);
+    std::sort(flock.begin(), flock.end(), by_position);
+    for (std::size_t i{}; i != flock.size(); ++i) {
+      CHECK(sharded[i].r().x == doctest::Approx(flock[i].r().x));
+      CHECK(sharded[i].r().y == doctest::Approx(flock[i].r().y));
+      CHECK(sharded[i].v().x == doctest::Approx(flock[i].v().x));
+      CHECK(sharded[i].v().y == doctest::Approx(flock[i].v().y));
+    }
+  }
+
+  SUBCASE("a full ring aborts the run") {
+    dynamics::shard_options options{};
+    options.shards = 2;
+    options.steps = 2;
+    options.ring_capacity = 1;
+    CHECK_THROWS_AS(dynamics::run_sharded(flock, p, options),
+                    std::runtime_error);
+  }
+}
+
+TEST_CASE("Testing ensemble runner") {
+  SUBCASE("sweep values") {
+    auto values = dynamics::sweep_values({0.1, 0.9, 5});
+    REQUIRE(values.size() == 5);
+    CHECK(values[0] == doctest::Approx(0.1));
+    CHECK(values[2] == doctest::Approx(0.5));
+    CHECK(values[4] == 0.9);
+    CHECK(dynamics::sweep_values({0.3, 0.3, 1}).size() == 1);
+  }
+
+  SUBCASE("parsing") {
+    std::istringstream input{"# a sweep\n"
+                             "s = 0.1 0.3 3\n"
+                             "a = 0.5   # single value\n"
+                             "boids_number = 10\n"
+                             "steps = 4\n"
+                             "seed = 9\n"};
+    auto sweep = dynamics::parse_sweep(input);
+    CHECK(sweep.s.points == 3);
+    CHECK(sweep.s.last == doctest::Approx(0.3));
+    CHECK(sweep.a.first == doctest::Approx(0.5));
+    CHECK(sweep.a.points == 1);
+    CHECK(sweep.base.boids_number == 10);
+    CHECK(sweep.steps == 4);
+    CHECK(sweep.seed == 9);
+
+    std::istringstream unknown{"q = 3\n"};
+    CHECK_THROWS_AS(dynamics::parse_sweep(unknown), std::runtime_error);
+    std::istringstream malformed{"steps = four\n"};
+    CHECK_THROWS_AS(dynamics::parse_sweep(malformed), std::runtime_error);
+  }
+
+  SUBCASE("runs are reproducible whatever the thread count") {
+    dynamics::sweep_specification sweep{};
+    sweep.base.boids_number = 20;
+    sweep.s = {0.1, 0.5, 2};
+    sweep.c = {0.01, 0.03, 3};
+    sweep.steps = 3;
+    sweep.lanes = 4;
+    unsigned const default_threads = parallel::thread_count();
+    parallel::thread_count(1);
+    auto serial = dynamics::run_ensemble(sweep);
+    parallel::thread_count(4);
+    auto threaded = dynamics::run_ensemble(sweep);
+    parallel::thread_count(default_threads);
+
+    REQUIRE(serial.size() == 6);
+    REQUIRE(threaded.size() == 6);
+    CHECK(serial[5].parameters.s == doctest::Approx(0.5));
+    CHECK(serial[5].parameters.c == doctest::Approx(0.03));
+    CHECK(serial[0].seed != serial[1].seed);
+    for (std::size_t i{}; i != serial.size(); ++i) {
+      CHECK(serial[i].seed == threaded[i].seed);
+      CHECK(serial[i].statistics.mean_distance ==
+            threaded[i].statistics.mean_distance);
+      CHECK(serial[i].statistics.mean_velocity ==
+            threaded[i].statistics.mean_velocity);
+    }
+
+    // every field of the statistics has its column
+    std::string const header = dynamics::print_result_header_to_csv();
+    std::string const row = dynamics::print_result_to_csv(serial[0]);
+    CHECK(std::count(header.begin(), header.end(), ',') == 13);
+    CHECK(std::count(row.begin(), row.end(), ',') == 13);
+    CHECK(header.find(",mean_nearest_distance,") != std::string::npos);
+  }
+}
+
+TEST_CASE("Testing flock batch") {
+  std::mt19937_64 eng(3);
+  dynamics::running_parameters p1{};
+  p1.boids_number = 60;
+  dynamics::running_parameters p2 = p1;
+  p2.s = 0.1;
+  p2.c = 0.05;
+  dynamics::running_parameters p3 = p1;
+  p3.d = 30.;
+  p3.d_s = 5.;
+  std::vector<std::vector<dynamics::Boid>> flocks{
+      dynamics::create_flock(p1, eng), dynamics::create_flock(p2, eng),
+      dynamics::create_flock(p3, eng)};
+  std::vector<dynamics::running_parameters> parameters{p1, p2, p3};
+
+  SUBCASE("same evolution as evolve_flock") {
+    dynamics::flock_batch batch{flocks, parameters};
+    CHECK(batch.lanes() == 3);
+    CHECK(batch.boids() == 60);
+    for (int step{}; step != 3; ++step) {
+      batch.evolve(0.05);
+      for (std::size_t lane{}; lane != flocks.size(); ++lane) {
+        dynamics::evolve_flock(flocks[lane], 0.05, parameters[lane]);
+      }
+    }
+    for (std::size_t lane{}; lane != flocks.size(); ++lane) {
+      auto const evolved = batch.flock(lane);
+      for (std::size_t i{}; i != evolved.size(); ++i) {
+        CHECK(evolved[i].r().x == doctest::Approx(flocks[lane][i].r().x));
+        CHECK(evolved[i].r().y == doctest::Approx(flocks[lane][i].r().y));
+        CHECK(evolved[i].v().x == doctest::Approx(flocks[lane][i].v().x));
+        CHECK(evolved[i].v().y == doctest::Approx(flocks[lane][i].v().y));
+      }
+    }
+  }
+
+  SUBCASE("flocks of different sizes") {
+    flocks[1].pop_back();
+    CHECK_THROWS_AS(dynamics::flock_batch(flocks, parameters),
+                    std::runtime_error);
+  }
+}
+
+TEST_CASE("Testing statistics worker") {
+  dynamics::Boid b1{{6.5, -7.5}, {7., 7.}};
+  dynamics::Boid b2{{1., -3.}, {5., 0.}};
+  dynamics::Boid b3{{4., -6.}, {1., -1.}};
+  std::vector<dynamics::Boid> flock{b1, b2, b3};
+  view::statistics_worker worker;
+  CHECK(!worker.latest().has_value());
+
+  worker.submit(flock, {0.25, 0.5});
+  // the result is published asynchronously
+  while (worker.completed() == 0) {
+    std::this_thread::yield();
+  }
+  auto const latest = worker.latest();
+  REQUIRE(latest.has_value());
+  view::data const expected = view::build_data(flock);
+  CHECK(latest->mean_distance == expected.mean_distance);
+  CHECK(latest->sigma_mean_distance == expected.sigma_mean_distance);
+  CHECK(latest->mean_velocity == expected.mean_velocity);
+  CHECK(latest->sigma_mean_velocity == expected.sigma_mean_velocity);
+  // the order parameters come with the snapshot
+  CHECK(latest->polarization == 0.25);
+  CHECK(latest->milling == 0.5);
+}
+
+TEST_CASE("Testing sampled distance statistics") {
+  std::mt19937_64 eng(11);
+  dynamics::running_parameters p{};
+  p.boids_number = 400;
+  std::vector<dynamics::Boid> flock = dynamics::create_flock(p, eng);
+  double const mean = view::calculate_mean_distance(flock);
+
+  SUBCASE("the estimate is close to the exact mean") {
+    auto const estimate = view::estimate_distances(flock, 200000, eng);
+    CHECK(estimate.samples == 200000);
+    CHECK(estimate.confidence > 0.);
+    CHECK(std::abs(estimate.mean - mean) < 4. * estimate.confidence);
+    CHECK(estimate.confidence ==
+          doctest::Approx(1.96 * estimate.sigma / std::sqrt(200000.)));
+  }
+
+  SUBCASE("build_data switches to the estimate above the exact limit") {
+    view::statistics_options options{};
+    view::data const exact = view::build_data(flock, options);
+    CHECK(exact.mean_distance == mean);
+    CHECK(exact.confidence_mean_distance == 0.);
+
+    options.exact_limit = 100;
+    view::data const sampled = view::build_data(flock, options);
+    CHECK(sampled.confidence_mean_distance > 0.);
+    CHECK(sampled.mean_distance ==
+          doctest::Approx(mean).epsilon(4. * sampled.confidence_mean_distance /
+                                        mean));
+    // the estimate is reproducible
+    CHECK(view::build_data(flock, options).mean_distance ==
+          sampled.mean_distance);
+    CHECK(view::print_data_to_string(sampled, p).find("95% CI") !=
+          std::string::npos);
+  }
+}
+
+TEST_CASE("Testing tiled distance sums") {
+  std::mt19937_64 eng(5);
+  dynamics::running_parameters p{};
+  // not a multiple of the tile or of the kernel width
+  p.boids_number = 1103;
+  std::vector<dynamics::Boid> flock = dynamics::create_flock(p, eng);
+  double sum{0.};
+  double sum_squares{0.};
+  for (std::size_t i{}; i != flock.size(); ++i) {
+    for (std::size_t j{i + 1}; j != flock.size(); ++j) {
+      double const distance = dynamics::calculate_distance(flock[i], flock[j]);
+      sum += distance;
+      sum_squares += distance * distance;
+    }
+  }
+  view::distance_sums const sums = view::calculate_distance_sums(flock);
+  CHECK(sums.sum == doctest::Approx(sum).epsilon(1e-12));
+  CHECK(sums.sum_squares == doctest::Approx(sum_squares).epsilon(1e-12));
+
+  // build_data gives the sample standard deviation of the distances
+  view::data const built = view::build_data(flock);
+  double const couples = flock.size() * (flock.size() - 1.) / 2.;
+  double const mean = sum / couples;
+  double squared_deviations{0.};
+  for (std::size_t i{}; i != flock.size(); ++i) {
+    for (std::size_t j{i + 1}; j != flock.size(); ++j) {
+      double const deviation =
+          dynamics::calculate_distance(flock[i], flock[j]) - mean;
+      squared_deviations += deviation * deviation;
+    }
+  }
+  CHECK(built.mean_distance == doctest::Approx(mean).epsilon(1e-12));
+  CHECK(built.sigma_mean_distance ==
+        doctest::Approx(std::sqrt(squared_deviations / (couples - 1.)))
+            .epsilon(1e-12));
+}
+
+TEST_CASE("Testing Welford accumulator") {
+  SUBCASE("mean and variance") {
+    math::welford w;
+    CHECK(w.count() == 0.);
+    CHECK(w.variance() == 0.);
+    for (double value : {2., 4., 4., 4., 5., 5., 7., 9.}) {
+      w.add(value);
+    }
+    CHECK(w.count() == 8.);
+    CHECK(w.mean() == doctest::Approx(5.));
+    CHECK(w.variance() == doctest::Approx(32. / 7.));
+  }
+
+  SUBCASE("merge") {
+    math::welford first;
+    math::welford second;
+    math::welford all;
+    for (int i{}; i != 100; ++i) {
+      double const value = std::sin(i) * 10.;
+      (i < 37 ? first : second).add(value);
+      all.add(value);
+    }
+    math::welford const merged = first + second;
+    CHECK(merged.count() == all.count());
+    CHECK(merged.mean() == doctest::Approx(all.mean()));
+    CHECK(merged.variance() == doctest::Approx(all.variance()));
+    CHECK((math::welford{} + first).mean() == first.mean());
+  }
+
+  SUBCASE("remove") {
+    math::welford w;
+    for (double value : {3., 8., -1., 4., 10.}) {
+      w.add(value);
+    }
+    w.remove(3.);
+    w.remove(10.);
+    CHECK(w.count() == 3.);
+    CHECK(w.mean() == doctest::Approx(11. / 3.));
+    CHECK(w.variance() == doctest::Approx(61. / 3.));
+    w.remove(8.);
+    w.remove(-1.);
+    w.remove(4.);
+    CHECK(w.count() == 0.);
+    CHECK(w.mean() == 0.);
+  }
+
+  SUBCASE("no cancellation with a large offset") {
+    math::welford w;
+    for (double value : {1e9 + 4., 1e9 + 7., 1e9 + 13., 1e9 + 16.}) {
+      w.add(value);
+    }
+    CHECK(w.variance() == doctest::Approx(30.));
+  }
+
+  SUBCASE("build_data velocities") {
+    dynamics::Boid b1{{1., 3.}, {-4., 0.}};
+    dynamics::Boid b2{{4., 5.}, {0., 0.}};
+    dynamics::Boid b3{{0., 1.}, {2., -3.}};
+    std::vector<dynamics::Boid> flock{b1, b2, b3};
+    view::data const built = view::build_data(flock);
+    CHECK(built.mean_velocity == doctest::Approx(2.5352).epsilon(0.0001));
+    CHECK(built.sigma_mean_velocity ==
+          doctest::Approx(2.2044).epsilon(0.0001));
+    CHECK(built.mean_distance == doctest::Approx(3.8328).epsilon(0.0001));
+  }
+}
+
+TEST_CASE("Testing order parameters") {
+  SUBCASE("aligned flock") {
+    std::vector<dynamics::Boid> flock{{{1., 3.}, {3., 4.}},
+                                      {{4., 5.}, {30., 40.}},
+                                      {{0., 1.}, {6., 8.}}};
+    dynamics::order_parameters const order =
+        dynamics::calculate_order_parameters(flock);
+    CHECK(order.polarization == doctest::Approx(1.));
+    CHECK(order.milling == doctest::Approx(0.).epsilon(1e-12));
+  }
+
+  SUBCASE("rotating ring") {
+    std::vector<dynamics::Boid> flock;
+    for (int i{}; i != 12; ++i) {
+      double const angle = i * 3.14159265358979 / 6.;
+      flock.emplace_back(100. + 10. * std::cos(angle),
+                         50. + 10. * std::sin(angle), -std::sin(angle),
+                         std::cos(angle));
+    }
+    dynamics::order_parameters const order =
+        dynamics::calculate_order_parameters(flock);
+    CHECK(order.polarization == doctest::Approx(0.).epsilon(1e-12));
+    CHECK(order.milling == doctest::Approx(1.));
+  }
+
+  SUBCASE("small ring far from the origin") {
+    // the spread is not lost in the squared distances from the origin
+    std::vector<dynamics::Boid> flock;
+    for (int i{}; i != 12; ++i) {
+      double const angle = i * 3.14159265358979 / 6.;
+      flock.emplace_back(1e6 + std::cos(angle), -1e6 + std::sin(angle),
+                         -std::sin(angle), std::cos(angle));
+    }
+    CHECK(dynamics::calculate_order_parameters(flock).milling ==
+          doctest::Approx(1.));
+  }
+
+  SUBCASE("empty flock") {
+    dynamics::order_parameters const order =
+        dynamics::calculate_order_parameters({});
+    CHECK(order.polarization == 0.);
+    CHECK(order.milling == 0.);
+  }
+
+  SUBCASE("accumulated while evolving") {
+    dynamics::running_parameters parameters{};
+    parameters.boids_number = 50;
+    std::mt19937_64 engine{7};
+    std::vector<dynamics::Boid> flock =
+        dynamics::create_flock(parameters, engine);
+    std::vector<dynamics::Boid> plain = flock;
+    dynamics::order_parameters order{};
+    dynamics::evolve_flock(flock, 1. / 60., parameters, order);
+    dynamics::evolve_flock(plain, 1. / 60., parameters);
+    dynamics::order_parameters const swept =
+        dynamics::calculate_order_parameters(flock);
+    CHECK(order.polarization == doctest::Approx(swept.polarization));
+    CHECK(order.milling == doctest::Approx(swept.milling));
+    CHECK(flock[0].r().x == plain[0].r().x);
+    CHECK(view::build_data(flock).polarization ==
+          doctest::Approx(swept.polarization));
+    // the ones given to build_data are used as they are
+    view::data const built = view::build_data(flock, order);
+    CHECK(built.polarization == order.polarization);
+    CHECK(built.milling == order.milling);
+  }
+}
+
+TEST_CASE("Testing cell list") {
+  dynamics::running_parameters parameters{};
+  parameters.boids_number = 300;
+  std::mt19937_64 engine{11};
+  std::vector<dynamics::Boid> const flock =
+      dynamics::create_flock(parameters, engine);
+
+  SUBCASE("neighbors") {
+    dynamics::cell_list const cells{flock, parameters.d, parameters};
+    CHECK(cells.size() == flock.size());
+    for (std::size_t i{}; i < flock.size(); i += 17) {
+      std::vector<std::size_t> found;
+      cells.for_each_neighbor(flock[i].r(), parameters.d,
+                              [&](std::size_t j, math::R2 const &) {
+                                found.push_back(j);
+                              });
+      std::vector<std::size_t> expected;
+      for (std::size_t j{}; j != flock.size(); ++j) {
+        if (dynamics::calculate_distance(flock[i], flock[j]) < parameters.d) {
+          expected.push_back(j);
+        }
+      }
+      std::sort(found.begin(), found.end());
+      CHECK(found == expected);
+    }
+  }
+
+  SUBCASE("pairs") {
+    dynamics::cell_list const cells{flock, 20., parameters};
+    std::atomic<std::size_t> pairs{0};
+    cells.for_each_pair(20., [&](std::size_t i, std::size_t j,
+                                 math::R2 const &displacement) {
+      CHECK(i != j);
+      CHECK(math::calculate_norm(displacement) ==
+            doctest::Approx(dynamics::calculate_distance(flock[i], flock[j])));
+      ++pairs;
+    });
+    std::size_t expected{};
+    for (std::size_t i{}; i != flock.size(); ++i) {
+      for (std::size_t j{i + 1}; j != flock.size(); ++j) {
+        expected += dynamics::calculate_distance(flock[i], flock[j]) < 20.;
+      }
+    }
+    CHECK(pairs == expected);
+  }
+
+  SUBCASE("periodic") {
+    std::vector<dynamics::Boid> const corners{{{1., 1.}, {0., 0.}},
+                                              {{175., 98.}, {0., 0.}},
+                                              {{88., 50.}, {0., 0.}}};
+    dynamics::cell_list const cells{corners, 5., parameters, true};
+    std::size_t pairs{};
+    cells.for_each_pair(5., [&](std::size_t i, std::size_t j,
+                                math::R2 const &displacement) {
+      CHECK(i == 0);
+      CHECK(j == 1);
+      CHECK(displacement.x == doctest::Approx(-2.));
+      CHECK(displacement.y == doctest::Approx(-2.));
+      ++pairs;
+    });
+    CHECK(pairs == 1);
+    dynamics::cell_list const open{corners, 5., parameters};
+    std::size_t open_pairs{};
+    open.for_each_pair(5., [&](std::size_t, std::size_t, math::R2 const &) {
+      ++open_pairs;
+    });
+    CHECK(open_pairs == 0);
+  }
+
+  SUBCASE("invalid cell size") {
+    CHECK_THROWS_AS(dynamics::cell_list(flock, 0., parameters),
+                    std::runtime_error);
+  }
+}
+
+TEST_CASE("Testing clusters") {
+  dynamics::running_parameters parameters{};
+
+  SUBCASE("chains and isolated boids") {
+    std::vector<dynamics::Boid> const flock{
+        {{10., 10.}, {0., 0.}}, {{100., 50.}, {0., 0.}},
+        {{18., 10.}, {0., 0.}}, {{26., 10.}, {0., 0.}},
+        {{105., 50.}, {0., 0.}}, {{60., 90.}, {0., 0.}}};
+    view::cluster_data const clusters =
+        view::find_clusters(flock, parameters);
+    CHECK(clusters.count == 3);
+    CHECK(clusters.largest == 3);
+    CHECK(clusters.labels ==
+          std::vector<std::size_t>{0, 1, 0, 0, 1, 2});
+    CHECK(clusters.sizes == std::vector<std::size_t>{3, 2, 1});
+  }
+
+  SUBCASE("same as a search over the neighborhoods") {
+    parameters.boids_number = 400;
+    std::mt19937_64 engine{5};
+    std::vector<dynamics::Boid> const flock =
+        dynamics::create_flock(parameters, engine);
+    unsigned const threads = parallel::thread_count();
+    parallel::thread_count(4);
+    view::cluster_data const clusters =
+        view::find_clusters(flock, parameters);
+    parallel::thread_count(threads);
+
+    // breadth first search labeling the clusters in the same order
+    std::vector<std::size_t> labels(flock.size(), flock.size());
+    std::size_t count{};
+    for (std::size_t first{}; first != flock.size(); ++first) {
+      if (labels[first] != flock.size()) {
+        continue;
+      }
+      std::vector<std::size_t> queue{first};
+      labels[first] = count;
+      for (std::size_t q{}; q != queue.size(); ++q) {
+        for (std::size_t j{}; j != flock.size(); ++j) {
+          if (labels[j] == flock.size() &&
+              dynamics::calculate_distance(flock[queue[q]], flock[j]) <
+                  parameters.d) {
+            labels[j] = count;
+            queue.push_back(j);
+          }
+        }
+      }
+      ++count;
+    }
+    CHECK(clusters.count == count);
+    CHECK(clusters.labels == labels);
+    CHECK(*std::max_element(clusters.sizes.begin(), clusters.sizes.end()) ==
+          clusters.largest);
+  }
+
+  SUBCASE("empty flock") {
+    view::cluster_data const clusters = view::find_clusters({}, parameters);
+    CHECK(clusters.count == 0);
+    CHECK(clusters.largest == 0);
+  }
+}
+
+TEST_CASE("Testing nearest neighbor distances") {
+  SUBCASE("lattice") {
+    std::vector<dynamics::Boid> flock;
+    for (int i{}; i != 10; ++i) {
+      for (int j{}; j != 5; ++j) {
+        flock.emplace_back(20. + 2. * i, 30. + 2. * j, 1., 0.);
+      }
+    }
+    view::nearest_neighbor_data const nearest =
+        view::calculate_nearest_neighbors(flock, 4, 1.);
+    CHECK(nearest.mean == doctest::Approx(2.));
+    CHECK(nearest.sigma == doctest::Approx(0.).epsilon(1e-12));
+    CHECK(nearest.histogram == std::vector<std::size_t>{0, 0, 50, 0});
+    CHECK(nearest.overflow == 0);
+    CHECK_THROWS_AS(view::calculate_nearest_neighbors(flock, 4, 0.),
+                    std::runtime_error);
+    CHECK_THROWS_AS(view::calculate_nearest_neighbors(flock, 4, -1.),
+                    std::runtime_error);
+
+    // build_data keeps the fractions of the histogram over the neighborhood
+    dynamics::running_parameters parameters{};
+    parameters.d = 4.;
+    view::data const built = view::build_data(
+        flock, view::statistics_options_for(parameters));
+    CHECK(built.nearest_bin_width == doctest::Approx(.5));
+    CHECK(built.nearest_histogram[4] == doctest::Approx(1.));
+    CHECK(built.nearest_histogram[3] == 0.);
+    std::string const printed = view::print_data_to_string(built, parameters);
+    CHECK(printed.find("Nearest Neighbor Histogram:   [    @   ]") !=
+          std::string::npos);
+  }
+
+  SUBCASE("same as a search over the whole flock") {
+    dynamics::running_parameters parameters{};
+    parameters.boids_number = 500;
+    std::mt19937_64 engine{3};
+    std::vector<dynamics::Boid> flock =
+        dynamics::create_flock(parameters, engine);
+    // a far away boid makes the search radius grow
+    flock.emplace_back(1000., -400., 1., 0.);
+    math::welford expected;
+    for (std::size_t i{}; i != flock.size(); ++i) {
+      double nearest = std::numeric_limits<double>::infinity();
+      for (std::size_t j{}; j != flock.size(); ++j) {
+        if (j != i) {
+          nearest = std::min(nearest,
+                             dynamics::calculate_distance(flock[i], flock[j]));
+        }
+      }
+      expected.add(nearest);
+    }
+    view::nearest_neighbor_data const nearest =
+        view::calculate_nearest_neighbors(flock, 10, 2.);
+    CHECK(nearest.mean == doctest::Approx(expected.mean()));
+    CHECK(nearest.sigma == doctest::Approx(expected.sigma()));
+    std::size_t counted = nearest.overflow;
+    for (std::size_t count : nearest.histogram) {
+      counted += count;
+    }
+    CHECK(counted == flock.size());
+    CHECK(nearest.overflow >= 1);
+    view::data const built = view::build_data(flock);
+    CHECK(built.mean_nearest_distance == doctest::Approx(expected.mean()));
+  }
+
+  SUBCASE("too few boids") {
+    std::vector<dynamics::Boid> const flock{{{1., 1.}, {1., 1.}}};
+    view::nearest_neighbor_data const nearest =
+        view::calculate_nearest_neighbors(flock);
+    CHECK(nearest.mean == 0.);
+    CHECK(nearest.histogram.empty());
+  }
+}
+
+TEST_CASE("Testing radial distribution function") {
+  dynamics::running_parameters parameters{};
+  parameters.boids_number = 400;
+
+  SUBCASE("uncorrelated boids") {
+    view::pair_correlation correlation{20., 10, parameters};
+    std::mt19937_64 engine{17};
+    for (int frame{}; frame != 20; ++frame) {
+      correlation.add_frame(dynamics::create_flock(parameters, engine));
+    }
+    CHECK(correlation.frames() == 20);
+    std::vector<double> const values = correlation.values();
+    // the first bin holds few couples, the others are within a few percent
+    for (std::size_t bin{1}; bin != values.size(); ++bin) {
+      CHECK(values[bin] == doctest::Approx(1.).epsilon(0.1));
+    }
+    CHECK(correlation.radii()[0] == doctest::Approx(1.));
+  }
+
+  SUBCASE("couples across the borders") {
+    std::vector<dynamics::Boid> const flock{{{.2, 50.}, {1., 0.}},
+                                            {{175.9, 50.}, {1., 0.}}};
+    view::pair_correlation correlation{4., 4, parameters};
+    correlation.add_frame(flock);
+    std::vector<double> const values = correlation.values();
+    CHECK(values[0] > 0.);
+    CHECK(values[1] == 0.);
+    correlation.reset();
+    CHECK(correlation.frames() == 0);
+    CHECK(correlation.values()[0] == 0.);
+  }
+
+  SUBCASE("frames added concurrently") {
+    view::pair_correlation concurrent{10., 5, parameters};
+    view::pair_correlation serial{10., 5, parameters};
+    std::vector<std::vector<dynamics::Boid>> flocks;
+    std::mt19937_64 engine{23};
+    for (int frame{}; frame != 4; ++frame) {
+      flocks.push_back(dynamics::create_flock(parameters, engine));
+      serial.add_frame(flocks.back());
+    }
+    std::vector<std::thread> threads;
+    for (auto const &flock : flocks) {
+      threads.emplace_back([&] { concurrent.add_frame(flock); });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    CHECK(concurrent.values() == serial.values());
+  }
+
+  SUBCASE("invalid range") {
+    CHECK_THROWS_AS(view::pair_correlation(60., 10, parameters),
+                    std::runtime_error);
+    CHECK_THROWS_AS(view::pair_correlation(10., 0, parameters),
+                    std::runtime_error);
+  }
+}
+
+TEST_CASE("Testing FFT") {
+  std::vector<std::complex<double>> values{1., 2., 0., -1., 3., 0.5, 0., 2.};
+  std::vector<std::complex<double>> const original = values;
+  math::fft(values);
+  // the first coefficient is the sum, the others agree with the definition
+  CHECK(values[0].real() == doctest::Approx(7.5));
+  std::complex<double> third{};
+  for (std::size_t k{}; k != original.size(); ++k) {
+    third += original[k] * std::polar(1., -2. * 3.14159265358979 * 3. * k / 8.);
+  }
+  CHECK(values[3].real() == doctest::Approx(third.real()));
+  CHECK(values[3].imag() == doctest::Approx(third.imag()));
+  math::fft(values, true);
+  for (std::size_t k{}; k != original.size(); ++k) {
+    CHECK(values[k].real() == doctest::Approx(original[k].real()));
+    CHECK(values[k].imag() == doctest::Approx(0.).epsilon(1e-12));
+  }
+
+  std::vector<std::complex<double>> grid(4 * 8, 1.);
+  math::fft_2d(grid, 8, 4);
+  CHECK(grid[0].real() == doctest::Approx(32.));
+  CHECK(std::abs(grid[5]) == doctest::Approx(0.).epsilon(1e-12));
+
+  std::vector<std::complex<double>> wrong(6);
+  CHECK_THROWS_AS(math::fft(wrong), std::runtime_error);
+  CHECK(math::next_power_of_two(33) == 64);
+}
+
+TEST_CASE("Testing velocity correlation") {
+  dynamics::running_parameters parameters{};
+  parameters.boids_number = 600;
+  std::mt19937_64 engine{29};
+  std::vector<dynamics::Boid> flock =
+      dynamics::create_flock(parameters, engine);
+  // a velocity field with a wavelength of half the width of the space plus
+  // noise, its correlation averaged over the directions is the Bessel
+  // function J0(2 pi r / 88), whose first zero is at 33.7
+  std::normal_distribution<double> noise{0., 5.};
+  for (auto &boid : flock) {
+    double const phase = 2. * 3.14159265358979 * boid.r().x / 88.;
+    boid.v({40. + 30. * std::cos(phase) + noise(engine),
+            30. * std::sin(phase) + noise(engine)});
+  }
+
+  // all the couples summed one by one with the minimum image
+  math::R2 mean{};
+  for (auto const &boid : flock) {
+    mean += boid.v() * (1. / flock.size());
+  }
+  double variance{};
+  for (auto const &boid : flock) {
+    variance += (boid.v() - mean) * (boid.v() - mean) / flock.size();
+  }
+  auto const exact = [&](double bin_width, std::size_t bins) {
+    std::vector<double> sums(bins);
+    std::vector<std::uint64_t> couples(bins);
+    for (std::size_t i{}; i != flock.size(); ++i) {
+      for (std::size_t j{i + 1}; j != flock.size(); ++j) {
+        math::R2 d = flock[j].r() - flock[i].r();
+        d.x -= 176. * std::round(d.x / 176.);
+        d.y -= 99. * std::round(d.y / 99.);
+        std::size_t const bin =
+            static_cast<std::size_t>(math::calculate_norm(d) / bin_width);
+        if (bin < bins) {
+          sums[bin] += (flock[i].v() - mean) * (flock[j].v() - mean);
+          ++couples[bin];
+        }
+      }
+    }
+    for (std::size_t bin{}; bin != bins; ++bin) {
+      sums[bin] = couples[bin] == 0 ? 0. : sums[bin] / couples[bin] / variance;
+    }
+    return std::make_pair(sums, couples);
+  };
+
+  SUBCASE("cell list") {
+    auto const [values, couples] = exact(2., 20);
+    view::velocity_correlation const correlation =
+        view::calculate_velocity_correlation(flock, 40., 20, parameters);
+    CHECK(correlation.couples == couples);
+    for (std::size_t bin{}; bin != values.size(); ++bin) {
+      CHECK(correlation.values[bin] == doctest::Approx(values[bin]));
+    }
+    CHECK(correlation.correlation_length ==
+          doctest::Approx(33.7).epsilon(0.1));
+  }
+
+  SUBCASE("FFT") {
+    view::velocity_correlation const correlation =
+        view::calculate_velocity_correlation_fft(flock, 50, 256, parameters);
+    auto const [values, couples] = exact(correlation.bin_width, 50);
+    std::uint64_t total{};
+    for (std::uint64_t count : correlation.couples) {
+      total += count;
+    }
+    CHECK(total == flock.size() * (flock.size() - 1) / 2);
+    // the cells blur the distances on the scale of a bin
+    for (std::size_t bin{2}; bin != values.size(); ++bin) {
+      CHECK(std::abs(correlation.values[bin] - values[bin]) < 0.02);
+    }
+    CHECK(correlation.correlation_length ==
+          doctest::Approx(33.7).epsilon(0.1));
+  }
+
+  SUBCASE("identical velocities") {
+    for (auto &boid : flock) {
+      boid.v({30., 0.});
+    }
+    view::velocity_correlation const flat =
+        view::calculate_velocity_correlation(flock, 40., 20, parameters);
+    CHECK(flat.correlation_length == 0.);
+    CHECK(flat.values[5] == 0.);
+  }
+
+  SUBCASE("invalid range") {
+    CHECK_THROWS_AS(
+        view::calculate_velocity_correlation(flock, 60., 20, parameters),
+        std::runtime_error);
+  }
+}
+
+TEST_CASE("Testing time series") {
+  // every field of the statistics is a function of the step, so a torn copy
+  // would be detected
+  auto const make_sample = [](std::uint64_t step) {
+    view::data statistics{};
+    statistics.mean_distance = static_cast<double>(step);
+    statistics.mean_velocity = 2. * step;
+    statistics.milling = -1. * step;
+    return view::sample{step, step * .5, 1e-3 * (step % 7), step / 4 * 4,
+                        statistics};
+  };
+
+  SUBCASE("ring and window") {
+    view::time_series series{4, 3};
+    CHECK(series.snapshot().empty());
+    CHECK(series.window().samples == 0);
+    for (std::uint64_t step{}; step != 10; ++step) {
+      series.push(make_sample(step));
+    }
+    CHECK(series.pushed() == 10);
+    std::vector<view::sample> const samples = series.snapshot();
+    REQUIRE(samples.size() == 4);
+    for (std::size_t k{}; k != samples.size(); ++k) {
+      CHECK(samples[k].step == 6 + k);
+      CHECK(samples[k].time == doctest::Approx((6. + k) * .5));
+    }
+    view::window_summary const summary = series.window();
+    CHECK(summary.samples == 3);
+    CHECK(summary.mean.mean_distance == doctest::Approx(8.));
+    CHECK(summary.sigma.mean_distance == doctest::Approx(1.));
+    CHECK(summary.mean.mean_velocity == doctest::Approx(16.));
+    CHECK(summary.mean_step_seconds == doctest::Approx(1e-3 * (0 + 1 + 2) / 3.));
+    CHECK(summary.statistics_step == 8);
+    CHECK(view::print_window_to_string(summary).find(
+              "Last 3 Steps (statistics of step 8)") != std::string::npos);
+  }
+
+  SUBCASE("window of a long series") {
+    view::time_series series{100, 50};
+    for (std::uint64_t step{}; step != 1037; ++step) {
+      series.push(make_sample(step));
+    }
+    math::welford expected;
+    for (std::uint64_t step{1037 - 50}; step != 1037; ++step) {
+      expected.add(static_cast<double>(step));
+    }
+    view::window_summary const summary = series.window();
+    CHECK(summary.mean.mean_distance == doctest::Approx(expected.mean()));
+    CHECK(summary.sigma.mean_distance == doctest::Approx(expected.sigma()));
+  }
+
+  SUBCASE("readers during the writes") {
+    view::time_series series{64, 16};
+    std::atomic<bool> done{false};
+    std::thread writer{[&] {
+      for (std::uint64_t step{}; step != 20000; ++step) {
+        series.push(make_sample(step));
+      }
+      done = true;
+    }};
+    bool consistent{true};
+    do {
+      std::vector<view::sample> const samples = series.snapshot();
+      for (std::size_t k{}; k != samples.size(); ++k) {
+        view::sample const expected = make_sample(samples[k].step);
+        consistent = consistent && samples[k].time == expected.time &&
+                     samples[k].statistics.mean_velocity ==
+                         expected.statistics.mean_velocity &&
+                     samples[k].statistics.milling ==
+                         expected.statistics.milling &&
+                     (k == 0 || samples[k].step > samples[k - 1].step);
+      }
+      view::window_summary const summary = series.window();
+      consistent = consistent && summary.samples <= 16;
+    } while (!done);
+    writer.join();
+    CHECK(consistent);
+    CHECK(series.snapshot().size() == 64);
+  }
+
+  SUBCASE("invalid sizes") {
+    CHECK_THROWS_AS(view::time_series(0, 0), std::runtime_error);
+    CHECK_THROWS_AS(view::time_series(4, 5), std::runtime_error);
+  }
+}
+
+TEST_CASE("Testing density field") {
+  dynamics::running_parameters parameters{};
+  parameters.right_bound = 100.;
+  parameters.upper_bound = 50.;
+  std::vector<dynamics::Boid> const flock{{{5., 5.}, {10., 0.}},
+                                          {{8., 9.}, {20., 4.}},
+                                          {{55., 35.}, {-3., 3.}},
+                                          {{99.9, 49.9}, {1., 1.}}};
+  view::density_field field{10, 5, parameters};
+  field.update(flock);
+
+  SUBCASE("scatter") {
+    CHECK(field.total() == doctest::Approx(4.));
+    CHECK(field.count(0, 0) == 2.);
+    CHECK(field.count(5, 3) == 1.);
+    CHECK(field.count(9, 4) == 1.);
+    CHECK(field.density(0, 0) == doctest::Approx(.02));
+    CHECK(field.mean_velocity(0, 0) == math::R2{15., 2.});
+    CHECK(field.mean_velocity(3, 3) == math::R2{});
+    CHECK(field.maximum_count() == 2.);
+  }
+
+  SUBCASE("persistence") {
+    std::vector<dynamics::Boid> const moved{{{55., 5.}, {1., 0.}}};
+    field.update(moved, .75);
+    CHECK(field.count(0, 0) == doctest::Approx(1.5));
+    CHECK(field.count(5, 0) == doctest::Approx(.25));
+    CHECK(field.total() == doctest::Approx(.75 * 4. + .25));
+    CHECK_THROWS_AS(field.update(moved, 1.), std::runtime_error);
+  }
+
+  SUBCASE("smoothing") {
+    view::density_field const smoothed = field.smoothed(10.);
+    CHECK(smoothed.total() == doctest::Approx(4.));
+    CHECK(smoothed.count(0, 0) < 2.);
+    CHECK(smoothed.count(1, 1) > 0.);
+    // the kernel wraps around the borders
+    CHECK(smoothed.count(0, 0) > smoothed.count(4, 0));
+    CHECK(smoothed.count(9, 0) > smoothed.count(4, 0));
+    // the mean velocity of a single boid is kept by the smoothing
+    CHECK(smoothed.mean_velocity(5, 3).x ==
+          doctest::Approx(field.mean_velocity(5, 3).x).epsilon(.5));
+    CHECK(field.smoothed(0.).count(0, 0) == 2.);
+  }
+
+  SUBCASE("large flock") {
+    parameters.boids_number = 10000;
+    std::mt19937_64 engine{31};
+    std::vector<dynamics::Boid> const many =
+        dynamics::create_flock(parameters, engine);
+    view::density_field serial{16, 8, parameters};
+    view::density_field threaded{16, 8, parameters};
+    unsigned const threads = parallel::thread_count();
+    parallel::thread_count(1);
+    serial.update(many);
+    parallel::thread_count(4);
+    threaded.update(many);
+    parallel::thread_count(threads);
+    CHECK(threaded.total() == doctest::Approx(10000.));
+    for (std::size_t row{}; row != 8; ++row) {
+      for (std::size_t column{}; column != 16; ++column) {
+        CHECK(threaded.mean_velocity(column, row) ==
+              serial.mean_velocity(column, row));
+      }
+    }
+  }
+
+  SUBCASE("invalid grid") {
+    CHECK_THROWS_AS(view::density_field(0, 5, parameters), std::runtime_error);
+  }
+}
+
+TEST_CASE("Testing snapshots") {
+  io::snapshot saved{};
+  saved.step = 1234;
+  saved.time = 20.5;
+  saved.parameters.boids_number = 70;
+  saved.parameters.s = .25;
+  saved.parameters.minimum_velocity = 12.;
+  saved.engine.seed(99);
+  saved.flock = dynamics::create_flock(saved.parameters, saved.engine);
+  saved.flock[3] = dynamics::Boid{-0., 1e-300, -7.5, 3.14};
+
+  std::ostringstream output;
+  io::write_snapshot(output, saved);
+  std::string const bytes = output.str();
+
+  SUBCASE("round trip") {
+    std::istringstream input{bytes};
+    io::snapshot loaded = io::read_snapshot(input);
+    CHECK(loaded.step == 1234);
+    CHECK(loaded.time == 20.5);
+    CHECK(loaded.parameters.boids_number == 70);
+    CHECK(loaded.parameters.s == .25);
+    CHECK(loaded.parameters.d == saved.parameters.d);
+    CHECK(loaded.parameters.minimum_velocity == 12.);
+    REQUIRE(loaded.flock.size() == saved.flock.size());
+    for (std::size_t i{}; i != saved.flock.size(); ++i) {
+      CHECK(loaded.flock[i].r() == saved.flock[i].r());
+      CHECK(loaded.flock[i].v() == saved.flock[i].v());
+    }
+    // the engine continues where it was saved
+    CHECK(loaded.engine() == saved.engine());
+  }
+
+  SUBCASE("layout") {
+    // magic, version, reserved, step, time, 12 parameters, engine, count,
+    // boids and hash
+    CHECK(bytes.compare(0, 8, "BOIDSNAP") == 0);
+    CHECK(bytes[8] == 1);
+    CHECK(static_cast<unsigned char>(bytes[16]) == (1234 & 0xff));
+    CHECK(static_cast<unsigned char>(bytes[17]) == (1234 >> 8));
+    std::ostringstream engine;
+    engine << saved.engine;
+    CHECK(bytes.size() ==
+          8 + 4 + 4 + 8 + 8 + 12 * 8 + 8 + engine.str().size() + 8 +
+              70 * 32 + 8);
+  }
+
+  SUBCASE("damaged snapshots") {
+    std::string corrupted = bytes;
+    corrupted[bytes.size() - 100] ^= 0x10;
+    std::istringstream damaged{corrupted};
+    CHECK_THROWS_AS(io::read_snapshot(damaged), std::runtime_error);
+    std::istringstream truncated{bytes.substr(0, bytes.size() - 9)};
+    CHECK_THROWS_AS(io::read_snapshot(truncated), std::runtime_error);
+    std::istringstream foreign{"not a snapshot at all"};
+    CHECK_THROWS_AS(io::read_snapshot(foreign), std::runtime_error);
+    std::string future = bytes;
+    future[8] = 2;
+    std::istringstream newer{future};
+    CHECK_THROWS_AS(io::read_snapshot(newer), std::runtime_error);
+  }
+
+  SUBCASE("files") {
+    temporary_directory const directory;
+    std::string const path = directory.path("checkpoint.snap");
+    io::save_snapshot(path, saved);
+    io::snapshot const loaded = io::load_snapshot(path);
+    CHECK(loaded.flock.size() == 70);
+    CHECK(loaded.flock[3].v() == math::R2{-7.5, 3.14});
+    std::remove(path.c_str());
+    CHECK_THROWS_AS(io::load_snapshot(path), std::runtime_error);
+  }
+}
+
+TEST_CASE("Testing trajectories") {
+  dynamics::running_parameters parameters = test_parameters(40);
+  parameters.c = .07;
+  std::vector<dynamics::Boid> flock = test_flock(parameters, 41);
+  temporary_directory const directory;
+  std::string const path = directory.path("trajectory.traj");
+
+  // more frames than the first mapping holds, so the file grows
+  std::vector<std::vector<dynamics::Boid>> frames;
+  {
+    io::trajectory_writer writer{path, flock.size(), parameters};
+    for (std::uint64_t step{}; step != 50; ++step) {
+      frames.push_back(flock);
+      writer.append(10 * step, step / 60., flock);
+      dynamics::evolve_flock(flock, 1. / 60., parameters);
+    }
+    CHECK(writer.frames() == 50);
+    std::vector<dynamics::Boid> const wrong(3, flock[0]);
+    CHECK_THROWS_AS(writer.append(500, 1., wrong), std::runtime_error);
+  }
+
+  SUBCASE("random access") {
+    io::trajectory_reader const reader{path};
+    CHECK(reader.frames() == 50);
+    CHECK(reader.boids() == 40);
+    CHECK(reader.parameters().c == .07);
+    CHECK(reader.parameters().boids_number == 40);
+    for (std::uint64_t index : {49u, 0u, 17u, 33u}) {
+      io::frame_view const frame = reader.frame(index);
+      CHECK(frame.step() == 10 * index);
+      CHECK(frame.time() == index / 60.);
+      for (std::size_t i{}; i != 40; ++i) {
+        CHECK(frame.r(i) == frames[index][i].r());
+        CHECK(frame.v(i) == frames[index][i].v());
+      }
+      CHECK(frame.values()[4 * 5 + 2] == frames[index][5].v().x);
+    }
+    CHECK(reader.frame(7).flock()[3].r() == frames[7][3].r());
+    CHECK(reader.find_step(120) == 12);
+    CHECK(reader.find_step(121) == 13);
+    CHECK(reader.find_step(10000) == 50);
+    CHECK_THROWS_AS(reader.frame(50), std::out_of_range);
+  }
+
+  SUBCASE("file cut short") {
+    REQUIRE(truncate(path.c_str(), 192 + 20 * (16 + 40 * 32) + 100) == 0);
+    io::trajectory_reader const reader{path};
+    CHECK(reader.frames() == 20);
+    CHECK(reader.frame(19).step() == 190);
+  }
+
+  SUBCASE("not a trajectory") {
+    std::ofstream{path} << "definitely not a trajectory file, but long enough "
+                           "to hold a header if it were one, which it is not. "
+                           "definitely not a trajectory file, but long enough "
+                           "to hold a header if it were one, which it is not.";
+    CHECK_THROWS_AS(io::trajectory_reader{path}, std::runtime_error);
+  }
+}
+
+TEST_CASE("Testing trajectory codec") {
+  dynamics::running_parameters const parameters = test_parameters(300);
+  std::vector<dynamics::Boid> flock = test_flock(parameters, 43);
+  io::codec_settings settings{};
+  settings.keyframe_interval = 25;
+
+  // the output must not depend on the number of threads
+  std::vector<std::vector<dynamics::Boid>> frames;
+  std::string bytes[2];
+  for (unsigned threads : {1u, 4u}) {
+    parallel::thread_count(threads);
+    std::vector<dynamics::Boid> evolving = flock;
+    std::ostringstream output;
+    io::trajectory_encoder encoder{output, evolving.size(), parameters,
+                                   settings};
+    for (std::uint64_t step{}; step != 60; ++step) {
+      if (threads == 1) {
+        frames.push_back(evolving);
+      }
+      encoder.append(step, step / 60., evolving);
+      dynamics::evolve_flock(evolving, 1. / 60., parameters);
+    }
+    CHECK(encoder.frames() == 60);
+    CHECK(encoder.bytes() == output.str().size());
+    bytes[threads == 1 ? 0 : 1] = output.str();
+  }
+  CHECK(bytes[0] == bytes[1]);
+  // the raw frames take 32 bytes per boid
+  CHECK(bytes[0].size() < 60 * 300 * 32 / 4);
+
+  SUBCASE("bounded error") {
+    std::istringstream input{bytes[0]};
+    io::trajectory_decoder decoder{input};
+    CHECK(decoder.boids() == 300);
+    CHECK(decoder.settings().keyframe_interval == 25);
+    CHECK(decoder.parameters().boids_number == 300);
+    io::decoded_frame frame;
+    double const position_error = settings.position_step / 2. * (1. + 1e-6);
+    double const velocity_error = settings.velocity_step / 2. * (1. + 1e-6);
+    std::uint64_t index{};
+    while (decoder.next(frame)) {
+      CHECK(frame.step == index);
+      CHECK(frame.time == index / 60.);
+      REQUIRE(frame.flock.size() == 300);
+      for (std::size_t i{}; i < 300; i += 7) {
+        math::R2 const dr = frame.flock[i].r() - frames[index][i].r();
+        math::R2 const dv = frame.flock[i].v() - frames[index][i].v();
+        CHECK(std::abs(dr.x) <= position_error);
+        CHECK(std::abs(dr.y) <= position_error);
+        CHECK(std::abs(dv.x) <= velocity_error);
+        CHECK(std::abs(dv.y) <= velocity_error);
+      }
+      ++index;
+    }
+    CHECK(index == 60);
+    CHECK(decoder.frames() == 60);
+  }
+
+  SUBCASE("invalid input") {
+    std::ostringstream output;
+    CHECK_THROWS_AS(
+        io::trajectory_encoder(output, 300, parameters, {0., 1e-3, 60}),
+        std::runtime_error);
+    io::trajectory_encoder encoder{output, 300, parameters, settings};
+    std::vector<dynamics::Boid> far = flock;
+    far[4] = dynamics::Boid{1e20, 0., 0., 0.};
+    CHECK_THROWS_AS(encoder.append(0, 0., far), std::runtime_error);
+    CHECK_THROWS_AS(encoder.append(0, 0., {flock[0]}), std::runtime_error);
+
+    std::istringstream truncated{bytes[0].substr(0, bytes[0].size() - 10)};
+    io::trajectory_decoder decoder{truncated};
+    io::decoded_frame frame;
+    CHECK_THROWS_AS(
+        [&] {
+          while (decoder.next(frame)) {
+          }
+        }(),
+        std::runtime_error);
+
+    std::string damaged = bytes[0];
+    damaged[144 + 8 + 17] = static_cast<char>(60);
+    std::istringstream damaged_input{damaged};
+    io::trajectory_decoder damaged_decoder{damaged_input};
+    CHECK_THROWS_AS(damaged_decoder.next(frame), std::runtime_error);
+
+    std::istringstream not_a_trajectory{"BOIDSNAP and more"};
+    CHECK_THROWS_AS(io::trajectory_decoder{not_a_trajectory},
+                    std::runtime_error);
+  }
+}
+
+TEST_CASE("Testing recorder") {
+  SUBCASE("single producer single consumer queue") {
+    parallel::spsc_queue<int> queue{5};
+    CHECK(queue.capacity() == 8);
+    for (int i{}; i != 8; ++i) {
+      CHECK(queue.try_push(i));
+    }
+    CHECK_FALSE(queue.try_push(8));
+    int value{-1};
+    CHECK(queue.try_pop(value));
+    CHECK(value == 0);
+    CHECK(queue.size() == 7);
+
+    // the values cross the threads in order
+    parallel::spsc_queue<int> crossing{16};
+    std::thread consumer{[&]() {
+      int expected{};
+      int popped{};
+      while (expected != 100000) {
+        if (crossing.try_pop(popped)) {
+          if (popped != expected) {
+            break;
+          }
+          ++expected;
+        }
+      }
+      value = expected;
+    }};
+    for (int i{}; i != 100000;) {
+      if (crossing.try_push(i)) {
+        ++i;
+      }
+    }
+    consumer.join();
+    CHECK(value == 100000);
+  }
+
+  dynamics::running_parameters const parameters = test_parameters(10);
+  std::vector<dynamics::Boid> const flock = test_flock(parameters, 44);
+  // the sink waits while the gate is closed
+  std::atomic<bool> gate{true};
+  std::vector<std::uint64_t> steps;
+  std::vector<dynamics::Boid> last;
+  io::frame_sink const sink = [&](std::uint64_t step, double,
+                                  std::vector<dynamics::Boid> const &frame) {
+    while (!gate.load()) {
+      std::this_thread::yield();
+    }
+    steps.push_back(step);
+    last = frame;
+  };
+
+  SUBCASE("block") {
+    io::recorder recording{sink, flock.size(), 2, io::backpressure::block};
+    for (std::uint64_t step{}; step != 50; ++step) {
+      CHECK(recording.record(step, step / 60., flock));
+    }
+    recording.close();
+    CHECK_THROWS_AS(recording.record(50, 1., flock), std::runtime_error);
+    io::recorder_statistics const counted = recording.statistics();
+    CHECK(counted.offered == 50);
+    CHECK(counted.written == 50);
+    CHECK(counted.dropped == 0);
+    REQUIRE(steps.size() == 50);
+    CHECK(steps[49] == 49);
+    CHECK(last[7].r() == flock[7].r());
+  }
+
+  SUBCASE("drop") {
+    gate = false;
+    io::recorder recording{sink, flock.size(), 4, io::backpressure::drop};
+    // the frame taken by the writer keeps its buffer until the gate opens,
+    // so four frames are queued whenever the writer takes it
+    for (std::uint64_t step{}; step != 20; ++step) {
+      CHECK(recording.record(step, 0., flock) == (step < 4));
+    }
+    io::recorder_statistics counted = recording.statistics();
+    CHECK(counted.queued == 4);
+    CHECK(counted.dropped == 16);
+    gate = true;
+    recording.close();
+    counted = recording.statistics();
+    CHECK(counted.written == 4);
+    CHECK(steps == std::vector<std::uint64_t>{0, 1, 2, 3});
+  }
+
+  SUBCASE("decimate") {
+    gate = false;
+    io::recorder recording{sink, flock.size(), 4, io::backpressure::decimate};
+    for (std::uint64_t step{}; step != 40; ++step) {
+      recording.record(step, 0., flock);
+    }
+    io::recorder_statistics counted = recording.statistics();
+    CHECK(counted.queued == 4);
+    CHECK(counted.dropped == 36);
+    CHECK(counted.decimation > 1);
+    gate = true;
+    while (recording.statistics().written != 4) {
+      std::this_thread::yield();
+    }
+    // the rate recovers once the writer has caught up
+    for (std::uint64_t step{40}; step != 400; ++step) {
+      recording.record(step, 0., flock);
+      while (recording.statistics().written != recording.statistics().queued) {
+        std::this_thread::yield();
+      }
+    }
+    recording.close();
+    counted = recording.statistics();
+    CHECK(counted.decimation == 1);
+    CHECK(counted.written == counted.queued);
+    CHECK(counted.offered == counted.queued + counted.dropped);
+    CHECK(std::is_sorted(steps.begin(), steps.end()));
+  }
+
+  SUBCASE("failing sink") {
+    io::recorder recording{
+        [](std::uint64_t step, double, std::vector<dynamics::Boid> const &) {
+          if (step == 2) {
+            throw std::runtime_error("ERROR: Disk full");
+          }
+        },
+        flock.size(), 2};
+    // the error comes back from record or from close
+    auto const record_all = [&]() {
+      for (std::uint64_t step{}; step != 5; ++step) {
+        recording.record(step, 0., flock);
+      }
+      recording.close();
+    };
+    CHECK_THROWS_AS(record_all(), std::runtime_error);
+    CHECK(recording.statistics().written == 2);
+  }
+}
+
+TEST_CASE("Testing asynchronous writer") {
+  temporary_directory const directory;
+  std::string const path = directory.path("written.bin");
+  auto const read_file = [](std::string const &name) {
+    std::ifstream input{name, std::ios::binary};
+    return std::string{std::istreambuf_iterator<char>{input},
+                       std::istreambuf_iterator<char>{}};
+  };
+  std::string expected;
+  for (int i{}; i != 10000; ++i) {
+    expected += static_cast<char>(i * 7 % 251);
+  }
+
+  std::vector<io::io_backend> backends{io::io_backend::threaded};
+  try {
+    io::async_file_writer probe{path, io::io_backend::io_uring};
+    backends.push_back(io::io_backend::io_uring);
+  } catch (std::runtime_error const &) {
+    // the kernel doesn't allow io_uring, only the fallback is tested
+  }
+
+  for (io::io_backend backend : backends) {
+    CAPTURE(static_cast<int>(backend));
+    {
+      // pieces smaller and larger than the buffers, so that every buffer is
+      // written many times
+      io::async_file_writer writer{path, backend, 4, 1000};
+      CHECK(writer.backend() == backend);
+      std::size_t written{};
+      for (std::size_t size : {1u, 999u, 1u, 2500u, 3u, 10u}) {
+        writer.write(expected.data() + written, size);
+        written += size;
+      }
+      writer.submit();
+      writer.stream().write(expected.data() + written, 4000);
+      writer.stream() << expected.substr(written + 4000, 1000);
+      writer.stream().put(expected[written + 5000]);
+      written += 5001;
+      writer.write(expected.data() + written, expected.size() - written);
+      CHECK(writer.bytes() == expected.size());
+      writer.flush();
+      CHECK(read_file(path) == expected);
+      writer.write("tail", 4);
+      writer.close();
+      CHECK_THROWS_AS(writer.write("x", 1), std::runtime_error);
+    }
+    CHECK(read_file(path) == expected + "tail");
+
+    // a reopened writer starts the new file from its beginning with the
+    // same buffers, the first file is complete
+    std::string const second = directory.path("second.bin");
+    {
+      io::async_file_writer writer{path, backend, 2, 1000};
+      writer.write(expected.data(), 2500);
+      CHECK_THROWS_AS(writer.reopen("/nonexistent-directory/file.bin"),
+                      std::runtime_error);
+      CHECK_THROWS_AS(writer.write("x", 1), std::runtime_error);
+      writer.reopen(second);
+      writer.write(expected.data() + 2500, 1500);
+      CHECK(writer.bytes() == 1500);
+      writer.close();
+      CHECK_THROWS_AS(writer.reopen(path), std::runtime_error);
+    }
+    CHECK(read_file(path) == expected.substr(0, 2500));
+    CHECK(read_file(second) == expected.substr(2500, 1500));
+  }
+
+  SUBCASE("automatic backend") {
+    {
+      io::async_file_writer writer{path};
+      CHECK(writer.backend() != io::io_backend::automatic);
+      writer.write("abc", 3);
+    }
+    CHECK(read_file(path) == "abc");
+  }
+
+  SUBCASE("compressed trajectory") {
+    dynamics::running_parameters const parameters = test_parameters(200);
+    std::vector<dynamics::Boid> flock = test_flock(parameters, 45);
+    {
+      io::async_file_writer writer{path, io::io_backend::automatic, 2, 4096};
+      io::trajectory_encoder encoder{writer.stream(), flock.size(),
+                                     parameters};
+      for (std::uint64_t step{}; step != 20; ++step) {
+        encoder.append(step, 0., flock);
+        dynamics::evolve_flock(flock, 1. / 60., parameters);
+      }
+      CHECK(writer.bytes() == encoder.bytes());
+    }
+    std::ifstream input{path, std::ios::binary};
+    io::trajectory_decoder decoder{input};
+    io::decoded_frame frame;
+    std::uint64_t frames{};
+    while (decoder.next(frame)) {
+      ++frames;
+    }
+    CHECK(frames == 20);
+    CHECK(std::abs(frame.flock[10].r().x - flock[10].r().x) < 1.);
+  }
+
+  SUBCASE("snapshots") {
+    io::snapshot saved{};
+    saved.step = 10;
+    saved.engine.seed(46);
+    saved.flock = dynamics::create_flock(saved.parameters, saved.engine);
+    io::snapshot_saver saver;
+    saver.save(path, saved);
+    saved.step = 20;
+    saved.flock[0] = dynamics::Boid{1., 2., 3., 4.};
+    saver.save(path, saved);
+    // the first one is in place while the second is being written
+    CHECK(io::load_snapshot(path).step == 10);
+    saver.finish();
+    io::snapshot const loaded = io::load_snapshot(path);
+    CHECK(loaded.step == 20);
+    CHECK(loaded.flock[0].v() == math::R2{3., 4.});
+    CHECK(loaded.flock.size() == saved.flock.size());
+  }
+
+  SUBCASE("invalid writers") {
+    CHECK_THROWS_AS(io::async_file_writer(path, io::io_backend::threaded, 0),
+                    std::runtime_error);
+    CHECK_THROWS_AS(
+        io::async_file_writer("/nonexistent-directory/file.bin"),
+        std::runtime_error);
+  }
+}
+
+TEST_CASE("Testing replay") {
+  SUBCASE("playback") {
+    view::playback player{1., 11.};
+    CHECK(player.paused());
+    player.advance(1.);
+    CHECK(player.time() == 1.);
+    player.paused(false);
+    player.speed(2.);
+    player.advance(1.5);
+    CHECK(player.time() == doctest::Approx(4.));
+    player.speed(-.5);
+    player.advance(2.);
+    CHECK(player.time() == doctest::Approx(3.));
+    // the ends pause the playback
+    player.advance(10.);
+    CHECK(player.time() == 1.);
+    CHECK(player.paused());
+    player.seek(20.);
+    CHECK(player.time() == 11.);
+    CHECK_THROWS_AS(view::playback(2., 1.), std::runtime_error);
+  }
+
+  SUBCASE("prefetching") {
+    dynamics::running_parameters const parameters = test_parameters(50);
+    std::vector<dynamics::Boid> flock = test_flock(parameters, 47);
+    temporary_directory const directory;
+    std::string const path = directory.path("replayed.traj");
+    {
+      io::trajectory_writer writer{path, flock.size(), parameters};
+      for (std::uint64_t step{}; step != 100; ++step) {
+        writer.append(step, step / 60., flock);
+        dynamics::evolve_flock(flock, 1. / 60., parameters);
+      }
+    }
+    io::trajectory_reader const reader{path};
+    CHECK(reader.find_time(0.) == 0);
+    CHECK(reader.find_time(10. / 60.) == 10);
+    CHECK(reader.find_time(10.5 / 60.) == 11);
+    CHECK(reader.find_time(5.) == 100);
+    reader.prefetch(90, 500);
+
+    auto const wait_for = [](view::replay_prefetcher &prefetcher,
+                             std::uint64_t frames) {
+      for (int attempt{}; attempt != 5000; ++attempt) {
+        if (prefetcher.prefetched() >= frames) {
+          break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+      }
+      return prefetcher.prefetched();
+    };
+    {
+      view::replay_prefetcher prefetcher{reader, 10};
+      // the first frames are prefetched at once
+      CHECK(wait_for(prefetcher, 10) == 10);
+      // moving forward only the new frames are read
+      prefetcher.follow(5, true);
+      CHECK(wait_for(prefetcher, 15) == 15);
+      // backwards from the end, the last frames
+      prefetcher.follow(99, false);
+      CHECK(wait_for(prefetcher, 26) == 26);
+    }
+  }
+}
+
+TEST_CASE("Testing trajectory analysis") {
+  dynamics::running_parameters const parameters = test_parameters(60);
+  std::vector<dynamics::Boid> flock = test_flock(parameters, 47);
+  temporary_directory const directory;
+  std::string const path = directory.path("analyzed.traj");
+  std::vector<std::vector<dynamics::Boid>> frames;
+  std::stringstream compressed;
+  {
+    io::trajectory_writer writer{path, flock.size(), parameters};
+    io::trajectory_encoder encoder{compressed, flock.size(), parameters};
+    for (std::uint64_t step{}; step != 30; ++step) {
+      frames.push_back(flock);
+      writer.append(step, step / 60., flock);
+      encoder.append(step, step / 60., flock);
+      dynamics::evolve_flock(flock, 1. / 60., parameters);
+    }
+  }
+  io::trajectory_reader const reader{path};
+  view::analysis_options const options{};
+
+  SUBCASE("every frame") {
+    std::vector<view::frame_analysis> const analyses =
+        view::analyze_trajectory(reader, 5, 30, options);
+    REQUIRE(analyses.size() == 25);
+    for (std::size_t index : {0u, 13u, 24u}) {
+      std::vector<dynamics::Boid> const &frame = frames[index + 5];
+      view::frame_analysis const &analysis = analyses[index];
+      view::data const expected = view::build_data(frame);
+      view::cluster_data const clusters = view::find_clusters(frame, parameters);
+      CHECK(analysis.step == index + 5);
+      CHECK(analysis.time == (index + 5) / 60.);
+      CHECK(analysis.statistics.mean_distance == expected.mean_distance);
+      CHECK(analysis.statistics.polarization == expected.polarization);
+      CHECK(analysis.statistics.mean_nearest_distance ==
+            expected.mean_nearest_distance);
+      CHECK(analysis.clusters == clusters.count);
+      CHECK(analysis.largest_cluster == clusters.largest);
+      CHECK(analysis.correlation_length ==
+            view::calculate_velocity_correlation_fft(
+                frame, options.correlation_bins,
+                options.correlation_resolution, parameters)
+                .correlation_length);
+    }
+    CHECK(view::analyze_trajectory(reader, 30, 30, options).empty());
+    CHECK_THROWS_AS(view::analyze_trajectory(reader, 20, 31, options),
+                    std::out_of_range);
+  }
+
+  SUBCASE("independent of the threads") {
+    unsigned const default_threads = parallel::thread_count();
+    parallel::thread_count(1);
+    std::vector<view::frame_analysis> const serial =
+        view::analyze_trajectory(reader, 0, 30, options);
+    parallel::thread_count(4);
+    std::vector<view::frame_analysis> const threaded =
+        view::analyze_trajectory(reader, 0, 30, options);
+    parallel::thread_count(default_threads);
+    for (std::size_t index{}; index != 30; ++index) {
+      CHECK(view::print_analysis_to_json(serial[index], options) ==
+            view::print_analysis_to_json(threaded[index], options));
+      CHECK(serial[index].statistics.sigma_mean_velocity ==
+            threaded[index].statistics.sigma_mean_velocity);
+    }
+  }
+
+  SUBCASE("compressed frames") {
+    io::trajectory_decoder decoder{compressed};
+    std::vector<io::decoded_frame> decoded(30);
+    for (auto &frame : decoded) {
+      REQUIRE(decoder.next(frame));
+    }
+    std::vector<view::frame_analysis> const analyses =
+        view::analyze_frames(decoded, decoder.parameters(), options);
+    std::vector<view::frame_analysis> const exact =
+        view::analyze_trajectory(reader, 0, 30, options);
+    REQUIRE(analyses.size() == 30);
+    for (std::size_t index{}; index != 30; ++index) {
+      CHECK(analyses[index].step == index);
+      // the values are off by half a step of the codec at most
+      CHECK(analyses[index].statistics.mean_distance ==
+            doctest::Approx(exact[index].statistics.mean_distance)
+                .epsilon(1e-3));
+      CHECK(analyses[index].statistics.mean_velocity ==
+            doctest::Approx(exact[index].statistics.mean_velocity)
+                .epsilon(1e-3));
+    }
+  }
+
+  SUBCASE("printing") {
+    view::analysis_options partial{};
+    partial.clusters = false;
+    view::frame_analysis const analysis =
+        view::analyze_frame(7, .5, frames[7], parameters, partial);
+    CHECK(analysis.clusters == 0);
+    std::string const header = view::print_analysis_header_to_csv(options);
+    CHECK(header.rfind("step,time,mean_distance,", 0) == 0);
+    CHECK(header.find(",clusters,largest_cluster,correlation_length\n") !=
+          std::string::npos);
+    std::string const partial_header =
+        view::print_analysis_header_to_csv(partial);
+    CHECK(partial_header.find("clusters") == std::string::npos);
+    std::string const row = view::print_analysis_to_csv(analysis, partial);
+    CHECK(row.rfind("7,0.500000,", 0) == 0);
+    CHECK(std::count(row.begin(), row.end(), ',') ==
+          std::count(partial_header.begin(), partial_header.end(), ','));
+    std::string const json = view::print_analysis_to_json(analysis, partial);
+    CHECK(json.rfind("{\"step\":7,\"time\":0.500000,", 0) == 0);
+    CHECK(json.find("\"correlation_length\":") != std::string::npos);
+    CHECK(json.substr(json.size() - 2) == "}\n");
+    view::frame_analysis undefined = analysis;
+    undefined.statistics.milling = std::numeric_limits<double>::quiet_NaN();
+    CHECK(view::print_analysis_to_json(undefined, partial)
+              .find("\"milling\":null,") != std::string::npos);
+  }
+}
+
+TEST_CASE("Testing numpy export") {
+  dynamics::running_parameters const parameters = test_parameters(25);
+  std::vector<dynamics::Boid> const flock = test_flock(parameters, 48);
+  std::string const digits{"123456789"};
+  CHECK(io::crc32(digits.data(), digits.size()) == 0xcbf43926);
+  CHECK(io::crc32(digits.data() + 4, 5, io::crc32(digits.data(), 4)) ==
+        0xcbf43926);
+
+  SUBCASE("npy") {
+    std::string const header = io::npy_header(flock.size());
+    CHECK(header.size() % 64 == 0);
+    CHECK(header.compare(0, 8, "\x93NUMPY\x01\x00", 8) == 0);
+    CHECK(static_cast<unsigned char>(header[8]) +
+              256 * static_cast<unsigned char>(header[9]) ==
+          header.size() - 10);
+    CHECK(header.find("{'descr': '<f8', 'fortran_order': False, "
+                      "'shape': (25, 4), }") == 10);
+    CHECK(header.back() == '\n');
+
+    std::stringstream stream;
+    io::write_npy(stream, flock);
+    std::string const written = stream.str();
+    REQUIRE(written.size() == header.size() + 25 * 4 * sizeof(double));
+    CHECK(written.compare(0, header.size(), header) == 0);
+    // the rows are r_x r_y v_x v_y
+    for (std::size_t i : {0u, 11u, 24u}) {
+      double row[4];
+      std::memcpy(row, written.data() + header.size() + 4 * sizeof(double) * i,
+                  sizeof(row));
+      CHECK(row[0] == flock[i].r().x);
+      CHECK(row[1] == flock[i].r().y);
+      CHECK(row[2] == flock[i].v().x);
+      CHECK(row[3] == flock[i].v().y);
+    }
+  }
+
+  SUBCASE("npz") {
+    temporary_directory const temporary;
+    std::string const path = temporary.path("flocks.npz");
+    std::stringstream first;
+    io::write_npy(first, flock);
+    std::vector<dynamics::Boid> const empty{};
+    {
+      io::npz_writer archive{path};
+      archive.add("first", flock);
+      archive.add("empty", empty);
+      CHECK_THROWS_AS(archive.add("first", flock), std::runtime_error);
+      archive.close();
+      CHECK_THROWS_AS(archive.add("late", flock), std::runtime_error);
+    }
+    std::ifstream file{path, std::ios::binary};
+    std::string const archive{std::istreambuf_iterator<char>{file}, {}};
+    auto const u16 = [&](std::size_t offset) {
+      return static_cast<unsigned char>(archive[offset]) +
+             256u * static_cast<unsigned char>(archive[offset + 1]);
+    };
+    auto const u32 = [&](std::size_t offset) {
+      return u16(offset) + 65536u * u16(offset + 2);
+    };
+    // the first array is stored as it is after its local header
+    std::string const array = first.str();
+    REQUIRE(archive.size() > 30 + 9 + array.size());
+    CHECK(u32(0) == 0x04034b50);
+    CHECK(u16(8) == 0); // stored
+    CHECK(u32(14) == io::crc32(array.data(), array.size()));
+    CHECK(u32(18) == array.size());
+    CHECK(u32(22) == array.size());
+    CHECK(archive.compare(30, 9, "first.npy") == 0);
+    CHECK(archive.compare(39, array.size(), array) == 0);
+    // the end record points at the central directory of both arrays
+    std::size_t const end = archive.size() - 22;
+    CHECK(u32(end) == 0x06054b50);
+    CHECK(u16(end + 10) == 2);
+    std::size_t const directory = u32(end + 16);
+    CHECK(u32(end + 12) == end - directory);
+    CHECK(u32(directory) == 0x02014b50);
+    CHECK(u32(directory + 42) == 0);
+    CHECK(archive.compare(directory + 46, 9, "first.npy") == 0);
+    std::size_t const second = directory + 46 + 9;
+    CHECK(u32(second) == 0x02014b50);
+    CHECK(u32(second + 42) == 39 + array.size());
+    CHECK(archive.compare(second + 46, 9, "empty.npy") == 0);
+  }
+}
+
+TEST_CASE("Testing vtk export") {
+  dynamics::running_parameters const parameters = test_parameters(30);
+  std::vector<dynamics::Boid> const flock = test_flock(parameters, 49);
+
+  std::vector<std::size_t> const neighbors =
+      view::count_neighbors(flock, parameters);
+  REQUIRE(neighbors.size() == 30);
+  for (std::size_t i{}; i != 30; ++i) {
+    // get_neighborhood counts the boid itself
+    CHECK(neighbors[i] + 1 ==
+          dynamics::get_neighborhood(flock, flock[i], parameters.d).size());
+  }
+  io::vtu_scalars const scalars{
+      neighbors, view::find_clusters(flock, parameters).labels};
+
+  SUBCASE("grid") {
+    std::stringstream stream;
+    io::write_vtu(stream, flock, scalars);
+    std::string const written = stream.str();
+    CHECK(written.rfind("<?xml version=\"1.0\"?>\n<VTKFile "
+                        "type=\"UnstructuredGrid\"",
+                        0) == 0);
+    CHECK(written.find("byte_order=\"LittleEndian\" header_type=\"UInt64\"") !=
+          std::string::npos);
+    CHECK(written.find("NumberOfPoints=\"30\" NumberOfCells=\"30\"") !=
+          std::string::npos);
+    std::size_t const start =
+        written.find("<AppendedData encoding=\"raw\">\n   _") + 34;
+    CHECK(written.substr(written.size() - 30) ==
+          "\n  </AppendedData>\n</VTKFile>\n");
+    // every array is found at its offset after its size
+    auto const array = [&](std::string const &name) {
+      std::size_t const tag = written.find("Name=\"" + name + "\"");
+      REQUIRE(tag != std::string::npos);
+      std::size_t const offset_at = written.find("offset=\"", tag) + 8;
+      std::size_t const offset = std::stoul(written.substr(offset_at));
+      std::uint64_t size;
+      std::memcpy(&size, written.data() + start + offset, sizeof(size));
+      return std::make_pair(written.data() + start + offset + sizeof(size),
+                            size);
+    };
+    auto const [velocities, velocity_bytes] = array("velocity");
+    CHECK(velocity_bytes == 30 * 3 * sizeof(double));
+    double velocity[3];
+    std::memcpy(velocity, velocities + 7 * sizeof(velocity), sizeof(velocity));
+    CHECK(velocity[0] == flock[7].v().x);
+    CHECK(velocity[1] == flock[7].v().y);
+    CHECK(velocity[2] == 0.);
+    auto const [counts, count_bytes] = array("neighbors");
+    CHECK(count_bytes == 30 * sizeof(std::uint64_t));
+    std::uint64_t count;
+    std::memcpy(&count, counts + 12 * sizeof(count), sizeof(count));
+    CHECK(count == neighbors[12]);
+    auto const [labels, label_bytes] = array("cluster");
+    CHECK(label_bytes == 30 * sizeof(std::uint64_t));
+    std::uint64_t label;
+    std::memcpy(&label, labels + 29 * sizeof(label), sizeof(label));
+    CHECK(label == scalars.clusters[29]);
+    auto const [types, type_bytes] = array("types");
+    CHECK(type_bytes == 30);
+    CHECK(types[29] == 1);
+    // the points come first
+    std::uint64_t point_bytes;
+    std::memcpy(&point_bytes, written.data() + start, sizeof(point_bytes));
+    CHECK(point_bytes == 30 * 3 * sizeof(double));
+    double point[3];
+    std::memcpy(point, written.data() + start + 8 + 3 * sizeof(point),
+                sizeof(point));
+    CHECK(point[0] == flock[3].r().x);
+    CHECK(point[1] == flock[3].r().y);
+    // last comes the end of the types
+    CHECK(types + 30 == written.data() + written.size() - 30);
+
+    std::stringstream plain;
+    io::write_vtu(plain, flock);
+    CHECK(plain.str().find("neighbors") == std::string::npos);
+    io::vtu_scalars wrong{};
+    wrong.clusters.resize(29);
+    CHECK_THROWS_AS(io::write_vtu(plain, flock, wrong), std::runtime_error);
+  }
+
+  SUBCASE("series") {
+    temporary_directory const directory;
+    std::string const stem = directory.path("series");
+    {
+      io::vtu_series series{stem + ".pvd"};
+      series.add(0., flock, scalars);
+      series.add(1. / 60., flock);
+      CHECK(series.frames() == 2);
+      series.close();
+      CHECK_THROWS_AS(series.add(1., flock), std::runtime_error);
+    }
+    std::ifstream index{stem + ".pvd"};
+    std::string const text{std::istreambuf_iterator<char>{index}, {}};
+    std::string const name = stem.substr(stem.find_last_of('/') + 1);
+    CHECK(text.find("<VTKFile type=\"Collection\"") != std::string::npos);
+    CHECK(text.find("timestep=\"0\" part=\"0\" file=\"" + name +
+                    "_000000.vtu\"") != std::string::npos);
+    CHECK(text.find("timestep=\"0.016666666666666666\" part=\"0\" file=\"" +
+                    name + "_000001.vtu\"") != std::string::npos);
+    std::stringstream expected;
+    io::write_vtu(expected, flock, scalars);
+    std::ifstream first{stem + "_000000.vtu", std::ios::binary};
+    CHECK(std::string{std::istreambuf_iterator<char>{first}, {}} ==
+          expected.str());
+  }
+}
+
+TEST_CASE("Testing region recording") {
+  dynamics::running_parameters const parameters = test_parameters(300);
+  std::vector<dynamics::Boid> flock = test_flock(parameters, 50);
+  // boids out of the bounds belong to the border cells
+  flock[0].r({-5., 50.});
+  flock[1].r({200., 120.});
+
+  io::region const rectangle{20., 10., 90., 60.};
+  // an L, concave
+  io::region const polygon{std::vector<math::R2>{
+      {10., 10.}, {100., 10.}, {100., 40.}, {40., 40.}, {40., 90.}, {10., 90.}}};
+
+  SUBCASE("regions") {
+    CHECK(rectangle.rectangle());
+    CHECK(rectangle.contains({20., 10.}));
+    CHECK(rectangle.contains({55., 35.}));
+    CHECK_FALSE(rectangle.contains({90.5, 35.}));
+    CHECK(rectangle.vertices().size() == 4);
+    CHECK_FALSE(polygon.rectangle());
+    CHECK(polygon.contains({20., 80.}));
+    CHECK(polygon.contains({90., 20.}));
+    CHECK_FALSE(polygon.contains({70., 70.}));
+    CHECK_FALSE(polygon.contains({5., 20.}));
+    CHECK(polygon.lower() == math::R2{10., 10.});
+    CHECK(polygon.upper() == math::R2{100., 90.});
+    CHECK_THROWS_AS(io::region(5., 0., 5., 10.), std::runtime_error);
+    CHECK_THROWS_AS(io::region(std::vector<math::R2>{{0., 0.}, {1., 1.}}),
+                    std::runtime_error);
+
+    io::region const parsed = io::parse_region("20, 10,90,60");
+    CHECK(parsed.rectangle());
+    CHECK(parsed.upper() == math::R2{90., 60.});
+    CHECK(io::parse_region("0,0,10,0,0,10").vertices().size() == 3);
+    CHECK_THROWS_AS(io::parse_region("1,2,3"), std::runtime_error);
+    CHECK_THROWS_AS(io::parse_region("0,0,10,0,0,10,5"), std::runtime_error);
+    CHECK_THROWS_AS(io::parse_region("0,0,ten,10"), std::runtime_error);
+    CHECK_THROWS_AS(io::parse_region("0,0,10x,10"), std::runtime_error);
+  }
+
+  SUBCASE("selection") {
+    dynamics::cell_list const cells{flock, 5., parameters};
+    std::vector<std::size_t> visited;
+    cells.for_each_in_box({20., 10.}, {90., 60.},
+                          [&](std::size_t i, math::R2 const &position) {
+                            CHECK(position == flock[i].r());
+                            visited.push_back(i);
+                          });
+    std::sort(visited.begin(), visited.end());
+    CHECK(std::adjacent_find(visited.begin(), visited.end()) ==
+          visited.end());
+    CHECK(visited.size() < flock.size());
+
+    for (io::region const *selection : {&rectangle, &polygon}) {
+      std::vector<std::uint32_t> ids;
+      std::vector<dynamics::Boid> selected;
+      io::select_region(*selection, flock, parameters, ids, selected);
+      std::vector<std::uint32_t> expected;
+      for (std::uint32_t i{}; i != flock.size(); ++i) {
+        if (selection->contains(flock[i].r())) {
+          expected.push_back(i);
+          // every boid inside is among the ones near the box
+          if (selection == &rectangle) {
+            CHECK(std::binary_search(visited.begin(), visited.end(), i));
+          }
+        }
+      }
+      CHECK(!expected.empty());
+      CHECK(ids == expected);
+      REQUIRE(selected.size() == ids.size());
+      CHECK(selected.back().v() == flock[ids.back()].v());
+    }
+    // out of the bounds too
+    std::vector<std::uint32_t> ids;
+    std::vector<dynamics::Boid> selected;
+    io::select_region(io::region{-10., 100., 250., 130.}, flock, parameters,
+                      ids, selected);
+    CHECK(std::find(ids.begin(), ids.end(), 1u) != ids.end());
+    io::select_region(io::region{-10., 45., -1., 55.}, flock, parameters, ids,
+                      selected);
+    CHECK(ids == std::vector<std::uint32_t>{0});
+  }
+
+  SUBCASE("trajectory") {
+    std::stringstream stream;
+    std::vector<std::vector<dynamics::Boid>> frames;
+    {
+      io::region_writer writer{stream, polygon, flock.size(), parameters};
+      for (std::uint64_t step{}; step != 5; ++step) {
+        frames.push_back(flock);
+        writer.append(step, step / 60., flock);
+        dynamics::evolve_flock(flock, 1. / 60., parameters);
+      }
+      CHECK(writer.frames() == 5);
+      CHECK(writer.bytes() == stream.str().size());
+      // only the boids inside are written
+      CHECK(writer.bytes() < 5 * flock.size() * 4 * sizeof(double));
+      std::vector<dynamics::Boid> const wrong(3, flock[0]);
+      CHECK_THROWS_AS(writer.append(5, 1., wrong), std::runtime_error);
+    }
+    std::string const written = stream.str();
+
+    io::region_reader reader{stream};
+    CHECK(reader.boids() == 300);
+    CHECK(reader.parameters().boids_number == 300);
+    CHECK(reader.parameters().d == parameters.d);
+    io::region const stored = reader.selection();
+    CHECK_FALSE(stored.rectangle());
+    CHECK(stored.vertices().size() == 6);
+    CHECK(stored.vertices()[3] == math::R2{40., 40.});
+    io::region_frame frame;
+    for (std::uint64_t step{}; step != 5; ++step) {
+      REQUIRE(reader.next(frame));
+      CHECK(frame.step == step);
+      CHECK(frame.time == step / 60.);
+      std::vector<std::uint32_t> ids;
+      std::vector<dynamics::Boid> selected;
+      io::select_region(polygon, frames[step], parameters, ids, selected);
+      CHECK(frame.ids == ids);
+      REQUIRE(frame.flock.size() == selected.size());
+      for (std::size_t i{}; i != selected.size(); ++i) {
+        CHECK(frame.flock[i].r() == frames[step][frame.ids[i]].r());
+        CHECK(frame.flock[i].v() == frames[step][frame.ids[i]].v());
+      }
+    }
+    CHECK_FALSE(reader.next(frame));
+
+    std::stringstream truncated{written.substr(0, written.size() - 8)};
+    io::region_reader truncated_reader{truncated};
+    auto const read_all = [&]() {
+      while (truncated_reader.next(frame)) {
+      }
+    };
+    CHECK_THROWS_AS(read_all(), std::runtime_error);
+    std::stringstream other{"BOIDTRAJ and more bytes than a header"};
+    CHECK_THROWS_AS(io::region_reader{other}, std::runtime_error);
+
+    std::stringstream rectangular;
+    io::region_writer{rectangular, rectangle, flock.size(), parameters};
+    CHECK(io::region_reader{rectangular}.selection().rectangle());
+  }
 }